@@ -2,6 +2,7 @@
 #include "InputHandlers.hpp"
 #include "renderer/RenderContext.hpp"
 #include "renderer/ShaderManager.hpp"
+#include "renderer/TextureManager.hpp"
 #include "renderer/OculusVR.hpp"
 
 // application globals
@@ -56,6 +57,8 @@ int main(int argc, char **argv)
         // handle key presses
         processEvents();
 
+        TextureManager::GetInstance()->Update();
+
         glClearColor(0.2f, 0.2f, 0.6f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -64,11 +67,8 @@ int main(int argc, char **argv)
 
         for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
         {
-            OVR::Matrix4f MVPMatrix = g_oculusVR.OnEyeRender(eyeIndex);
-
-            // update MVP in quad shader
-            const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
-            glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVPMatrix.Transposed().M[0][0]);
+            // view matrices go to the shared ViewConstants block, read by all programs
+            g_oculusVR.OnEyeRender(eyeIndex);
 
             g_application.OnRender(); 
             g_oculusVR.RenderDebug();
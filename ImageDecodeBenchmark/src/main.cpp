@@ -0,0 +1,266 @@
+#include "stb_image/stb_image.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Decode throughput benchmark for stb_image: every image is decoded from memory with the scalar and the SIMD
+ * kernels, outputs are compared and the throughput of both is printed in megapixels and megabytes of decoded
+ * output per second.
+ * Usage: ImageDecodeBenchmark [-n iterations] [-stress threads] <image> [<image> ...]
+ * Returns 1 if an image fails to decode or the two paths don't produce the same pixels.
+ * With -stress, all images are decoded concurrently on the given number of threads (each decode with its own
+ * stbi_context) and compared against a single threaded decode instead - meant to be run under ThreadSanitizer.
+ * Images that fail to decode are kept there and must fail with the same reason on every thread.
+ */
+
+struct DecodeResult
+{
+    int            width;
+    int            height;
+    int            components;
+    unsigned char *pixels;
+    double         seconds;   // best of all iterations
+};
+
+static bool ReadFile(const char *fileName, std::vector<unsigned char> *data)
+{
+    FILE *file = fopen(fileName, "rb");
+
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    data->resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+
+    bool ok = !data->empty() && fread(&(*data)[0], 1, data->size(), file) == data->size();
+    fclose(file);
+
+    return ok;
+}
+
+static bool Decode(const std::vector<unsigned char> &data, bool simd, int iterations, DecodeResult *result)
+{
+    result->pixels  = NULL;
+    result->seconds = 1e30;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        stbi_context context;
+        stbi_context_init(&context);
+        context.no_simd = !simd;
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        unsigned char *pixels = stbi_load_from_memory_ctx(&context, &data[0], (int)data.size(), &result->width, &result->height, &result->components, 0);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        if (!pixels)
+        {
+            printf("  %s\n", context.failure_reason ? context.failure_reason : "decoding failed");
+            stbi_image_free(result->pixels);
+            result->pixels = NULL;
+            return false;
+        }
+
+        if (seconds < result->seconds)
+            result->seconds = seconds;
+
+        // keep the last decode for comparison
+        stbi_image_free(result->pixels);
+        result->pixels = pixels;
+    }
+
+    return true;
+}
+
+// single threaded decode of one file, the reference for stress threads
+struct StressImage
+{
+    const char                *fileName;
+    std::vector<unsigned char> data;
+    int                        width;
+    int                        height;
+    int                        components;
+    unsigned char             *pixels;
+    std::string                failureReason;   // set when decoding fails
+};
+
+static unsigned char *StressDecode(const StressImage &image, bool simd, int *width, int *height, int *components, std::string *failureReason)
+{
+    stbi_context context;
+    stbi_context_init(&context);
+    context.no_simd = !simd;
+
+    unsigned char *pixels = stbi_load_from_memory_ctx(&context, &image.data[0], (int)image.data.size(), width, height, components, 0);
+
+    if (!pixels)
+        *failureReason = context.failure_reason ? context.failure_reason : "decoding failed";
+
+    return pixels;
+}
+
+static int RunStress(std::vector<StressImage> &images, int threadCount, int iterations)
+{
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        StressImage &image = images[i];
+        image.pixels = StressDecode(image, true, &image.width, &image.height, &image.components, &image.failureReason);
+    }
+
+    std::atomic<int> mismatches(0);
+    std::vector<std::thread> threads;
+
+    // every thread walks the images from a different start, odd threads with the scalar kernels, so decodes of
+    // different files and of both paths overlap
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.push_back(std::thread([&images, &mismatches, iterations, t]()
+        {
+            for (int n = 0; n < iterations; n++)
+            {
+                for (size_t i = 0; i < images.size(); i++)
+                {
+                    const StressImage &image = images[(i + t) % images.size()];
+
+                    int width, height, components;
+                    std::string failureReason;
+                    unsigned char *pixels = StressDecode(image, (t & 1) == 0, &width, &height, &components, &failureReason);
+
+                    bool match;
+
+                    if (!image.pixels)
+                        match = !pixels && failureReason == image.failureReason;
+                    else
+                        match = pixels && width == image.width && height == image.height && components == image.components &&
+                                !memcmp(pixels, image.pixels, (size_t)width * height * components);
+
+                    if (!match)
+                    {
+                        printf("%s: thread %d iteration %d differs from single threaded decode\n", image.fileName, t, n);
+                        mismatches++;
+                    }
+
+                    stbi_image_free(pixels);
+                }
+            }
+        }));
+    }
+
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    int failedImages = 0;
+
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        if (!images[i].pixels)
+            failedImages++;
+
+        stbi_image_free(images[i].pixels);
+    }
+
+    printf("stress: %d threads, %d iterations, %d images (%d failing to decode), %d mismatches\n", threadCount, iterations,
+           (int)images.size(), failedImages, mismatches.load());
+
+    return mismatches > 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 10;
+    int stressThreads = 0;
+    int failed = 0, decoded = 0;
+    std::vector<StressImage> stressImages;
+    double scalarSeconds = 0.0, simdSeconds = 0.0, megapixels = 0.0, megabytes = 0.0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            iterations = (std::max)(atoi(argv[++i]), 1);
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-stress") && i + 1 < argc)
+        {
+            stressThreads = (std::max)(atoi(argv[++i]), 1);
+            continue;
+        }
+
+        std::vector<unsigned char> data;
+
+        if (!ReadFile(argv[i], &data))
+        {
+            printf("%s: can't read file\n", argv[i]);
+            failed++;
+            continue;
+        }
+
+        // stress mode only collects the files, decoding starts once all of them are read
+        if (stressThreads > 0)
+        {
+            StressImage image;
+            image.fileName = argv[i];
+            image.pixels   = NULL;
+            image.data.swap(data);
+            stressImages.push_back(image);
+            continue;
+        }
+
+        DecodeResult scalar, simd;
+        simd.pixels = NULL;
+
+        if (!Decode(data, false, iterations, &scalar) || !Decode(data, true, iterations, &simd))
+        {
+            printf("%s: failed to decode\n", argv[i]);
+            stbi_image_free(scalar.pixels);
+            stbi_image_free(simd.pixels);
+            failed++;
+            continue;
+        }
+
+        size_t size      = (size_t)scalar.width * scalar.height * scalar.components;
+        bool   identical = !memcmp(scalar.pixels, simd.pixels, size);
+        double pixels    = (double)scalar.width * scalar.height / 1e6;
+        double bytes     = (double)size / 1e6;
+
+        printf("%s: %dx%dx%d, scalar %.1f MP/s %.1f MB/s, SIMD %.1f MP/s %.1f MB/s (%.2fx)%s\n", argv[i], scalar.width, scalar.height, scalar.components,
+               pixels / scalar.seconds, bytes / scalar.seconds, pixels / simd.seconds, bytes / simd.seconds, scalar.seconds / simd.seconds,
+               identical ? "" : ", OUTPUT DIFFERS");
+
+        scalarSeconds += scalar.seconds;
+        simdSeconds   += simd.seconds;
+        megapixels    += pixels;
+        megabytes     += bytes;
+
+        stbi_image_free(scalar.pixels);
+        stbi_image_free(simd.pixels);
+
+        if (identical)
+            decoded++;
+        else
+            failed++;
+    }
+
+    if (!stressImages.empty())
+        return RunStress(stressImages, stressThreads, iterations) | (failed > 0 ? 1 : 0);
+
+    if (decoded + failed == 0)
+    {
+        printf("Usage: ImageDecodeBenchmark [-n iterations] [-stress threads] <image> [<image> ...]\n");
+        return 1;
+    }
+
+    if (decoded > 0)
+        printf("total: %.1f MP, scalar %.1f MP/s %.1f MB/s, SIMD %.1f MP/s %.1f MB/s (%.2fx)\n", megapixels, megapixels / scalarSeconds, megabytes / scalarSeconds,
+               megapixels / simdSeconds, megabytes / simdSeconds, scalarSeconds / simdSeconds);
+
+    return failed > 0 ? 1 : 0;
+}
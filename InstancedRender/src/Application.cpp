@@ -3,9 +3,34 @@
 #include "renderer/CameraDirector.hpp"
 #include "renderer/ShaderManager.hpp"
 #include "renderer/TextureManager.hpp"
+#include <algorithm>
+#include <cstddef>
 
 CameraDirector g_cameraDirector;
 
+// number of frames rendered with each filter preset during benchmark
+static const int BENCHMARK_FRAMES = 300;
+
+// quad grid size
+static const int GRID_SIZE = 50;
+
+// textures of the batched grid - grouped into texture arrays by size and format
+static const char *gridTextures[] = { "../common_res/block_blue.ktx",
+                                      "../common_res/block_blue.png",
+                                      "../common_res/font.png" };
+
+static const struct
+{
+    const char *name;
+    bool        mipmaps;
+    float       anisotropy;
+} filterPresets[Application::Filter_Count] = {
+    { "Bilinear, no mips",           false, 1.f  },
+    { "Trilinear",                   true,  1.f  },
+    { "Trilinear, 4x anisotropic",   true,  4.f  },
+    { "Trilinear, 16x anisotropic",  true,  16.f }
+};
+
 Application::~Application()
 {
     if (glIsBuffer(m_vertexBuffer))
@@ -22,6 +47,15 @@ Application::~Application()
 
     if (glIsVertexArray(m_quadOffsetBuffer))
         glDeleteVertexArrays(1, &m_quadOffsetBuffer);
+
+    if (glIsVertexArray(m_batchVertexArray))
+        glDeleteVertexArrays(1, &m_batchVertexArray);
+
+    if (glIsBuffer(m_gridInstanceBuffer))
+        glDeleteBuffers(1, &m_gridInstanceBuffer);
+
+    if (glIsQuery(m_gridTimerQueries[0]))
+        glDeleteQueries(2, m_gridTimerQueries);
 }
 
 void Application::OnStart()
@@ -30,8 +64,11 @@ void Application::OnStart()
 
     g_cameraDirector.AddCamera(0.0f, 0.0f, 0.0f);
 
-    // load block texture
-    m_texture = TextureManager::GetInstance()->LoadTexture("../common_res/block_blue.png");
+    // load block texture - BC1 compressed (see TextureCompressor), PNG if the driver doesn't support it
+    m_texture = TextureManager::GetInstance()->LoadTexture("../common_res/block_blue.ktx");
+
+    if (!m_texture)
+        m_texture = TextureManager::GetInstance()->LoadTexture("../common_res/block_blue.png");
 
     const GLfloat quadBufferData[] = {
         -0.1f, 0.1f, -1.5f,
@@ -71,22 +108,168 @@ void Application::OnStart()
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertexTexcoordData), vertexTexcoordData, GL_STATIC_DRAW);
 
     glGenBuffers(1, &m_quadOffsetBuffer);
+
+    glGenQueries(2, m_gridTimerQueries);
+
+    CreateBatchedGrid();
+}
+
+void Application::CreateBatchedGrid()
+{
+    glGenVertexArrays(1, &m_batchVertexArray);
+    glGenBuffers(1, &m_gridInstanceBuffer);
+
+    // layers failing to load (unsupported compressed format) are skipped
+    const int numTextures = sizeof(gridTextures) / sizeof(gridTextures[0]);
+    TextureManager::ArrayLayer layers[numTextures];
+    std::vector<TextureManager::ArrayLayer> gridLayers;
+
+    TextureManager::GetInstance()->LoadTextureArrays(gridTextures, numTextures, layers);
+
+    for (int i = 0; i < numTextures; i++)
+    {
+        if (layers[i].array >= 0)
+            gridLayers.push_back(layers[i]);
+    }
+
+    if (gridLayers.empty())
+        return;
+
+    std::vector<GridInstance> instances;
+
+    for (int i = 0; i < GRID_SIZE; i++)
+    {
+        for (int j = 0; j < GRID_SIZE; j++)
+        {
+            const TextureManager::ArrayLayer &layer = gridLayers[(i + j) % gridLayers.size()];
+            GridInstance instance = { { -7.f + i * 0.3f, -7.f + j * 0.3f, 0.f }, { layer.array, layer.layer } };
+            instances.push_back(instance);
+        }
+    }
+
+    // instances of one draw must share the texture array - sort them into consecutive batches
+    std::stable_sort(instances.begin(), instances.end(), [](const GridInstance &a, const GridInstance &b) { return a.textureIndex[0] < b.textureIndex[0]; });
+
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        if (m_gridBatches.empty() || m_gridBatches.back().array != instances[i].textureIndex[0])
+        {
+            GridBatch batch = { instances[i].textureIndex[0], (int)i, 0 };
+            m_gridBatches.push_back(batch);
+        }
+
+        m_gridBatches.back().instanceCount++;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_gridInstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(GridInstance), &instances[0], GL_STATIC_DRAW);
+}
+
+void Application::OnRenderStart()
+{
+    if (!m_filterBenchmark)
+        return;
+
+    UpdateGridTimer();
+
+    if (m_filterBenchmark && !m_gridTimerPending)
+    {
+        glQueryCounter(m_gridTimerQueries[0], GL_TIMESTAMP);
+        m_gridTimerActive = true;
+    }
+}
+
+void Application::OnRenderFinish()
+{
+    if (!m_gridTimerActive)
+        return;
+
+    glQueryCounter(m_gridTimerQueries[1], GL_TIMESTAMP);
+    m_gridTimerActive  = false;
+    m_gridTimerPending = true;
+}
+
+void Application::UpdateGridTimer()
+{
+    if (!m_gridTimerPending)
+        return;
+
+    // don't stall waiting for the GPU - try again next frame
+    GLint available = 0;
+    glGetQueryObjectiv(m_gridTimerQueries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (!available)
+        return;
+
+    GLuint64 startNs = 0, endNs = 0;
+    glGetQueryObjectui64v(m_gridTimerQueries[0], GL_QUERY_RESULT, &startNs);
+    glGetQueryObjectui64v(m_gridTimerQueries[1], GL_QUERY_RESULT, &endNs);
+    m_gridTimerPending  = false;
+    m_benchmarkGpuTime += (endNs - startNs) * 1e-6;
+
+    if (++m_benchmarkFrames < BENCHMARK_FRAMES)
+        return;
+
+    // minified grid quads are bound by texture fetch bandwidth, so GPU time tracks the filtering cost
+    LOG_MESSAGE("[Texture] " << filterPresets[m_filterPreset].name << ": grid GPU time " << m_benchmarkGpuTime / m_benchmarkFrames << " ms ("
+                << (m_instancedRender ? "instanced" : m_batchedRender ? "batched" : "standard") << " rendering)");
+
+    m_benchmarkFrames  = 0;
+    m_benchmarkGpuTime = 0.0;
+
+    if (m_filterPreset + 1 < Filter_Count)
+    {
+        SetFilterPreset((FilterPreset)(m_filterPreset + 1));
+    }
+    else
+    {
+        m_filterBenchmark = false;
+        SetFilterPreset(m_benchmarkUserPreset);
+    }
+}
+
+void Application::SetFilterPreset(FilterPreset preset)
+{
+    m_filterPreset = preset;
+    TextureManager::GetInstance()->SetFiltering(filterPresets[preset].mipmaps, filterPresets[preset].anisotropy);
+
+    LOG_MESSAGE("[Texture] Filtering: " << filterPresets[preset].name);
+}
+
+void Application::StartFilterBenchmark()
+{
+    if (m_filterBenchmark)
+        return;
+
+    LOG_MESSAGE("[Texture] Starting filtering benchmark (" << BENCHMARK_FRAMES << " frames per preset)");
+
+    m_benchmarkUserPreset = m_filterPreset;
+    m_benchmarkFrames     = 0;
+    m_benchmarkGpuTime    = 0.0;
+    m_filterBenchmark     = true;
+    SetFilterPreset(Filter_Bilinear);
 }
 
 void Application::OnRender()
 {
+    if (m_batchedRender && !m_gridBatches.empty())
+    {
+        OnRenderBatched();
+        return;
+    }
+
     const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
 
-    GLuint vertexPosition_modelspaceID = glGetAttribLocation(shader.id, "inVertex");
-    GLuint vertexColorAttr = glGetAttribLocation(shader.id, "inVertexColor");
-    GLuint texCoordAttr = glGetAttribLocation(shader.id, "inTexCoord");
-    GLuint offsetAttr = glGetAttribLocation(shader.id, "inOffset");
+    GLuint vertexPosition_modelspaceID = shader.GetAttribLocation(SHADER_VAR("inVertex"));
+    GLuint vertexColorAttr = shader.GetAttribLocation(SHADER_VAR("inVertexColor"));
+    GLuint texCoordAttr = shader.GetAttribLocation(SHADER_VAR("inTexCoord"));
+    GLuint offsetAttr = shader.GetAttribLocation(SHADER_VAR("inOffset"));
 
     TextureManager::GetInstance()->BindTexture(m_texture);
 
-    for (int i = 0; i < 50; i++)
+    for (int i = 0; i < GRID_SIZE; i++)
     {
-        for (int j = 0; j < 50; j++)
+        for (int j = 0; j < GRID_SIZE; j++)
         {
             // setup quad data
             glBindVertexArray(m_vertexArray);
@@ -128,20 +311,85 @@ void Application::OnRender()
     }
 }
 
-void Application::OnRenderInstanced()
+void Application::OnRenderBatched()
+{
+    TextureManager *textureManager = TextureManager::GetInstance();
+    bool bindless = textureManager->BindlessArrays();
+    unsigned int features = ShaderManager::Feature_TextureArray | ShaderManager::Feature_VertexColor | (bindless ? ShaderManager::Feature_Bindless : 0);
+
+    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderVariant(features);
+
+    GLint vertexPosition_modelspaceID = shader.GetAttribLocation(SHADER_VAR("inVertex"));
+    GLint vertexColorAttr = shader.GetAttribLocation(SHADER_VAR("inVertexColor"));
+    GLint texCoordAttr = shader.GetAttribLocation(SHADER_VAR("inTexCoord"));
+    GLint offsetAttr = shader.GetAttribLocation(SHADER_VAR("inOffset"));
+    GLint textureIndexAttr = shader.GetAttribLocation(SHADER_VAR("inTextureIndex"));
+
+    // variant unavailable (fallback program is active)
+    if (textureIndexAttr < 0)
+        return;
+
+    glBindVertexArray(m_batchVertexArray);
+    glEnableVertexAttribArray(vertexPosition_modelspaceID);
+    glEnableVertexAttribArray(vertexColorAttr);
+    glEnableVertexAttribArray(texCoordAttr);
+    glEnableVertexAttribArray(offsetAttr);
+    glEnableVertexAttribArray(textureIndexAttr);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glVertexAttribPointer(vertexPosition_modelspaceID, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_colorBuffer);
+    glVertexAttribPointer(vertexColorAttr, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_texcoordBuffer);
+    glVertexAttribPointer(texCoordAttr, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    glVertexAttribDivisor(offsetAttr, 1);
+    glVertexAttribDivisor(textureIndexAttr, 1);
+
+    // bindless: every array is reachable from the TextureArrays block, no texture binds at all
+    if (bindless)
+        textureManager->BindTextureArrays();
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_gridInstanceBuffer);
+
+    for (size_t i = 0; i < m_gridBatches.size(); i++)
+    {
+        const GridBatch &batch = m_gridBatches[i];
+
+        if (!bindless)
+            textureManager->BindTextureArray(batch.array);
+
+        // no base instance in GL 4.1 - per instance attributes start at the batch's first instance
+        size_t base = batch.firstInstance * sizeof(GridInstance);
+        glVertexAttribPointer(offsetAttr, 3, GL_FLOAT, GL_FALSE, sizeof(GridInstance), (void*)(base + offsetof(GridInstance, offset)));
+        glVertexAttribIPointer(textureIndexAttr, 2, GL_INT, sizeof(GridInstance), (void*)(base + offsetof(GridInstance, textureIndex)));
+
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, batch.instanceCount);
+    }
+
+    glDisableVertexAttribArray(vertexPosition_modelspaceID);
+    glDisableVertexAttribArray(vertexColorAttr);
+    glDisableVertexAttribArray(texCoordAttr);
+    glDisableVertexAttribArray(offsetAttr);
+    glDisableVertexAttribArray(textureIndexAttr);
+}
+
+void Application::OnRenderInstanced(int viewCount)
 {
     const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShaderInstanced);
 
-    GLuint vertexPosition_modelspaceID = glGetAttribLocation(shader.id, "inVertex");
-    GLuint vertexColorAttr = glGetAttribLocation(shader.id, "inVertexColor");
-    GLuint texCoordAttr = glGetAttribLocation(shader.id, "inTexCoord");
-    GLuint offsetAttr = glGetAttribLocation(shader.id, "inOffset");
+    GLuint vertexPosition_modelspaceID = shader.GetAttribLocation(SHADER_VAR("inVertex"));
+    GLuint vertexColorAttr = shader.GetAttribLocation(SHADER_VAR("inVertexColor"));
+    GLuint texCoordAttr = shader.GetAttribLocation(SHADER_VAR("inTexCoord"));
+    GLuint offsetAttr = shader.GetAttribLocation(SHADER_VAR("inOffset"));
 
     TextureManager::GetInstance()->BindTexture(m_texture);
 
-    for (int i = 0; i < 50; i++)
+    for (int i = 0; i < GRID_SIZE; i++)
     {
-        for (int j = 0; j < 50; j++)
+        for (int j = 0; j < GRID_SIZE; j++)
         {
             // setup quad data
             glBindVertexArray(m_vertexArray);
@@ -172,8 +420,8 @@ void Application::OnRenderInstanced()
             glBufferData(GL_ARRAY_BUFFER, sizeof(offset), offset, GL_STATIC_DRAW);
             glVertexAttribPointer(offsetAttr, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
 
-            // draw the scene twice using instancing
-            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 2);
+            // draw the scene once per view using instancing
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, viewCount);
 
             glDisableVertexAttribArray(vertexPosition_modelspaceID);
             glDisableVertexAttribArray(vertexColorAttr);
@@ -192,6 +440,21 @@ void Application::OnKeyPress(KeyCode key)
         break;
     case KEY_R:
         m_instancedRender = !m_instancedRender;
+        break;
+    case KEY_M:
+        m_spectatorView = !m_spectatorView;
+        break;
+    case KEY_A:
+        m_batchedRender = !m_batchedRender;
+        LOG_MESSAGE("[Texture] Batched grid rendering: " << (m_batchedRender ? "on" : "off") << " (" << m_gridBatches.size() << " draws)");
+        break;
+    case KEY_F:
+        if (!m_filterBenchmark)
+            SetFilterPreset((FilterPreset)((m_filterPreset + 1) % Filter_Count));
+        break;
+    case KEY_T:
+        StartFilterBenchmark();
+        break;
     default:
         break;
     } 
@@ -4,6 +4,7 @@
 #include "InputHandlers.hpp"
 #include "renderer/OpenGL.hpp"
 #include "renderer/Texture.hpp"
+#include <vector>
 
 /*
  * main application 
@@ -11,24 +12,56 @@
 class Application
 {
 public:
-    Application::Application() : m_running(true)
+    Application::Application() : m_running(true), m_instancedRender(false), m_spectatorView(false), m_batchedRender(false),
+                                 m_filterPreset(Filter_TrilinearAniso4x), m_filterBenchmark(false), m_gridTimerActive(false), m_gridTimerPending(false)
     {
     }
 
     ~Application();
 
+    // texture filtering presets compared by the filtering benchmark
+    enum FilterPreset
+    {
+        Filter_Bilinear,          // no mips (previous Texture::Load behavior)
+        Filter_Trilinear,
+        Filter_TrilinearAniso4x,  // TextureManager default
+        Filter_TrilinearAniso16x,
+        Filter_Count
+    };
+
     void OnStart();
+    void OnRenderStart();   // grid GPU timing for filtering benchmark - wraps all views of a frame
+    void OnRenderFinish();
     void OnRender();
-    void OnRenderInstanced();
+    void OnRenderInstanced(int viewCount);
+    void OnRenderBatched();   // whole grid in one instanced draw per texture array
 
     inline bool Running() const  { return m_running; }
     inline void Terminate()      { m_running = false; }
     inline bool InstancedRender() const { return m_instancedRender; }
+    inline bool SpectatorView() const   { return m_spectatorView; }
 
     void OnKeyPress(KeyCode key);
 private:
+    void SetFilterPreset(FilterPreset preset);
+    void StartFilterBenchmark();   // cycle through all filter presets and log average grid GPU time
+    void UpdateGridTimer();
+    void CreateBatchedGrid();
+
     bool m_running;
     bool m_instancedRender;
+    bool m_spectatorView;
+    bool m_batchedRender;
+
+    // texture filtering benchmark (timestamps - OculusVR fill rate benchmark uses a GL_TIME_ELAPSED query at the same time)
+    FilterPreset m_filterPreset;
+    FilterPreset m_benchmarkUserPreset;
+    bool   m_filterBenchmark;
+    bool   m_gridTimerActive;
+    bool   m_gridTimerPending;
+    GLuint m_gridTimerQueries[2];
+    int    m_benchmarkFrames;
+    double m_benchmarkGpuTime;
 
     // rendered quad data
     GLuint m_vertexBuffer;
@@ -36,8 +69,26 @@ private:
     GLuint m_texcoordBuffer;
     GLuint m_quadOffsetBuffer;
     GLuint m_vertexArray;
-    Texture *m_texture;
+    TextureHandle m_texture;
+
+    // per instance data of batched grid - offset and (texture array, layer)
+    struct GridInstance
+    {
+        GLfloat offset[3];
+        GLint   textureIndex[2];
+    };
+
+    // consecutive grid instances sharing a texture array
+    struct GridBatch
+    {
+        int array;
+        int firstInstance;
+        int instanceCount;
+    };
 
+    GLuint m_batchVertexArray;
+    GLuint m_gridInstanceBuffer;
+    std::vector<GridBatch> m_gridBatches;
 };
 
 #endif
@@ -1,15 +1,38 @@
 #include "OculusVRInstanced.hpp"
 #include "renderer/ShaderManager.hpp"
 
+// multi-res preset settings: center region size (fraction of eye NDC extent) and border pixel density
+static const struct
+{
+    const char *name;
+    float       centerSize;
+    float       borderDensity;
+} multiResPresets[] = { { "Off",         1.0f, 1.0f  },
+                        { "Quality",     0.7f, 0.7f  },
+                        { "Balanced",    0.6f, 0.5f  },
+                        { "Performance", 0.5f, 0.35f } };
+
+// number of GPU timer samples taken per preset in fill rate benchmark
+static const int BENCHMARK_FRAMES = 300;
+
+static int NdcToPixel(float ndc, int size)
+{
+    return (int)((ndc + 1.f) * 0.5f * size + 0.5f);
+}
 
-OculusVR::RenderBuffer::RenderBuffer(const ovrSession &session)
+
+OculusVR::RenderBuffer::RenderBuffer(const ovrSession &session, const ovrSizei &spectatorSize)
 {
     ovrHmdDesc hmdDesc = ovr_GetHmdDesc(session);
     ovrSizei eyeTextureSize0 = ovr_GetFovTextureSize(session, ovrEye_Left, hmdDesc.DefaultEyeFov[0], 1.0f);
     ovrSizei eyeTextureSize1 = ovr_GetFovTextureSize(session, ovrEye_Right, hmdDesc.DefaultEyeFov[1], 1.0f);
 
-    m_bufferSize.w = eyeTextureSize0.w + eyeTextureSize1.w;
-    m_bufferSize.h = max(eyeTextureSize0.h, eyeTextureSize1.h);
+    m_eyesSize.w = eyeTextureSize0.w + eyeTextureSize1.w;
+    m_eyesSize.h = max(eyeTextureSize0.h, eyeTextureSize1.h);
+
+    // spectator view (if any) is stacked on top of the eyes so all views can be rendered in one instanced pass
+    m_bufferSize.w = max(m_eyesSize.w, spectatorSize.w);
+    m_bufferSize.h = m_eyesSize.h + spectatorSize.h;
 
     ovrTextureSwapChainDesc desc = {};
     desc.Type = ovrTexture_2D;
@@ -161,6 +184,169 @@ void OculusVR::RenderBuffer::Destroy(const ovrSession &session)
     ovr_DestroyTextureSwapChain(session, m_swapTextureChain);
 }
 
+OculusVR::MultiResBuffer::MultiResBuffer(const ovrSizei &eyeSize, float centerSize, float borderDensity) : m_shadedPixels(0)
+{
+    // cell bounds in eye NDC space: x0, x1, y0, y1
+    const float c = centerSize;
+    const float cellNdc[CELL_COUNT][4] = { {   -c,    c,   -c,   c },    // center
+                                           { -1.f,   -c, -1.f, 1.f },    // left
+                                           {    c,  1.f, -1.f, 1.f },    // right
+                                           {   -c,    c, -1.f,  -c },    // bottom
+                                           {   -c,    c,    c, 1.f } };  // top
+
+    const float cellDensity[CELL_COUNT] = { 1.f, borderDensity, borderDensity, borderDensity, borderDensity };
+    ovrSizei cellSize[CELL_COUNT];
+
+    for (int i = 0; i < CELL_COUNT; i++)
+    {
+        const float *ndc = cellNdc[i];
+
+        // cell edges in eye texture are rounded the same way for all cells, so they tile without gaps
+        int x0 = NdcToPixel(ndc[0], eyeSize.w);
+        int x1 = NdcToPixel(ndc[1], eyeSize.w);
+        int y0 = NdcToPixel(ndc[2], eyeSize.h);
+        int y1 = NdcToPixel(ndc[3], eyeSize.h);
+
+        m_dstRect[ovrEye_Left][i]  = OVR::Recti(x0, y0, x1 - x0, y1 - y0);
+        m_dstRect[ovrEye_Right][i] = OVR::Recti(x0 + eyeSize.w, y0, x1 - x0, y1 - y0);
+
+        cellSize[i].w = max(1, (int)((x1 - x0) * cellDensity[i] + 0.5f));
+        cellSize[i].h = max(1, (int)((y1 - y0) * cellDensity[i] + 0.5f));
+
+        // scale/bias in clip space, so that the cell area of eye frustum covers the entire cell viewport
+        float sx = 2.f / (ndc[1] - ndc[0]);
+        float sy = 2.f / (ndc[3] - ndc[2]);
+        float bx = -(ndc[0] + ndc[1]) / (ndc[1] - ndc[0]);
+        float by = -(ndc[2] + ndc[3]) / (ndc[3] - ndc[2]);
+
+        m_cellRemap[i] = OVR::Matrix4f(  sx, 0.f, 0.f,  bx,
+                                        0.f,  sy, 0.f,  by,
+                                        0.f, 0.f, 1.f, 0.f,
+                                        0.f, 0.f, 0.f, 1.f);
+    }
+
+    // pack cells of each eye as: [left | bottom, center, top | right]
+    int columnWidth = max(cellSize[Cell_Center].w, max(cellSize[Cell_Bottom].w, cellSize[Cell_Top].w));
+    int columnHeight = cellSize[Cell_Bottom].h + cellSize[Cell_Center].h + cellSize[Cell_Top].h;
+    int eyeWidth = cellSize[Cell_Left].w + columnWidth + cellSize[Cell_Right].w;
+    int eyeHeight = max(columnHeight, max(cellSize[Cell_Left].h, cellSize[Cell_Right].h));
+
+    for (int eye = 0; eye < ovrEye_Count; eye++)
+    {
+        int x = eye * eyeWidth;
+        int columnX = x + cellSize[Cell_Left].w;
+
+        m_srcRect[eye][Cell_Left]   = OVR::Recti(x, 0, cellSize[Cell_Left].w, cellSize[Cell_Left].h);
+        m_srcRect[eye][Cell_Bottom] = OVR::Recti(columnX, 0, cellSize[Cell_Bottom].w, cellSize[Cell_Bottom].h);
+        m_srcRect[eye][Cell_Center] = OVR::Recti(columnX, cellSize[Cell_Bottom].h, cellSize[Cell_Center].w, cellSize[Cell_Center].h);
+        m_srcRect[eye][Cell_Top]    = OVR::Recti(columnX, cellSize[Cell_Bottom].h + cellSize[Cell_Center].h, cellSize[Cell_Top].w, cellSize[Cell_Top].h);
+        m_srcRect[eye][Cell_Right]  = OVR::Recti(columnX + columnWidth, 0, cellSize[Cell_Right].w, cellSize[Cell_Right].h);
+
+        for (int i = 0; i < CELL_COUNT; i++)
+            m_shadedPixels += cellSize[i].w * cellSize[i].h;
+    }
+
+    m_size.w = eyeWidth * ovrEye_Count;
+    m_size.h = eyeHeight;
+
+    glGenFramebuffers(1, &m_fbo);
+    glGenVertexArrays(1, &m_vertexArray);
+
+    // same format as the swap chain texture
+    glGenTextures(1, &m_colorTex);
+    glBindTexture(GL_TEXTURE_2D, m_colorTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, m_size.w, m_size.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glGenTextures(1, &m_depthBuffer);
+    glBindTexture(GL_TEXTURE_2D, m_depthBuffer);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_size.w, m_size.h, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTex, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthBuffer, 0);
+
+    LOG_MESSAGE_ASSERT((glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE), "Could not create multi-res framebuffer");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OculusVR::MultiResBuffer::OnRenderStart()
+{
+    // Switch to multi-res render target
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, m_size.w, m_size.h);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void OculusVR::MultiResBuffer::Composite(GLuint eyeFbo, GLuint eyeTexId)
+{
+    // upscale each cell into its place in the swap chain texture - cells cover the whole eye, so no clear is needed
+    glBindFramebuffer(GL_FRAMEBUFFER, eyeFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, eyeTexId, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+
+    LOG_MESSAGE_ASSERT((glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE), "Could not complete framebuffer operation");
+
+    // cells are packed edge to edge - shader clamps sampling to each cell instead of a plain linear blit, which would bleed neighbours in
+    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::MultiResCompositeShader);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_colorTex);
+
+    // texture() decodes sRGB, so encode the result back on write
+    GLboolean depthOn = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_FRAMEBUFFER_SRGB);
+
+    glBindVertexArray(m_vertexArray);
+
+    for (int eye = 0; eye < ovrEye_Count; eye++)
+    {
+        for (int i = 0; i < CELL_COUNT; i++)
+        {
+            const ovrRecti &src = m_srcRect[eye][i];
+            const ovrRecti &dst = m_dstRect[eye][i];
+
+            glViewport(dst.Pos.x, dst.Pos.y, dst.Size.w, dst.Size.h);
+            glUniform4f(shader.uniforms[SourceRect], (float)src.Pos.x, (float)src.Pos.y, (float)src.Size.w, (float)src.Size.h);
+            glUniform4f(shader.uniforms[DestRect], (float)dst.Pos.x, (float)dst.Pos.y, 1.f / dst.Size.w, 1.f / dst.Size.h);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+
+    glBindVertexArray(0);
+
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    if (depthOn)
+        glEnable(GL_DEPTH_TEST);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OculusVR::MultiResBuffer::Destroy()
+{
+    if (glIsFramebuffer(m_fbo))
+        glDeleteFramebuffers(1, &m_fbo);
+
+    if (glIsTexture(m_colorTex))
+        glDeleteTextures(1, &m_colorTex);
+
+    if (glIsTexture(m_depthBuffer))
+        glDeleteTextures(1, &m_depthBuffer);
+
+    if (glIsVertexArray(m_vertexArray))
+        glDeleteVertexArrays(1, &m_vertexArray);
+}
+
 OculusVR::~OculusVR()
 {
     ovr_Destroy(m_hmdSession);
@@ -204,7 +390,23 @@ bool OculusVR::InitVRBuffers(int windowWidth, int windowHeight)
         m_eyeRenderDesc[eyeIdx] = ovr_GetRenderDesc(m_hmdSession, (ovrEyeType)eyeIdx, m_hmdDesc.DefaultEyeFov[eyeIdx]);
     }
 
-    m_renderBuffer = new RenderBuffer(m_hmdSession);
+    // number of views we can output in a single pass is limited by available viewports
+    GLint maxViewports = 0;
+    glGetIntegerv(GL_MAX_VIEWPORTS, &maxViewports);
+    m_maxViews = min((int)maxViewports, MAX_VIEWS);
+
+    // spectator view is rendered at mirror window resolution (only if there's a viewport to spare)
+    m_spectatorSize.w = m_maxViews > View_Spectator ? windowWidth  : 0;
+    m_spectatorSize.h = m_maxViews > View_Spectator ? windowHeight : 0;
+
+    m_renderBuffer = new RenderBuffer(m_hmdSession, m_spectatorSize);
+
+    const ovrSizei &eyesSize = m_renderBuffer->m_eyesSize;
+    m_eyeViewports[ovrEye_Left]  = OVR::Recti(0, 0, eyesSize.w / 2, eyesSize.h);
+    m_eyeViewports[ovrEye_Right] = OVR::Recti(eyesSize.w / 2, 0, eyesSize.w / 2, eyesSize.h);
+
+    // used for fill rate benchmark
+    glGenQueries(1, &m_gpuTimerQuery);
 
     memset(&m_mirrorDesc, 0, sizeof(m_mirrorDesc));
     m_mirrorDesc.Width  = windowWidth;
@@ -308,6 +510,16 @@ void OculusVR::DestroyVR()
 
         ovr_DestroyMirrorTexture(m_hmdSession, m_mirrorTexture);
 
+        if (glIsQuery(m_gpuTimerQuery))
+            glDeleteQueries(1, &m_gpuTimerQuery);
+
+        if (m_multiResBuffer)
+        {
+            m_multiResBuffer->Destroy();
+            delete m_multiResBuffer;
+            m_multiResBuffer = nullptr;
+        }
+
         m_renderBuffer->Destroy(m_hmdSession);
         delete m_renderBuffer;
         m_renderBuffer = nullptr;
@@ -332,41 +544,239 @@ void OculusVR::OnRenderStart()
     // Get both eye poses simultaneously, with IPD offset already included.
     ovr_GetEyePoses(m_hmdSession, m_frameIndex, ovrTrue, m_hmdToEyeOffset, m_eyeRenderPose, &m_sensorSampleTime);    
 
+    ShaderManager::GetInstance()->UpdateFrameConstants(m_frameTiming);
+
+    for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
+    {
+        m_projectionMatrix[eyeIndex] = OVR::Matrix4f(ovrMatrix4f_Projection(m_eyeRenderDesc[eyeIndex].Fov, 0.01f, 10000.0f, ovrProjection_None));
+        m_eyeOrientation[eyeIndex]   = OVR::Matrix4f(OVR::Quatf(m_eyeRenderPose[eyeIndex].Orientation).Inverted());
+        m_eyePose[eyeIndex]          = OVR::Matrix4f::Translation(-OVR::Vector3f(m_eyeRenderPose[eyeIndex].Position));
+        m_eyeMVP[eyeIndex]           = m_projectionMatrix[eyeIndex] * m_eyeOrientation[eyeIndex] * m_eyePose[eyeIndex];
+    }
+
+    // benchmark may switch multi-res preset, so views are set up afterwards
+    UpdateGpuTimer();
+    UpdateViews();
+
     // set the render texture in swap chain
     int curIndex;
     ovr_GetTextureSwapChainCurrentIndex(m_hmdSession, m_renderBuffer->m_swapTextureChain, &curIndex);
     ovr_GetTextureSwapChainBufferGL(m_hmdSession, m_renderBuffer->m_swapTextureChain, curIndex, &m_renderBuffer->m_eyeTexId);
 
-    if (m_msaaEnabled)
+    // GPU time is only measured while benchmarking
+    if (m_benchmarkActive && !m_gpuTimerPending)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, m_gpuTimerQuery);
+        m_gpuTimerActive = true;
+    }
+
+    if (m_multiResBuffer)
+        m_multiResBuffer->OnRenderStart();
+    else if (m_msaaEnabled)
         m_renderBuffer->OnRenderMSAAStart();
     else
         m_renderBuffer->OnRenderStart();
 }
 
-const OVR::Matrix4f OculusVR::OnEyeRender(int eyeIndex)
+void OculusVR::UpdateViews()
 {
-    m_renderBuffer->OnRender(m_eyeLayer.Viewport[eyeIndex]);
+    if (m_multiResBuffer)
+    {
+        // every multi-res cell of each eye is a separate view
+        m_viewCount = ovrEye_Count * CELL_COUNT;
+
+        for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
+        {
+            for (int i = 0; i < CELL_COUNT; i++)
+            {
+                int view = eyeIndex * CELL_COUNT + i;
+
+                m_viewports[view]      = m_multiResBuffer->m_srcRect[eyeIndex][i];
+                m_viewProjection[view] = m_multiResBuffer->m_cellRemap[i] * m_projectionMatrix[eyeIndex];
+                m_viewMatrix[view]     = m_eyeOrientation[eyeIndex] * m_eyePose[eyeIndex];
+                m_viewPosition[view]   = m_eyeRenderPose[eyeIndex].Position;
+                m_viewMVP[view]        = m_viewProjection[view] * m_viewMatrix[view];
+            }
+        }
+
+        return;
+    }
+
+    m_viewCount = m_spectatorEnabled ? View_Spectator + 1 : ovrEye_Count;
 
-    m_projectionMatrix[eyeIndex] = OVR::Matrix4f(ovrMatrix4f_Projection(m_eyeRenderDesc[eyeIndex].Fov, 0.01f, 10000.0f, ovrProjection_None));
-    m_eyeOrientation[eyeIndex]   = OVR::Matrix4f(OVR::Quatf(m_eyeRenderPose[eyeIndex].Orientation).Inverted());
-    m_eyePose[eyeIndex]          = OVR::Matrix4f::Translation(-OVR::Vector3f(m_eyeRenderPose[eyeIndex].Position));
+    for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
+    {
+        m_viewports[eyeIndex]      = m_eyeViewports[eyeIndex];
+        m_viewProjection[eyeIndex] = m_projectionMatrix[eyeIndex];
+        m_viewMatrix[eyeIndex]     = m_eyeOrientation[eyeIndex] * m_eyePose[eyeIndex];
+        m_viewPosition[eyeIndex]   = m_eyeRenderPose[eyeIndex].Position;
+        m_viewMVP[eyeIndex]        = m_eyeMVP[eyeIndex];
+    }
 
-    return m_projectionMatrix[eyeIndex] * m_eyeOrientation[eyeIndex] * m_eyePose[eyeIndex];
+    if (m_spectatorEnabled)
+    {
+        m_viewports[View_Spectator] = OVR::Recti(0, m_renderBuffer->m_eyesSize.h, m_spectatorSize.w, m_spectatorSize.h);
+
+        // undistorted center eye camera with symmetric FOV matching the spectator viewport aspect ratio
+        const ovrFovPort &fovL = m_eyeRenderDesc[ovrEye_Left].Fov;
+        const ovrFovPort &fovR = m_eyeRenderDesc[ovrEye_Right].Fov;
+        float vTan = max(max(fovL.UpTan, fovR.UpTan), max(fovL.DownTan, fovR.DownTan));
+        float hTan = vTan * (float)m_spectatorSize.w / (float)m_spectatorSize.h;
+        ovrFovPort spectatorFov = { vTan, vTan, hTan, hTan };
+
+        OVR::Vector3f centerEyePos = (OVR::Vector3f(m_eyeRenderPose[ovrEye_Left].Position) + OVR::Vector3f(m_eyeRenderPose[ovrEye_Right].Position)) * 0.5f;
+
+        m_viewProjection[View_Spectator] = OVR::Matrix4f(ovrMatrix4f_Projection(spectatorFov, 0.01f, 10000.0f, ovrProjection_None));
+        m_viewMatrix[View_Spectator]     = OVR::Matrix4f(OVR::Quatf(m_eyeRenderPose[ovrEye_Left].Orientation).Inverted()) *
+                                           OVR::Matrix4f::Translation(-centerEyePos);
+        m_viewPosition[View_Spectator]   = centerEyePos;
+        m_viewMVP[View_Spectator]        = m_viewProjection[View_Spectator] * m_viewMatrix[View_Spectator];
+    }
+}
+
+void OculusVR::UpdateGpuTimer()
+{
+    if (!m_gpuTimerPending)
+        return;
+
+    // don't stall waiting for the GPU - try again next frame
+    GLint available = 0;
+    glGetQueryObjectiv(m_gpuTimerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (!available)
+        return;
+
+    GLuint64 elapsedNs = 0;
+    glGetQueryObjectui64v(m_gpuTimerQuery, GL_QUERY_RESULT, &elapsedNs);
+    m_gpuTimerPending = false;
+
+    if (!m_benchmarkActive)
+        return;
+
+    m_benchmarkGpuTime += elapsedNs * 1e-6;
+
+    if (++m_benchmarkFrames < BENCHMARK_FRAMES)
+        return;
+
+    const ovrSizei &eyesSize = m_renderBuffer->m_eyesSize;
+    int fullPixels   = eyesSize.w * eyesSize.h;
+    int shadedPixels = m_multiResBuffer ? m_multiResBuffer->m_shadedPixels : fullPixels;
+
+    LOG_MESSAGE("[MultiRes] " << multiResPresets[m_multiResPreset].name << ": " << shadedPixels << " px/frame ("
+                << 100.f * shadedPixels / fullPixels << "% of full resolution), GPU: " << m_benchmarkGpuTime / m_benchmarkFrames << " ms");
+
+    m_benchmarkFrames  = 0;
+    m_benchmarkGpuTime = 0.0;
+
+    if (m_multiResPreset + 1 < MultiRes_Count)
+    {
+        SetMultiResPreset((MultiResPreset)(m_multiResPreset + 1));
+    }
+    else
+    {
+        m_benchmarkActive = false;
+        SetMultiResPreset(m_benchmarkUserPreset);
+    }
+}
+
+const OVR::Matrix4f OculusVR::OnEyeRender(int viewIndex)
+{
+    LOG_MESSAGE_ASSERT(viewIndex < m_viewCount, "Invalid view index: " << viewIndex);
+
+    // view matrices are already calculated in OnRenderStart()
+    m_renderBuffer->OnRender(m_viewports[viewIndex]);
+
+    // non-instanced programs read view matrices from the shared block
+    ViewConstants constants;
+    memcpy(constants.viewProjectionMatrix, &m_viewMVP[viewIndex].Transposed().M[0][0], sizeof(constants.viewProjectionMatrix));
+    memcpy(constants.viewMatrix, &m_viewMatrix[viewIndex].Transposed().M[0][0], sizeof(constants.viewMatrix));
+    memcpy(constants.projectionMatrix, &m_viewProjection[viewIndex].Transposed().M[0][0], sizeof(constants.projectionMatrix));
+
+    constants.eyePosition[0] = m_viewPosition[viewIndex].x;
+    constants.eyePosition[1] = m_viewPosition[viewIndex].y;
+    constants.eyePosition[2] = m_viewPosition[viewIndex].z;
+    constants.eyePosition[3] = 1.f;
+
+    ShaderManager::GetInstance()->UpdateViewConstants(viewIndex, constants);
+
+    return m_viewMVP[viewIndex];
 }
 
 void OculusVR::OnRenderFinish()
 {
-   if (m_msaaEnabled)
-       m_renderBuffer->OnRenderMSAAFinish();
+    if (m_multiResBuffer)
+        m_multiResBuffer->Composite(m_renderBuffer->m_eyeFbo, m_renderBuffer->m_eyeTexId);
+    else if (m_msaaEnabled)
+        m_renderBuffer->OnRenderMSAAFinish();
     else
         m_renderBuffer->OnRenderFinish();
 
+    if (m_gpuTimerActive)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_gpuTimerActive  = false;
+        m_gpuTimerPending = true;
+    }
+
+    if (m_spectatorEnabled)
+        BlitSpectatorMirror();
+
     ovr_CommitTextureSwapChain(m_hmdSession, m_renderBuffer->m_swapTextureChain);
 }
 
-const OVR::Matrix4f OculusVR::GetEyeMVPMatrix(int eyeIndex) const
+const OVR::Matrix4f OculusVR::GetEyeMVPMatrix(int viewIndex) const
+{
+    return m_viewMVP[viewIndex];
+}
+
+void OculusVR::SetSpectatorView(bool val)
+{
+    // spectator view requires a spare viewport (GL_MAX_VIEWPORTS > 2) and is not rendered in multi-res mode
+    m_spectatorEnabled = val && m_spectatorSize.w > 0 && !m_multiResBuffer;
+}
+
+void OculusVR::SetMultiResPreset(MultiResPreset preset)
+{
+    if (preset == m_multiResPreset)
+        return;
+
+    if (preset != MultiRes_Off && m_maxViews < ovrEye_Count * CELL_COUNT)
+    {
+        LOG_MESSAGE("[MultiRes] Not enough viewports available for multi-res rendering.");
+        return;
+    }
+
+    if (m_multiResBuffer)
+    {
+        m_multiResBuffer->Destroy();
+        delete m_multiResBuffer;
+        m_multiResBuffer = nullptr;
+    }
+
+    m_multiResPreset = preset;
+
+    if (preset != MultiRes_Off)
+    {
+        ovrSizei eyeSize = { m_renderBuffer->m_eyesSize.w / 2, m_renderBuffer->m_eyesSize.h };
+        m_multiResBuffer = new MultiResBuffer(eyeSize, multiResPresets[preset].centerSize, multiResPresets[preset].borderDensity);
+        m_spectatorEnabled = false;
+    }
+
+    LOG_MESSAGE("[MultiRes] Preset: " << multiResPresets[preset].name);
+}
+
+void OculusVR::StartFillRateBenchmark()
 {
-    return m_projectionMatrix[eyeIndex] * m_eyeOrientation[eyeIndex] * m_eyePose[eyeIndex];
+    if (m_benchmarkActive)
+        return;
+
+    LOG_MESSAGE("[MultiRes] Starting fill rate benchmark (" << BENCHMARK_FRAMES << " frames per preset)");
+
+    m_benchmarkUserPreset = m_multiResPreset;
+    m_benchmarkFrames     = 0;
+    m_benchmarkGpuTime    = 0.0;
+    m_benchmarkActive     = true;
+    SetMultiResPreset(MultiRes_Off);
 }
 
 void OculusVR::SubmitFrame()
@@ -384,8 +794,8 @@ void OculusVR::SubmitFrame()
     m_eyeLayer.ColorTexture[1] = m_renderBuffer->m_swapTextureChain;
     m_eyeLayer.Fov[0] = m_hmdDesc.DefaultEyeFov[0];
     m_eyeLayer.Fov[1] = m_hmdDesc.DefaultEyeFov[1];
-    m_eyeLayer.Viewport[0] = OVR::Recti(0, 0, m_renderBuffer->m_bufferSize.w / 2, m_renderBuffer->m_bufferSize.h);
-    m_eyeLayer.Viewport[1] = OVR::Recti(m_renderBuffer->m_bufferSize.w / 2, 0, m_renderBuffer->m_bufferSize.w / 2, m_renderBuffer->m_bufferSize.h);
+    m_eyeLayer.Viewport[0] = m_eyeViewports[ovrEye_Left];
+    m_eyeLayer.Viewport[1] = m_eyeViewports[ovrEye_Right];
     m_eyeLayer.RenderPose[0] = m_eyeRenderPose[0];
     m_eyeLayer.RenderPose[1] = m_eyeRenderPose[1];
     m_eyeLayer.SensorSampleTime = m_sensorSampleTime;
@@ -422,6 +832,22 @@ void OculusVR::BlitMirror(ovrEyeType numEyes, int offset)
     glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 }
 
+void OculusVR::BlitSpectatorMirror()
+{
+    LOG_MESSAGE_ASSERT(m_spectatorEnabled, "Spectator view not enabled!");
+
+    // spectator region of the resolved swap chain texture is blitted straight to back buffer
+    const ovrRecti &vp = m_viewports[View_Spectator];
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_renderBuffer->m_eyeFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_renderBuffer->m_eyeTexId, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(vp.Pos.x, vp.Pos.y, vp.Pos.x + vp.Size.w, vp.Pos.y + vp.Size.h,
+                      0, 0, m_mirrorDesc.Width, m_mirrorDesc.Height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
 void OculusVR::OnNonDistortMirrorStart()
 {
     LOG_MESSAGE_ASSERT(glIsFramebuffer(m_nonDistortFBO), "Non-distort mirror FBO not initialized!");
@@ -454,6 +880,13 @@ void OculusVR::OnKeyPress(KeyCode key)
     case KEY_SPACE:
         ovr_RecenterTrackingOrigin(m_hmdSession);
         break;
+    case KEY_P:
+        if (!m_benchmarkActive)
+            SetMultiResPreset((MultiResPreset)((m_multiResPreset + 1) % MultiRes_Count));
+        break;
+    case KEY_B:
+        StartFillRateBenchmark();
+        break;
     }
 }
 
@@ -474,8 +907,8 @@ void OculusVR::RenderDebug()
     LOG_MESSAGE_ASSERT(m_debugData, "Debug data not created!");
 
     // Rendered size changes based on selected options & dynamic rendering.
-    int pixelSizeWidth = m_renderBuffer->m_bufferSize.w;
-    int pixelSizeHeight = m_renderBuffer->m_bufferSize.h;
+    int pixelSizeWidth = m_renderBuffer->m_eyesSize.w;
+    int pixelSizeHeight = m_renderBuffer->m_eyesSize.h;
 
     ovrSizei texSize = { pixelSizeWidth, pixelSizeHeight };
     m_debugData->OnRender(m_hmdSession, m_trackingState, m_eyeRenderDesc, texSize);
@@ -15,13 +15,43 @@
 class OculusVR
 {
 public:
+    // maximum number of views rendered in a single instanced pass (must match MAX_VIEWS in BasicVariant.vsh)
+    static const int MAX_VIEWS = 16;
+
+    // view indices: both eyes are always present, extra views follow
+    enum ViewIndex
+    {
+        View_LeftEye  = ovrEye_Left,
+        View_RightEye = ovrEye_Right,
+        View_Spectator
+    };
+
+    // multi-resolution rendering presets (size of full density center region and border pixel density)
+    enum MultiResPreset
+    {
+        MultiRes_Off,
+        MultiRes_Quality,
+        MultiRes_Balanced,
+        MultiRes_Performance,
+        MultiRes_Count
+    };
+
     OculusVR() : m_hmdSession(nullptr),
                  m_debugData(nullptr),
                  m_cameraFrustum(nullptr),
                  m_trackerChaperone(nullptr),
                  m_msaaEnabled(false),
                  m_frameIndex(0),
-                 m_sensorSampleTime(0)
+                 m_sensorSampleTime(0),
+                 m_viewCount(ovrEye_Count),
+                 m_maxViews(ovrEye_Count),
+                 m_spectatorEnabled(false),
+                 m_multiResBuffer(nullptr),
+                 m_multiResPreset(MultiRes_Off),
+                 m_gpuTimerQuery(0),
+                 m_gpuTimerActive(false),
+                 m_gpuTimerPending(false),
+                 m_benchmarkActive(false)
     {
     }
 
@@ -32,9 +62,9 @@ public:
     void  DestroyVR();
     const ovrSizei GetResolution() const;
     void  OnRenderStart();
-    const OVR::Matrix4f OnEyeRender(int eyeIndex);
+    const OVR::Matrix4f OnEyeRender(int viewIndex);   // accepts any view index (eyes and extra views)
     void  OnRenderFinish();
-    const OVR::Matrix4f GetEyeMVPMatrix(int eyeIdx) const;
+    const OVR::Matrix4f GetEyeMVPMatrix(int viewIdx) const;
     void  SubmitFrame();
 
     void  BlitMirror(ovrEyeType numEyes=ovrEye_Count, int offset = 0);   // regular OculusVR mirror view
@@ -49,14 +79,21 @@ public:
     void  RenderTrackerChaperone();
     bool  IsDebugHMD() const { return (m_hmdDesc.AvailableHmdCaps & ovrHmdCap_DebugDevice) != 0; }
     void  ShowPerfStats(ovrPerfHudMode statsMode);
-    ovrRecti GetEyeViewport(int eyeIdx) { return m_eyeLayer.Viewport[eyeIdx]; } // used to get specific eye viewport (for instanced rendering)
+    ovrRecti GetEyeViewport(int viewIdx) const { return m_viewports[viewIdx]; } // used to get specific view viewport (for instanced rendering)
+    int   GetViewCount() const { return m_viewCount; }
+    void  SetSpectatorView(bool val);
+    bool  SpectatorViewEnabled() const { return m_spectatorEnabled; }
+    void  SetMultiResPreset(MultiResPreset preset);
+    MultiResPreset GetMultiResPreset() const { return m_multiResPreset; }
+    void  StartFillRateBenchmark();   // cycle through all multi-res presets and log shaded pixel count and GPU time
     void  SetMSAA(bool val) { m_msaaEnabled = val; }
     bool  MSAAEnabled() const { return m_msaaEnabled; }
 private:
     // single render buffer for Oculus Rift that will contain both eyes
+    // and an optional spectator region placed above them
     struct RenderBuffer
     {
-        RenderBuffer(const ovrSession &session);
+        RenderBuffer(const ovrSession &session, const ovrSizei &spectatorSize);
         void OnRenderStart();
         void OnRender(const ovrRecti &viewPort);
         void OnRenderFinish();
@@ -66,6 +103,7 @@ private:
         void Destroy(const ovrSession &session);
 
         ovrSizei   m_bufferSize;
+        ovrSizei   m_eyesSize;       // area occupied by both eyes (bottom of the buffer)
         GLuint     m_eyeFbo      = 0;
         GLuint     m_eyeTexId    = 0;
         GLuint     m_depthBuffer = 0;
@@ -77,6 +115,41 @@ private:
         ovrTextureSwapChain m_swapTextureChain = nullptr;
     };
 
+    // per-eye multi-resolution layout: full density center cell surrounded by four lower density borders
+    enum MultiResCell
+    {
+        Cell_Center,
+        Cell_Left,
+        Cell_Right,
+        Cell_Bottom,
+        Cell_Top,
+        CELL_COUNT
+    };
+
+    // offscreen buffer holding all multi-res cells of both eyes, composited into the swap chain texture at frame end
+    struct MultiResBuffer
+    {
+        MultiResBuffer(const ovrSizei &eyeSize, float centerSize, float borderDensity);
+        void OnRenderStart();
+        void Composite(GLuint eyeFbo, GLuint eyeTexId);
+        void Destroy();
+
+        ovrSizei   m_size;
+        GLuint     m_fbo         = 0;
+        GLuint     m_colorTex    = 0;
+        GLuint     m_depthBuffer = 0;
+        GLuint     m_vertexArray = 0;                     // empty, composite draws fullscreen triangles
+        int        m_shadedPixels;                        // pixels rendered per frame (both eyes)
+
+        ovrRecti      m_srcRect[ovrEye_Count][CELL_COUNT];   // cell location in multi-res buffer
+        ovrRecti      m_dstRect[ovrEye_Count][CELL_COUNT];   // cell location in swap chain texture
+        OVR::Matrix4f m_cellRemap[CELL_COUNT];              // clip space scale/bias selecting cell area of the eye frustum
+    };
+
+    void BlitSpectatorMirror();   // copy undistorted spectator view to back buffer (before texture is committed)
+    void UpdateViews();           // refresh per-view viewports and matrices for the current frame
+    void UpdateGpuTimer();        // collect GPU frame time and advance fill rate benchmark
+
     ovrLayerEyeFov m_eyeLayer;
 
     // data and buffers used to render to HMD
@@ -90,6 +163,33 @@ private:
     OVR::Matrix4f     m_projectionMatrix[ovrEye_Count];
     OVR::Matrix4f     m_eyeOrientation[ovrEye_Count];
     OVR::Matrix4f     m_eyePose[ovrEye_Count];
+    OVR::Matrix4f     m_eyeMVP[ovrEye_Count];
+
+    ovrRecti          m_eyeViewports[ovrEye_Count];
+
+    // per-view data for instanced rendering (eyes first, then extra views)
+    ovrRecti          m_viewports[MAX_VIEWS];
+    OVR::Matrix4f     m_viewMVP[MAX_VIEWS];
+    OVR::Matrix4f     m_viewProjection[MAX_VIEWS];   // m_viewMVP = m_viewProjection * m_viewMatrix
+    OVR::Matrix4f     m_viewMatrix[MAX_VIEWS];
+    OVR::Vector3f     m_viewPosition[MAX_VIEWS];
+    int               m_viewCount;
+    int               m_maxViews;         // MAX_VIEWS clamped to GL_MAX_VIEWPORTS
+    bool              m_spectatorEnabled;
+    ovrSizei          m_spectatorSize;
+
+    // multi-resolution rendering
+    MultiResBuffer   *m_multiResBuffer;
+    MultiResPreset    m_multiResPreset;
+
+    // GPU timing and fill rate benchmark
+    GLuint            m_gpuTimerQuery;
+    bool              m_gpuTimerActive;    // query started this frame
+    bool              m_gpuTimerPending;   // query finished, waiting for result
+    bool              m_benchmarkActive;
+    MultiResPreset    m_benchmarkUserPreset;   // preset to restore when benchmark is done
+    int               m_benchmarkFrames;
+    double            m_benchmarkGpuTime;
 
     // frame timing data and tracking info
     double            m_frameTiming;
@@ -2,6 +2,7 @@
 #include "InputHandlers.hpp"
 #include "renderer/RenderContext.hpp"
 #include "renderer/ShaderManager.hpp"
+#include "renderer/TextureManager.hpp"
 #include "OculusVRInstanced.hpp"
 
 // application globals
@@ -12,6 +13,14 @@ OculusVR      g_oculusVR;
 void Render();
 void RenderInstanced(GLuint &instanceVBO);
 
+// std140 layout of ViewMVPs uniform block in BasicVariant.vsh
+struct ViewMVPBlock
+{
+    GLint   viewCount;
+    GLint   padding[3];
+    GLfloat mvps[OculusVR::MAX_VIEWS * 16];
+};
+
 int main(int argc, char **argv)
 {
     // initialize everything
@@ -29,7 +38,7 @@ int main(int argc, char **argv)
     ovrSizei hmdResolution = g_oculusVR.GetResolution();
     ovrSizei windowSize = { hmdResolution.w / 2, hmdResolution.h / 2 };
 
-    g_renderContext.Init("Oculus Rift OpenGL instanced rendering (press R to toggle)", 100, 100, windowSize.w, windowSize.h);
+    g_renderContext.Init("Oculus Rift OpenGL instanced rendering (press R to toggle, M for spectator view)", 100, 100, windowSize.w, windowSize.h);
     SDL_ShowCursor(SDL_DISABLE);
 
     if (glewInit() != GLEW_OK)
@@ -52,7 +61,7 @@ int main(int argc, char **argv)
     g_application.OnStart();
     g_oculusVR.ShowPerfStats(ovrPerfHud_AppRenderTiming);
 
-    // for instanced rendering, store both eyes' MVPs in UBO
+    // for instanced rendering, store MVPs of all views in UBO
     GLuint mvpUBO;
     glGenBuffers(1, &mvpUBO);
 
@@ -60,19 +69,31 @@ int main(int argc, char **argv)
     {
         // handle key presses
         processEvents();
+
+        TextureManager::GetInstance()->Update();
+
         glClearColor(0.2f, 0.2f, 0.6f, 0.0f);
 
+        g_oculusVR.SetSpectatorView(g_application.SpectatorView());
         g_oculusVR.OnRenderStart();
 
+        g_application.OnRenderStart();
+
         if(g_application.InstancedRender())
             RenderInstanced(mvpUBO);
         else
             Render();
 
+        g_application.OnRenderFinish();
+
         g_oculusVR.OnRenderFinish();
 
         g_oculusVR.SubmitFrame();
-        g_oculusVR.BlitMirror();
+
+        // spectator view is already in the back buffer at this point
+        if (!g_oculusVR.SpectatorViewEnabled())
+            g_oculusVR.BlitMirror();
+
         SDL_GL_SwapWindow(g_renderContext.window);
     }
 
@@ -88,56 +109,50 @@ int main(int argc, char **argv)
 }
 
 
-// standard render: draw scene twice per eye
+// standard render: draw scene once per view (both eyes + spectator, if enabled)
 void Render()
 {
-    for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
+    for (int viewIndex = 0; viewIndex < g_oculusVR.GetViewCount(); viewIndex++)
     {
-        OVR::Matrix4f MVPMatrix = g_oculusVR.OnEyeRender(eyeIndex);
-
-        // update MVP in quad shader
-        const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
-        glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVPMatrix.Transposed().M[0][0]);
+        // view matrices go to the shared ViewConstants block, read by all programs
+        g_oculusVR.OnEyeRender(viewIndex);
 
         g_application.OnRender();
     }
 }
 
-// instanced rendering: draw the scene once using OpenGL instancing
+// instanced rendering: draw the scene once for all views using OpenGL instancing
 void RenderInstanced(GLuint &ubo)
 {
-    // MVP matrices for left and right eye
-    GLfloat mvps[32];
+    // view count and MVP matrices for all views
+    ViewMVPBlock mvpBlock;
+    GLfloat viewports[OculusVR::MAX_VIEWS * 4];
+    int viewCount = g_oculusVR.GetViewCount();
 
-    const ShaderProgram &shader = ShaderManager::GetInstance()->GetShaderProgram(ShaderManager::BasicShaderInstanced);
+    // fetch MVP matrices and viewports (for geometry shader) of all views
+    mvpBlock.viewCount = viewCount;
 
-    // fetch location of MVP UBO in shader
-    GLuint mvpBinding = 0;
-    GLint blockIdx = glGetUniformBlockIndex(shader.id, "EyeMVPs");
-    glUniformBlockBinding(shader.id, blockIdx, mvpBinding);
-
-    // fetch MVP matrices for both eyes
-    for (int i = 0; i < 2; i++)
+    for (int i = 0; i < viewCount; i++)
     {
         OVR::Matrix4f MVPMatrix = g_oculusVR.OnEyeRender(i);
-        memcpy(&mvps[i * 16], &MVPMatrix.Transposed().M[0][0], sizeof(GLfloat) * 16);
+        memcpy(&mvpBlock.mvps[i * 16], &MVPMatrix.Transposed().M[0][0], sizeof(GLfloat) * 16);
+
+        ovrRecti viewPort = g_oculusVR.GetEyeViewport(i);
+        viewports[i * 4 + 0] = (GLfloat)viewPort.Pos.x;
+        viewports[i * 4 + 1] = (GLfloat)viewPort.Pos.y;
+        viewports[i * 4 + 2] = (GLfloat)viewPort.Size.w;
+        viewports[i * 4 + 3] = (GLfloat)viewPort.Size.h;
     }
 
-    // update MVP UBO with new eye matrices
+    // update MVP UBO with new view matrices (only upload the matrices in use)
+    GLsizeiptr uboSize = offsetof(ViewMVPBlock, mvps) + viewCount * sizeof(GLfloat) * 16;
     glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(GLfloat) * 16, mvps, GL_STREAM_DRAW);
-    glBindBufferRange(GL_UNIFORM_BUFFER, mvpBinding, ubo, 0, 2 * sizeof(GLfloat) * 16);
-
-    ovrRecti viewPortL = g_oculusVR.GetEyeViewport(0);
-    ovrRecti viewPortR = g_oculusVR.GetEyeViewport(1);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ViewMVPBlock), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, uboSize, &mvpBlock);
+    glBindBufferRange(GL_UNIFORM_BUFFER, ViewMVPsBinding, ubo, 0, sizeof(ViewMVPBlock));
 
-    // create viewport array for geometry shader
-    GLfloat viewports[] = { (GLfloat)viewPortL.Pos.x, (GLfloat)viewPortL.Pos.y, 
-                            (GLfloat)viewPortL.Size.w, (GLfloat)viewPortL.Size.h,
-                            (GLfloat)viewPortR.Pos.x, (GLfloat)viewPortR.Pos.y, 
-                            (GLfloat)viewPortR.Size.w, (GLfloat)viewPortR.Size.h };
-    glViewportArrayv(0, 2, viewports);
+    glViewportArrayv(0, viewCount, viewports);
 
-    // perform instanced render - half the drawcalls compared to "standard" rendering!
-    g_application.OnRenderInstanced();
+    // perform instanced render - one drawcall for all views compared to one per view in "standard" rendering!
+    g_application.OnRenderInstanced(viewCount);
 }
\ No newline at end of file
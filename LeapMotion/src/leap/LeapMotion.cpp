@@ -240,7 +240,7 @@ void LeapMotion::RenderSkeletonHands()
         return;
 
     const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::OVRFrustumShader);
-    GLuint vertexPositionAttr = glGetAttribLocation(shader.id, "inVertex");
+    GLuint vertexPositionAttr = shader.GetAttribLocation(SHADER_VAR("inVertex"));
 
     const float boneColor[4] = { 0.f, 1.f, 0.f, 1.0f };
 
@@ -318,12 +318,15 @@ void LeapMotion::RenderCameraImage()
     g_cameraDirector.GetActiveCamera()->SetMode(Camera::CAM_ORTHO);
     Math::Matrix4f MVP = g_cameraDirector.GetActiveCamera()->ProjectionMatrix();
 
+    // camera image is drawn in screen space - switch to overlay view and restore eye view afterwards
+    int eyeView = ShaderManager::GetInstance()->GetBoundView();
+    ShaderManager::GetInstance()->UpdateOverlayConstants(&MVP[0]);
+
     const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
-    glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVP[0]);
 
-    GLuint vertexPosition_modelspaceID = glGetAttribLocation(shader.id, "inVertex");
-    GLuint vertexColorAttr = glGetAttribLocation(shader.id, "inVertexColor");
-    GLuint texCoordAttr = glGetAttribLocation(shader.id, "inTexCoord");
+    GLuint vertexPosition_modelspaceID = shader.GetAttribLocation(SHADER_VAR("inVertex"));
+    GLuint vertexColorAttr = shader.GetAttribLocation(SHADER_VAR("inVertexColor"));
+    GLuint texCoordAttr = shader.GetAttribLocation(SHADER_VAR("inTexCoord"));
 
     TextureManager::GetInstance()->BindTexture(m_leapData->m_camImgTexture);
 
@@ -348,5 +351,8 @@ void LeapMotion::RenderCameraImage()
     glDisableVertexAttribArray(vertexColorAttr);
     glDisableVertexAttribArray(texCoordAttr);
 
+    if (eyeView >= 0)
+        ShaderManager::GetInstance()->BindViewConstants(eyeView);
+
     g_cameraDirector.GetActiveCamera()->SetMode(Camera::CAM_FPS);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "InputHandlers.hpp"
 #include "renderer/RenderContext.hpp"
 #include "renderer/ShaderManager.hpp"
+#include "renderer/TextureManager.hpp"
 #include "renderer/OculusVR.hpp"
 #include "leap/LeapMotion.hpp"
 
@@ -57,6 +58,8 @@ int main(int argc, char **argv)
         // handle key presses
         processEvents();
 
+        TextureManager::GetInstance()->Update();
+
         g_leapMotion.OnUpdate();
 
         glClearColor(0.2f, 0.2f, 0.6f, 0.0f);
@@ -64,20 +67,17 @@ int main(int argc, char **argv)
 
         g_oculusVR.OnRenderStart();
 
+        // with Leap Motion's Up(+Y), Forward(-Z) and Right(+X) orientations, 
+        // rotate the model matrix by X and Y for proper VR positioning of rendered hand skeletons
+        // (view matrices come from the shared ViewConstants block, so this is the same for both eyes)
+        const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::OVRFrustumShader);
+        OVR::Matrix4f modelMatrixLM = OVR::Matrix4f(OVR::Quatf(OVR::Vector3f(1.0f, 0.0f, 0.0f), -PIdiv2))
+                                    * OVR::Matrix4f(OVR::Quatf(OVR::Vector3f(0.0f, 1.0f, 0.0f), PI));
+        glUniformMatrix4fv(shader.uniforms[ModelMatrix], 1, GL_FALSE, &modelMatrixLM.Transposed().M[0][0]);
+
         for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
         {
-            OVR::Matrix4f MVPMatrix = g_oculusVR.OnEyeRender(eyeIndex);
-
-            // update MVP in quad shader
-            const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
-            glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVPMatrix.Transposed().M[0][0]);
-            const ShaderProgram &shader2 = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::OVRFrustumShader);
-            
-            // with Leap Motion's Up(+Y), Forward(-Z) and Right(+X) orientations, 
-            // rotate the final matrix by X and Y for proper VR positioning of rendered hand skeletons
-            OVR::Matrix4f MVPMatrixLM = MVPMatrix * OVR::Matrix4f(OVR::Quatf(OVR::Vector3f(1.0f, 0.0f, 0.0f), -PIdiv2))
-                                                  * OVR::Matrix4f(OVR::Quatf(OVR::Vector3f(0.0f, 1.0f, 0.0f), PI));
-            glUniformMatrix4fv(shader2.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVPMatrixLM.Transposed().M[0][0]);
+            g_oculusVR.OnEyeRender(eyeIndex);
 
             g_application.OnRender();
             g_leapMotion.OnRender();
@@ -27,8 +27,8 @@ void Application::OnStart()
 
     g_cameraDirector.AddCamera(0.0f, 0.0f, 0.0f);
 
-    // load block texture
-    m_texture = TextureManager::GetInstance()->LoadTexture("../common_res/block_blue.png");
+    // load block texture in the background - a placeholder is shown until it's uploaded
+    m_texture = TextureManager::GetInstance()->LoadTextureAsync("../common_res/block_blue.png");
 
     const GLfloat quadBufferData[] = {
         -1.0f, 1.0f, -1.5f,
@@ -72,9 +72,9 @@ void Application::OnRender()
 {
     const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
 
-    GLuint vertexPosition_modelspaceID = glGetAttribLocation(shader.id, "inVertex");
-    GLuint vertexColorAttr = glGetAttribLocation(shader.id, "inVertexColor");
-    GLuint texCoordAttr = glGetAttribLocation(shader.id, "inTexCoord");
+    GLuint vertexPosition_modelspaceID = shader.GetAttribLocation(SHADER_VAR("inVertex"));
+    GLuint vertexColorAttr = shader.GetAttribLocation(SHADER_VAR("inVertexColor"));
+    GLuint texCoordAttr = shader.GetAttribLocation(SHADER_VAR("inTexCoord"));
 
     TextureManager::GetInstance()->BindTexture(m_texture);
 
@@ -108,6 +108,9 @@ void Application::OnKeyPress(KeyCode key)
     case KEY_ESC:
         Terminate();
         break;
+    case KEY_F:
+        m_farField = !m_farField;
+        break;
     default:
         break;
     } 
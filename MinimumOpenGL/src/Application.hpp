@@ -11,7 +11,7 @@
 class Application
 {
 public:
-    Application::Application() : m_running(true)
+    Application::Application() : m_running(true), m_farField(false)
     {
     }
 
@@ -22,17 +22,19 @@ public:
 
     inline bool Running() const  { return m_running; }
     inline void Terminate()      { m_running = false; }
+    inline bool FarField() const { return m_farField; }
 
     void OnKeyPress(KeyCode key);
 private:
     bool m_running;
+    bool m_farField;
 
     // rendered quad data
     GLuint m_vertexBuffer;
     GLuint m_colorBuffer;
     GLuint m_texcoordBuffer;
     GLuint m_vertexArray;
-    Texture *m_texture;
+    TextureHandle m_texture;
 
 };
 
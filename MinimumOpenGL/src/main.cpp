@@ -2,6 +2,7 @@
 #include "InputHandlers.hpp"
 #include "renderer/RenderContext.hpp"
 #include "renderer/ShaderManager.hpp"
+#include "renderer/TextureManager.hpp"
 #include "renderer/OculusVR.hpp"
 
 // application globals
@@ -46,7 +47,8 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    ShaderManager::GetInstance()->LoadShaders();
+    // shaders finish compiling in the background, untextured fallback is used until then
+    ShaderManager::GetInstance()->LoadShadersAsync();
     g_application.OnStart();
 
     while (g_application.Running())
@@ -54,18 +56,27 @@ int main(int argc, char **argv)
         // handle key presses
         processEvents();
 
+        ShaderManager::GetInstance()->UpdateAsyncLoad();
+        TextureManager::GetInstance()->Update();
+
         glClearColor(0.2f, 0.2f, 0.6f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         g_oculusVR.OnRenderStart();
+        g_oculusVR.SetFarField(g_application.FarField());
 
-        for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
+        // split-depth mode: render distant geometry once, it's shared by both eyes
+        if (g_oculusVR.FarFieldEnabled())
         {
-            OVR::Matrix4f MVPMatrix = g_oculusVR.OnEyeRender(eyeIndex);
+            g_oculusVR.OnFarFieldRender();
+            g_application.OnRender();
+            g_oculusVR.OnFarFieldRenderFinish();
+        }
 
-            // update MVP in quad shader
-            const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
-            glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVPMatrix.Transposed().M[0][0]);
+        for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
+        {
+            // view matrices go to the shared ViewConstants block, read by all programs
+            g_oculusVR.OnEyeRender(eyeIndex);
 
             g_application.OnRender();
             g_oculusVR.OnEyeRenderFinish(eyeIndex);
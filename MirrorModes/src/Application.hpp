@@ -48,7 +48,7 @@ private:
     GLuint m_colorBuffer;
     GLuint m_texcoordBuffer;
     GLuint m_vertexArray;
-    Texture *m_texture;
+    TextureHandle m_texture;
 
 };
 
@@ -2,6 +2,7 @@
 #include "InputHandlers.hpp"
 #include "renderer/RenderContext.hpp"
 #include "renderer/ShaderManager.hpp"
+#include "renderer/TextureManager.hpp"
 #include "renderer/OculusVR.hpp"
 #include "renderer/CameraDirector.hpp"
 
@@ -64,6 +65,8 @@ int main(int argc, char **argv)
         // handle key presses
         processEvents();
 
+        TextureManager::GetInstance()->Update();
+
         glClearColor(0.2f, 0.2f, 0.6f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -71,11 +74,8 @@ int main(int argc, char **argv)
 
         for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
         {
-            OVR::Matrix4f MVPMatrix = g_oculusVR.OnEyeRender(eyeIndex);
-
-            // update MVP in quad shader
-            const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
-            glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVPMatrix.Transposed().M[0][0]);
+            // view matrices go to the shared ViewConstants block, read by all programs
+            g_oculusVR.OnEyeRender(eyeIndex);
 
             g_application.OnRender();
             g_oculusVR.OnEyeRenderFinish(eyeIndex);
@@ -123,9 +123,7 @@ int main(int argc, char **argv)
 
             for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++)
             {
-                const OVR::Matrix4f MVPMatrix = g_oculusVR.GetEyeMVPMatrix(eyeIndex);
-                const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
-                glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVPMatrix.Transposed().M[0][0]);
+                ShaderManager::GetInstance()->BindViewConstants(eyeIndex);   // reuse view matrices uploaded for HMD rendering
 
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
                 glClearColor(0.2f, 0.2f, 0.6f, 0.0f);
@@ -141,9 +139,7 @@ int main(int argc, char **argv)
             ClearWindow(0.f, 0.f, 0.f);
             g_oculusVR.OnNonDistortMirrorStart();
 
-            const OVR::Matrix4f MVPMatrix = g_oculusVR.GetEyeMVPMatrix(ovrEye_Left);
-            const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
-            glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVPMatrix.Transposed().M[0][0]);
+            ShaderManager::GetInstance()->BindViewConstants(ovrEye_Left);   // reuse view matrices uploaded for HMD rendering
 
             glClearColor(0.2f, 0.2f, 0.6f, 0.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -162,9 +158,7 @@ int main(int argc, char **argv)
             ClearWindow(0.f, 0.f, 0.f);
             g_oculusVR.OnNonDistortMirrorStart();
 
-            const OVR::Matrix4f MVPMatrix = g_oculusVR.GetEyeMVPMatrix(ovrEye_Right);
-            const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
-            glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVPMatrix.Transposed().M[0][0]);
+            ShaderManager::GetInstance()->BindViewConstants(ovrEye_Right);   // reuse view matrices uploaded for HMD rendering
 
             glClearColor(0.2f, 0.2f, 0.6f, 0.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -53,10 +53,12 @@ void Application::OnStart()
 
 void Application::OnRender()
 {
-    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShaderNoTex);
+    // MSAA variant uses centroid sampled varyings
+    unsigned int features = ShaderManager::Feature_VertexColor | (g_oculusVR.MSAAEnabled() ? ShaderManager::Feature_MSAA : 0);
+    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderVariant(features);
 
-    GLuint vertexPosition_modelspaceID = glGetAttribLocation(shader.id, "inVertex");
-    GLuint vertexColorAttr = glGetAttribLocation(shader.id, "inVertexColor");
+    GLuint vertexPosition_modelspaceID = shader.GetAttribLocation(SHADER_VAR("inVertex"));
+    GLuint vertexColorAttr = shader.GetAttribLocation(SHADER_VAR("inVertexColor"));
 
     // setup quad data
     glBindVertexArray(m_vertexArray);
@@ -0,0 +1,405 @@
+#include "stb_image/stb_image.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Offline texture compressor: converts images (PNG, JPG, TGA...) to block compressed KTX files with full mip chains.
+ * Usage: TextureCompressor [-bc1|-bc3|-bc4|-bc5] <image> [<image> ...]
+ * Output is written next to each input with .ktx extension. Without format switch BC1 is used for opaque images,
+ * BC3 for images with alpha, BC4/BC5 for one and two channel images.
+ */
+
+// OpenGL enums written to KTX header (no GL headers needed for an offline tool)
+#define GL_RED                            0x1903
+#define GL_RGB                            0x1907
+#define GL_RGBA                           0x1908
+#define GL_RG                             0x8227
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT   0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT  0x83F3
+#define GL_COMPRESSED_RED_RGTC1           0x8DBB
+#define GL_COMPRESSED_RG_RGTC2            0x8DBD
+
+enum BlockFormat
+{
+    Format_Auto,
+    Format_BC1,
+    Format_BC3,
+    Format_BC4,
+    Format_BC5
+};
+
+static const struct
+{
+    const char  *name;
+    unsigned int internalFormat;
+    unsigned int baseInternalFormat;
+    int          blockBytes;
+} blockFormats[] = {
+    { "auto", 0,                               0,       0  },
+    { "BC1",  GL_COMPRESSED_RGB_S3TC_DXT1_EXT,  GL_RGB,  8  },
+    { "BC3",  GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_RGBA, 16 },
+    { "BC4",  GL_COMPRESSED_RED_RGTC1,          GL_RED,  8  },
+    { "BC5",  GL_COMPRESSED_RG_RGTC2,           GL_RG,   16 }
+};
+
+static const unsigned char ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// level of the mip chain, always stored as RGBA
+struct Image
+{
+    int width;
+    int height;
+    std::vector<unsigned char> rgba;
+};
+
+// 2x2 box filter, last row/column is repeated for odd sizes
+static Image Downsample(const Image &src)
+{
+    Image dst;
+    dst.width  = src.width  > 1 ? src.width  / 2 : 1;
+    dst.height = src.height > 1 ? src.height / 2 : 1;
+    dst.rgba.resize(dst.width * dst.height * 4);
+
+    for (int y = 0; y < dst.height; y++)
+    {
+        int y0 = y * 2 < src.height ? y * 2 : src.height - 1;
+        int y1 = y * 2 + 1 < src.height ? y * 2 + 1 : src.height - 1;
+
+        for (int x = 0; x < dst.width; x++)
+        {
+            int x0 = x * 2 < src.width ? x * 2 : src.width - 1;
+            int x1 = x * 2 + 1 < src.width ? x * 2 + 1 : src.width - 1;
+
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = src.rgba[(y0 * src.width + x0) * 4 + c] + src.rgba[(y0 * src.width + x1) * 4 + c] +
+                          src.rgba[(y1 * src.width + x0) * 4 + c] + src.rgba[(y1 * src.width + x1) * 4 + c];
+
+                dst.rgba[(y * dst.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+
+    return dst;
+}
+
+// 4x4 RGBA texels of the block at (bx, by), edge texels are repeated for partial blocks
+static void FetchBlock(const Image &image, int bx, int by, unsigned char block[16][4])
+{
+    for (int y = 0; y < 4; y++)
+    {
+        int sy = by * 4 + y < image.height ? by * 4 + y : image.height - 1;
+
+        for (int x = 0; x < 4; x++)
+        {
+            int sx = bx * 4 + x < image.width ? bx * 4 + x : image.width - 1;
+            memcpy(block[y * 4 + x], &image.rgba[(sy * image.width + sx) * 4], 4);
+        }
+    }
+}
+
+static unsigned short PackRGB565(const int color[3])
+{
+    return (unsigned short)(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+}
+
+static void UnpackRGB565(unsigned short packed, int color[3])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 color block: endpoints from the bounding box diagonal along the dominant color axis, indices by nearest palette entry
+static void EncodeColorBlock(unsigned char block[16][4], unsigned char *out)
+{
+    int minColor[3] = { 255, 255, 255 };
+    int maxColor[3] = { 0, 0, 0 };
+    int mean[3]     = { 0, 0, 0 };
+
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            minColor[c] = block[i][c] < minColor[c] ? block[i][c] : minColor[c];
+            maxColor[c] = block[i][c] > maxColor[c] ? block[i][c] : maxColor[c];
+            mean[c]    += block[i][c];
+        }
+    }
+
+    // channels that fall while the widest channel rises get their endpoints swapped
+    int axis = 0;
+
+    for (int c = 1; c < 3; c++)
+    {
+        if (maxColor[c] - minColor[c] > maxColor[axis] - minColor[axis])
+            axis = c;
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        int covariance = 0;
+
+        for (int i = 0; i < 16; i++)
+            covariance += (block[i][c] * 16 - mean[c]) * (block[i][axis] * 16 - mean[axis]);
+
+        if (covariance < 0)
+        {
+            int tmp = minColor[c];
+            minColor[c] = maxColor[c];
+            maxColor[c] = tmp;
+        }
+    }
+
+    // inset endpoints slightly - reduces error for the interpolated colors
+    for (int c = 0; c < 3; c++)
+    {
+        int inset = (maxColor[c] - minColor[c]) / 16;
+        maxColor[c] -= inset;
+        minColor[c] += inset;
+    }
+
+    unsigned short color0 = PackRGB565(maxColor);
+    unsigned short color1 = PackRGB565(minColor);
+
+    // four color mode requires color0 > color1
+    if (color0 < color1)
+    {
+        unsigned short tmp = color0;
+        color0 = color1;
+        color1 = tmp;
+    }
+
+    int palette[4][3];
+    UnpackRGB565(color0, palette[0]);
+    UnpackRGB565(color1, palette[1]);
+
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    unsigned int indices = 0;
+
+    for (int i = 0; i < 16 && color0 != color1; i++)
+    {
+        int bestIndex = 0, bestError = 0x7FFFFFFF;
+
+        for (int p = 0; p < 4; p++)
+        {
+            int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+            int error = dr * dr + dg * dg + db * db;
+
+            if (error < bestError)
+            {
+                bestError = error;
+                bestIndex = p;
+            }
+        }
+
+        indices |= bestIndex << (i * 2);
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    memcpy(out + 4, &indices, 4);
+}
+
+// BC4 single channel block (also BC3 alpha and BC5 channels): 8 interpolated values between min and max
+static void EncodeChannelBlock(unsigned char block[16][4], int channel, unsigned char *out)
+{
+    int minValue = 255, maxValue = 0;
+
+    for (int i = 0; i < 16; i++)
+    {
+        minValue = block[i][channel] < minValue ? block[i][channel] : minValue;
+        maxValue = block[i][channel] > maxValue ? block[i][channel] : maxValue;
+    }
+
+    int palette[8] = { maxValue, minValue };
+
+    for (int p = 1; p < 7; p++)
+        palette[p + 1] = ((7 - p) * maxValue + p * minValue) / 7;
+
+    unsigned long long indices = 0;
+
+    for (int i = 0; i < 16 && maxValue != minValue; i++)
+    {
+        int bestIndex = 0, bestError = 256;
+
+        for (int p = 0; p < 8; p++)
+        {
+            int error = block[i][channel] > palette[p] ? block[i][channel] - palette[p] : palette[p] - block[i][channel];
+
+            if (error < bestError)
+            {
+                bestError = error;
+                bestIndex = p;
+            }
+        }
+
+        indices |= (unsigned long long)bestIndex << (i * 3);
+    }
+
+    out[0] = (unsigned char)maxValue;
+    out[1] = (unsigned char)minValue;
+
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+static std::vector<unsigned char> CompressLevel(const Image &image, BlockFormat format)
+{
+    int blocksX = (image.width + 3) / 4;
+    int blocksY = (image.height + 3) / 4;
+    int blockBytes = blockFormats[format].blockBytes;
+
+    std::vector<unsigned char> data(blocksX * blocksY * blockBytes);
+    unsigned char block[16][4];
+
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            unsigned char *out = &data[(by * blocksX + bx) * blockBytes];
+            FetchBlock(image, bx, by, block);
+
+            switch (format)
+            {
+            case Format_BC1: EncodeColorBlock(block, out); break;
+            case Format_BC3: EncodeChannelBlock(block, 3, out); EncodeColorBlock(block, out + 8);  break;
+            case Format_BC4: EncodeChannelBlock(block, 0, out); break;
+            case Format_BC5: EncodeChannelBlock(block, 0, out); EncodeChannelBlock(block, 1, out + 8); break;
+            default: break;
+            }
+        }
+    }
+
+    return data;
+}
+
+static bool CompressImage(const char *inputFile, BlockFormat format)
+{
+    Image image;
+    int components;
+    unsigned char *pixels = stbi_load(inputFile, &image.width, &image.height, &components, 4);
+
+    if (!pixels)
+    {
+        printf("%s: %s\n", inputFile, stbi_failure_reason());
+        return false;
+    }
+
+    image.rgba.assign(pixels, pixels + image.width * image.height * 4);
+    stbi_image_free(pixels);
+
+    if (format == Format_Auto)
+    {
+        bool hasAlpha = false;
+
+        for (size_t i = 3; i < image.rgba.size() && components == 4; i += 4)
+            hasAlpha |= image.rgba[i] != 255;
+
+        format = components == 1 ? Format_BC4 : components == 2 ? Format_BC5 : hasAlpha ? Format_BC3 : Format_BC1;
+    }
+
+    // two channel images are expanded by stb_image to grey + alpha - BC5 takes them from red and green
+    if (components == 2)
+    {
+        for (size_t i = 0; i < image.rgba.size(); i += 4)
+            image.rgba[i + 1] = image.rgba[i + 3];
+    }
+
+    int width  = image.width;
+    int height = image.height;
+
+    std::vector<std::vector<unsigned char> > levels;
+    levels.push_back(CompressLevel(image, format));
+
+    while (image.width > 1 || image.height > 1)
+    {
+        image = Downsample(image);
+        levels.push_back(CompressLevel(image, format));
+    }
+
+    std::string outputFile = inputFile;
+    size_t extension = outputFile.find_last_of('.');
+    outputFile = outputFile.substr(0, extension) + ".ktx";
+
+    FILE *file = fopen(outputFile.c_str(), "wb");
+
+    if (!file)
+    {
+        printf("%s: cannot open file for writing\n", outputFile.c_str());
+        return false;
+    }
+
+    // KTX 1.1 header: glType, glTypeSize, glFormat, glInternalFormat, glBaseInternalFormat, width, height, depth, array elements, faces, levels, key/value bytes
+    unsigned int header[13] = { 0x04030201, 0, 1, 0, blockFormats[format].internalFormat, blockFormats[format].baseInternalFormat,
+                                (unsigned int)width, (unsigned int)height, 0, 0, 1, (unsigned int)levels.size(), 0 };
+
+    fwrite(ktxIdentifier, sizeof(ktxIdentifier), 1, file);
+    fwrite(header, sizeof(header), 1, file);
+
+    size_t compressedSize = 0;
+
+    // block sizes are multiples of 4, so levels need no padding
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        unsigned int levelSize = (unsigned int)levels[i].size();
+        fwrite(&levelSize, sizeof(levelSize), 1, file);
+        fwrite(&levels[i][0], levelSize, 1, file);
+        compressedSize += levelSize;
+    }
+
+    fclose(file);
+
+    // uncompressed size assumes RGBA8 with full mip chain (~4/3 of base level)
+    size_t uncompressedSize = (size_t)width * height * 4 * 4 / 3;
+    printf("%s -> %s: %dx%d %s, %d levels, %u KB (%.1fx smaller than RGBA8)\n", inputFile, outputFile.c_str(), width, height, blockFormats[format].name,
+           (int)levels.size(), (unsigned int)(compressedSize / 1024), (double)uncompressedSize / compressedSize);
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BlockFormat format = Format_Auto;
+    int failed = 0, converted = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] == '-')
+        {
+            format = Format_Auto;
+
+            for (int f = Format_BC1; f <= Format_BC5; f++)
+            {
+                if (!_stricmp(argv[i] + 1, blockFormats[f].name))
+                    format = (BlockFormat)f;
+            }
+
+            continue;
+        }
+
+        if (CompressImage(argv[i], format))
+            converted++;
+        else
+            failed++;
+    }
+
+    if (converted + failed == 0)
+    {
+        printf("Usage: TextureCompressor [-bc1|-bc3|-bc4|-bc5] <image> [<image> ...]\n");
+        return 1;
+    }
+
+    return failed > 0 ? 1 : 0;
+}
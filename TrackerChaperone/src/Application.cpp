@@ -72,9 +72,9 @@ void Application::OnRender()
 {
     const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::BasicShader);
 
-    GLuint vertexPosition_modelspaceID = glGetAttribLocation(shader.id, "inVertex");
-    GLuint vertexColorAttr = glGetAttribLocation(shader.id, "inVertexColor");
-    GLuint texCoordAttr = glGetAttribLocation(shader.id, "inTexCoord");
+    GLuint vertexPosition_modelspaceID = shader.GetAttribLocation(SHADER_VAR("inVertex"));
+    GLuint vertexColorAttr = shader.GetAttribLocation(SHADER_VAR("inVertexColor"));
+    GLuint texCoordAttr = shader.GetAttribLocation(SHADER_VAR("inTexCoord"));
 
     TextureManager::GetInstance()->BindTexture(m_texture);
 
@@ -22,6 +22,7 @@
       - decode from memory or through FILE (define STBI_NO_STDIO to remove code)
       - decode from arbitrary I/O callbacks
       - overridable dequantizing-IDCT, YCbCr-to-RGB conversion (define STBI_SIMD)
+      - SSE2 JPEG IDCT, upsampling, YCbCr-to-RGB and PNG unfiltering, picked at runtime (define STBI_NO_SIMD to remove)
 
    Latest revisions:
       1.33 (2011-07-14) minor fixes suggested by Dave Moore
@@ -97,6 +98,7 @@ typedef   signed short  int16;
 typedef unsigned int   uint32;
 typedef   signed int    int32;
 typedef unsigned int   uint;
+typedef unsigned long long uint64;
 
 // should produce compiler error if size is wrong
 typedef unsigned char validate_uint32[sizeof(uint32)==4 ? 1 : -1];
@@ -107,6 +109,21 @@ typedef unsigned char validate_uint32[sizeof(uint32)==4 ? 1 : -1];
 
 #define STBI_NOTUSED(v)  (void)sizeof(v)
 
+// unaligned little endian loads with memcpy
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define STBI_LITTLE_ENDIAN
+#endif
+
+// SSE2 JPEG and PNG kernels, used if the CPU supports them (define STBI_NO_SIMD to leave them out).
+// Not used with STBI_SIMD - installed kernels take the place of the built-in ones.
+#if !defined(STBI_NO_SIMD) && !defined(STBI_SIMD) && (defined(__SSE2__) || (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))))
+#define STBI_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>   // __cpuid
+#endif
+#endif
+
 #ifdef _MSC_VER
 #define STBI_HAS_LROTL
 #endif
@@ -139,6 +156,19 @@ typedef struct
    uint8 *img_buffer_original;
 } stbi;
 
+// row streaming state - decoders fill 'strip' a row at a time, it's passed
+// to the callback whenever it's full
+typedef struct
+{
+   stbi_row_callback callback;
+   void *user;
+   int x, y, comp;
+   uint8 *strip;
+   int strip_rows;   // capacity
+   int num_rows;     // rows waiting in strip
+   int first_row;    // image row of strip[0]
+} stbi_rows;
+
 
 static void refill_buffer(stbi *s);
 
@@ -206,9 +236,12 @@ static void stbi_rewind(stbi *s)
 static int      stbi_jpeg_test(stbi *s);
 static stbi_uc *stbi_jpeg_load(stbi *s, int *x, int *y, int *comp, int req_comp);
 static int      stbi_jpeg_info(stbi *s, int *x, int *y, int *comp);
+static int      stbi_jpeg_load_into(stbi *s, stbi_uc *dest, int dest_size, int row_alignment, int req_comp, int *x, int *y, int *comp);
+static int      stbi_jpeg_load_rows(stbi *s, stbi_rows *r, int req_comp, int *x, int *y, int *comp);
 static int      stbi_png_test(stbi *s);
 static stbi_uc *stbi_png_load(stbi *s, int *x, int *y, int *comp, int req_comp);
 static int      stbi_png_info(stbi *s, int *x, int *y, int *comp);
+static int      stbi_png_load_rows(stbi *s, stbi_rows *r, int req_comp, int *x, int *y, int *comp);
 static int      stbi_bmp_test(stbi *s);
 static stbi_uc *stbi_bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp);
 static int      stbi_tga_test(stbi *s);
@@ -225,20 +258,57 @@ static stbi_uc *stbi_gif_load(stbi *s, int *x, int *y, int *comp, int req_comp);
 static int      stbi_gif_info(stbi *s, int *x, int *y, int *comp);
 
 
-// this is not threadsafe
-static const char *failure_reason;
+// decoding state is per thread: errors go to the context of the running
+// _ctx call, or to the failure reason of the thread's last plain call
+#ifdef _MSC_VER
+   #define STBI_THREAD_LOCAL  __declspec(thread)
+#else
+   #define STBI_THREAD_LOCAL  __thread
+#endif
+
+static STBI_THREAD_LOCAL stbi_context *active_context;
+static STBI_THREAD_LOCAL const char *failure_reason;
+
+// settings copied by stbi_context_init, changed by the global setters
+static stbi_context default_context = { NULL, 2.2f, 1.0f, 2.2f, 1.0f, 0, 0, 0 };
+
+static const stbi_context *settings(void)
+{
+   return active_context ? active_context : &default_context;
+}
 
 const char *stbi_failure_reason(void)
 {
    return failure_reason;
 }
 
+static void set_failure(const char *str)
+{
+   if (active_context)
+      active_context->failure_reason = str;
+   else
+      failure_reason = str;
+}
+
 static int e(const char *str)
 {
-   failure_reason = str;
+   set_failure(str);
    return 0;
 }
 
+void stbi_context_init(stbi_context *ctx)
+{
+   *ctx = default_context;
+}
+
+static stbi_context *enter_context(stbi_context *ctx)
+{
+   stbi_context *prev = active_context;
+   active_context = ctx;
+   ctx->failure_reason = NULL;
+   return prev;
+}
+
 // e - error
 // epf - error returning pointer to float
 // epuc - error returning pointer to unsigned char
@@ -287,41 +357,101 @@ static unsigned char *stbi_load_main(stbi *s, int *x, int *y, int *comp, int req
 }
 
 #ifndef STBI_NO_STDIO
-unsigned char *stbi_load(char const *filename, int *x, int *y, int *comp, int req_comp)
+unsigned char *stbi_load_ctx(stbi_context *ctx, char const *filename, int *x, int *y, int *comp, int req_comp)
 {
+   stbi_context *prev = enter_context(ctx);
    FILE *f = fopen(filename, "rb");
    unsigned char *result;
-   if (!f) return epuc("can't fopen", "Unable to open file");
-   result = stbi_load_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   if (f) {
+      result = stbi_load_from_file_ctx(ctx,f,x,y,comp,req_comp);
+      fclose(f);
+   } else
+      result = epuc("can't fopen", "Unable to open file");
+   active_context = prev;
    return result;
 }
 
-unsigned char *stbi_load_from_file(FILE *f, int *x, int *y, int *comp, int req_comp)
+unsigned char *stbi_load_from_file_ctx(stbi_context *ctx, FILE *f, int *x, int *y, int *comp, int req_comp)
 {
+   stbi_context *prev = enter_context(ctx);
+   unsigned char *result;
    stbi s;
    start_file(&s,f);
-   return stbi_load_main(&s,x,y,comp,req_comp);
+   result = stbi_load_main(&s,x,y,comp,req_comp);
+   active_context = prev;
+   return result;
 }
 #endif //!STBI_NO_STDIO
 
-unsigned char *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
+unsigned char *stbi_load_from_memory_ctx(stbi_context *ctx, stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
 {
+   stbi_context *prev = enter_context(ctx);
+   unsigned char *result;
    stbi s;
    start_mem(&s,buffer,len);
-   return stbi_load_main(&s,x,y,comp,req_comp);
+   result = stbi_load_main(&s,x,y,comp,req_comp);
+   active_context = prev;
+   return result;
 }
 
-unsigned char *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
+unsigned char *stbi_load_from_callbacks_ctx(stbi_context *ctx, stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
 {
+   stbi_context *prev = enter_context(ctx);
+   unsigned char *result;
    stbi s;
    start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
-   return stbi_load_main(&s,x,y,comp,req_comp);
+   result = stbi_load_main(&s,x,y,comp,req_comp);
+   active_context = prev;
+   return result;
+}
+
+// the plain entry points decode with a copy of the global settings and keep
+// the failure reason for stbi_failure_reason on this thread
+#ifndef STBI_NO_STDIO
+unsigned char *stbi_load(char const *filename, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_context ctx;
+   unsigned char *result;
+   stbi_context_init(&ctx);
+   result = stbi_load_ctx(&ctx,filename,x,y,comp,req_comp);
+   if (!result) failure_reason = ctx.failure_reason;
+   return result;
+}
+
+unsigned char *stbi_load_from_file(FILE *f, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_context ctx;
+   unsigned char *result;
+   stbi_context_init(&ctx);
+   result = stbi_load_from_file_ctx(&ctx,f,x,y,comp,req_comp);
+   if (!result) failure_reason = ctx.failure_reason;
+   return result;
+}
+#endif //!STBI_NO_STDIO
+
+unsigned char *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_context ctx;
+   unsigned char *result;
+   stbi_context_init(&ctx);
+   result = stbi_load_from_memory_ctx(&ctx,buffer,len,x,y,comp,req_comp);
+   if (!result) failure_reason = ctx.failure_reason;
+   return result;
+}
+
+unsigned char *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_context ctx;
+   unsigned char *result;
+   stbi_context_init(&ctx);
+   result = stbi_load_from_callbacks_ctx(&ctx,clbk,user,x,y,comp,req_comp);
+   if (!result) failure_reason = ctx.failure_reason;
+   return result;
 }
 
 #ifndef STBI_NO_HDR
 
-float *stbi_loadf_main(stbi *s, int *x, int *y, int *comp, int req_comp)
+static float *stbi_loadf_main(stbi *s, int *x, int *y, int *comp, int req_comp)
 {
    unsigned char *data;
    #ifndef STBI_NO_HDR
@@ -334,36 +464,94 @@ float *stbi_loadf_main(stbi *s, int *x, int *y, int *comp, int req_comp)
    return epf("unknown image type", "Image not of any known type, or corrupt");
 }
 
-float *stbi_loadf_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
+float *stbi_loadf_from_memory_ctx(stbi_context *ctx, stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
 {
+   stbi_context *prev = enter_context(ctx);
+   float *result;
    stbi s;
    start_mem(&s,buffer,len);
-   return stbi_loadf_main(&s,x,y,comp,req_comp);
+   result = stbi_loadf_main(&s,x,y,comp,req_comp);
+   active_context = prev;
+   return result;
 }
 
-float *stbi_loadf_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
+float *stbi_loadf_from_callbacks_ctx(stbi_context *ctx, stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
 {
+   stbi_context *prev = enter_context(ctx);
+   float *result;
    stbi s;
    start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
-   return stbi_loadf_main(&s,x,y,comp,req_comp);
+   result = stbi_loadf_main(&s,x,y,comp,req_comp);
+   active_context = prev;
+   return result;
 }
 
 #ifndef STBI_NO_STDIO
-float *stbi_loadf(char const *filename, int *x, int *y, int *comp, int req_comp)
+float *stbi_loadf_ctx(stbi_context *ctx, char const *filename, int *x, int *y, int *comp, int req_comp)
 {
+   stbi_context *prev = enter_context(ctx);
    FILE *f = fopen(filename, "rb");
    float *result;
-   if (!f) return epf("can't fopen", "Unable to open file");
-   result = stbi_loadf_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   if (f) {
+      result = stbi_loadf_from_file_ctx(ctx,f,x,y,comp,req_comp);
+      fclose(f);
+   } else
+      result = epf("can't fopen", "Unable to open file");
+   active_context = prev;
    return result;
 }
 
-float *stbi_loadf_from_file(FILE *f, int *x, int *y, int *comp, int req_comp)
+float *stbi_loadf_from_file_ctx(stbi_context *ctx, FILE *f, int *x, int *y, int *comp, int req_comp)
 {
+   stbi_context *prev = enter_context(ctx);
+   float *result;
    stbi s;
    start_file(&s,f);
-   return stbi_loadf_main(&s,x,y,comp,req_comp);
+   result = stbi_loadf_main(&s,x,y,comp,req_comp);
+   active_context = prev;
+   return result;
+}
+#endif // !STBI_NO_STDIO
+
+float *stbi_loadf_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_context ctx;
+   float *result;
+   stbi_context_init(&ctx);
+   result = stbi_loadf_from_memory_ctx(&ctx,buffer,len,x,y,comp,req_comp);
+   if (!result) failure_reason = ctx.failure_reason;
+   return result;
+}
+
+float *stbi_loadf_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_context ctx;
+   float *result;
+   stbi_context_init(&ctx);
+   result = stbi_loadf_from_callbacks_ctx(&ctx,clbk,user,x,y,comp,req_comp);
+   if (!result) failure_reason = ctx.failure_reason;
+   return result;
+}
+
+#ifndef STBI_NO_STDIO
+float *stbi_loadf(char const *filename, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_context ctx;
+   float *result;
+   stbi_context_init(&ctx);
+   result = stbi_loadf_ctx(&ctx,filename,x,y,comp,req_comp);
+   if (!result) failure_reason = ctx.failure_reason;
+   return result;
+}
+
+float *stbi_loadf_from_file(FILE *f, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_context ctx;
+   float *result;
+   stbi_context_init(&ctx);
+   result = stbi_loadf_from_file_ctx(&ctx,f,x,y,comp,req_comp);
+   if (!result) failure_reason = ctx.failure_reason;
+   return result;
 }
 #endif // !STBI_NO_STDIO
 
@@ -422,14 +610,11 @@ extern int      stbi_is_hdr_from_callbacks(stbi_io_callbacks const *clbk, void *
 }
 
 #ifndef STBI_NO_HDR
-static float h2l_gamma_i=1.0f/2.2f, h2l_scale_i=1.0f;
-static float l2h_gamma=2.2f, l2h_scale=1.0f;
-
-void   stbi_hdr_to_ldr_gamma(float gamma) { h2l_gamma_i = 1/gamma; }
-void   stbi_hdr_to_ldr_scale(float scale) { h2l_scale_i = 1/scale; }
+void   stbi_hdr_to_ldr_gamma(float gamma) { default_context.hdr_to_ldr_gamma = gamma; }
+void   stbi_hdr_to_ldr_scale(float scale) { default_context.hdr_to_ldr_scale = scale; }
 
-void   stbi_ldr_to_hdr_gamma(float gamma) { l2h_gamma = gamma; }
-void   stbi_ldr_to_hdr_scale(float scale) { l2h_scale = scale; }
+void   stbi_ldr_to_hdr_gamma(float gamma) { default_context.ldr_to_hdr_gamma = gamma; }
+void   stbi_ldr_to_hdr_scale(float scale) { default_context.ldr_to_hdr_scale = scale; }
 #endif
 
 
@@ -564,9 +749,41 @@ static uint8 compute_y(int r, int g, int b)
    return (uint8) (((r*77) + (g*150) +  (29*b)) >> 8);
 }
 
+// convert one scanline with img_n components to req_comp components
+static void convert_row(unsigned char *dest, unsigned char *src, int img_n, int req_comp, uint x)
+{
+   int i;
+
+   if (req_comp == img_n) {
+      memcpy(dest, src, x * img_n);
+      return;
+   }
+
+   #define COMBO(a,b)  ((a)*8+(b))
+   #define CASE(a,b)   case COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+   // convert source image with img_n components to one with req_comp components;
+   // avoid switch per pixel, so use switch per scanline and massive macros
+   switch (COMBO(img_n, req_comp)) {
+      CASE(1,2) dest[0]=src[0], dest[1]=255; break;
+      CASE(1,3) dest[0]=dest[1]=dest[2]=src[0]; break;
+      CASE(1,4) dest[0]=dest[1]=dest[2]=src[0], dest[3]=255; break;
+      CASE(2,1) dest[0]=src[0]; break;
+      CASE(2,3) dest[0]=dest[1]=dest[2]=src[0]; break;
+      CASE(2,4) dest[0]=dest[1]=dest[2]=src[0], dest[3]=src[1]; break;
+      CASE(3,4) dest[0]=src[0],dest[1]=src[1],dest[2]=src[2],dest[3]=255; break;
+      CASE(3,1) dest[0]=compute_y(src[0],src[1],src[2]); break;
+      CASE(3,2) dest[0]=compute_y(src[0],src[1],src[2]), dest[1] = 255; break;
+      CASE(4,1) dest[0]=compute_y(src[0],src[1],src[2]); break;
+      CASE(4,2) dest[0]=compute_y(src[0],src[1],src[2]), dest[1] = src[3]; break;
+      CASE(4,3) dest[0]=src[0],dest[1]=src[1],dest[2]=src[2]; break;
+      default: assert(0);
+   }
+   #undef CASE
+}
+
 static unsigned char *convert_format(unsigned char *data, int img_n, int req_comp, uint x, uint y)
 {
-   int i,j;
+   int j;
    unsigned char *good;
 
    if (req_comp == img_n) return data;
@@ -578,40 +795,265 @@ static unsigned char *convert_format(unsigned char *data, int img_n, int req_com
       return epuc("outofmem", "Out of memory");
    }
 
-   for (j=0; j < (int) y; ++j) {
-      unsigned char *src  = data + j * x * img_n   ;
-      unsigned char *dest = good + j * x * req_comp;
-
-      #define COMBO(a,b)  ((a)*8+(b))
-      #define CASE(a,b)   case COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
-      // convert source image with img_n components to one with req_comp components;
-      // avoid switch per pixel, so use switch per scanline and massive macros
-      switch (COMBO(img_n, req_comp)) {
-         CASE(1,2) dest[0]=src[0], dest[1]=255; break;
-         CASE(1,3) dest[0]=dest[1]=dest[2]=src[0]; break;
-         CASE(1,4) dest[0]=dest[1]=dest[2]=src[0], dest[3]=255; break;
-         CASE(2,1) dest[0]=src[0]; break;
-         CASE(2,3) dest[0]=dest[1]=dest[2]=src[0]; break;
-         CASE(2,4) dest[0]=dest[1]=dest[2]=src[0], dest[3]=src[1]; break;
-         CASE(3,4) dest[0]=src[0],dest[1]=src[1],dest[2]=src[2],dest[3]=255; break;
-         CASE(3,1) dest[0]=compute_y(src[0],src[1],src[2]); break;
-         CASE(3,2) dest[0]=compute_y(src[0],src[1],src[2]), dest[1] = 255; break;
-         CASE(4,1) dest[0]=compute_y(src[0],src[1],src[2]); break;
-         CASE(4,2) dest[0]=compute_y(src[0],src[1],src[2]), dest[1] = src[3]; break;
-         CASE(4,3) dest[0]=src[0],dest[1]=src[1],dest[2]=src[2]; break;
-         default: assert(0);
+   for (j=0; j < (int) y; ++j)
+      convert_row(good + j * x * req_comp, data + j * x * img_n, img_n, req_comp, x);
+
+   free(data);
+   return good;
+}
+
+// color = color * alpha / 255, rounded, for grey-alpha and rgba scanlines
+static void premultiply_row(unsigned char *p, int comp, uint x)
+{
+   uint i;
+   int k, a, t;
+   for (i=0; i < x; ++i, p += comp) {
+      a = p[comp-1];
+      if (a == 255) continue;
+      for (k=0; k < comp-1; ++k) {
+         t = p[k] * a + 128;
+         p[k] = (uint8) ((t + (t >> 8)) >> 8);
       }
-      #undef CASE
+   }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  decode into a caller buffer
+//    jpeg writes its output rows straight into the buffer, other formats
+//    decode with the requested components and are copied row by row
+
+int stbi_layout_stride(stbi_layout const *layout, int x)
+{
+   int align = layout->row_alignment > 1 ? layout->row_alignment : 1;
+   return (x * layout->comp + align-1) / align * align;
+}
+
+static int stbi_load_into_main(stbi *s, stbi_uc *dest, int dest_size, stbi_layout const *layout, int *x, int *y, int *comp)
+{
+   unsigned char *data;
+   int j, n, stride;
+
+   if (layout->comp < 1 || layout->comp > 4) return e("bad req_comp", "Internal error");
+   if (layout->row_alignment < 0 || layout->row_alignment > 8 || (layout->row_alignment & (layout->row_alignment-1)))
+      return e("bad row alignment", "Internal error");
+
+   if (stbi_jpeg_test(s))
+      return stbi_jpeg_load_into(s, dest, dest_size, layout->row_alignment, layout->comp, x, y, comp);
+
+   // the decoded components can differ from *comp (png tRNS adds alpha), so
+   // let the decoder convert
+   data = stbi_load_main(s, x, y, &n, layout->comp);
+   if (!data) return 0;
+
+   stride = stbi_layout_stride(layout, *x);
+   if ((double) stride * *y > dest_size) {
+      free(data);
+      return e("buffer too small", "Destination buffer too small");
+   }
+
+   for (j=0; j < *y; ++j) {
+      unsigned char *row = data + j * *x * layout->comp;
+      // premultiplied in the decoded image, so the destination is only written
+      if (layout->premultiply_alpha && !(layout->comp & 1))
+         premultiply_row(row, layout->comp, *x);
+      memcpy(dest + j * stride, row, *x * layout->comp);
    }
 
    free(data);
-   return good;
+   if (comp) *comp = n;
+   return 1;
+}
+
+#ifndef STBI_NO_STDIO
+int stbi_load_into_ctx(stbi_context *ctx, char const *filename, stbi_uc *dest, int dest_size, stbi_layout const *layout, int *x, int *y, int *comp)
+{
+   stbi_context *prev = enter_context(ctx);
+   FILE *f = fopen(filename, "rb");
+   int result;
+   if (f) {
+      result = stbi_load_from_file_into_ctx(ctx,f,dest,dest_size,layout,x,y,comp);
+      fclose(f);
+   } else
+      result = e("can't fopen", "Unable to open file");
+   active_context = prev;
+   return result;
+}
+
+int stbi_load_from_file_into_ctx(stbi_context *ctx, FILE *f, stbi_uc *dest, int dest_size, stbi_layout const *layout, int *x, int *y, int *comp)
+{
+   stbi_context *prev = enter_context(ctx);
+   int result;
+   stbi s;
+   start_file(&s,f);
+   result = stbi_load_into_main(&s,dest,dest_size,layout,x,y,comp);
+   active_context = prev;
+   return result;
+}
+#endif //!STBI_NO_STDIO
+
+int stbi_load_from_memory_into_ctx(stbi_context *ctx, stbi_uc const *buffer, int len, stbi_uc *dest, int dest_size, stbi_layout const *layout, int *x, int *y, int *comp)
+{
+   stbi_context *prev = enter_context(ctx);
+   int result;
+   stbi s;
+   start_mem(&s,buffer,len);
+   result = stbi_load_into_main(&s,dest,dest_size,layout,x,y,comp);
+   active_context = prev;
+   return result;
+}
+
+int stbi_load_from_callbacks_into_ctx(stbi_context *ctx, stbi_io_callbacks const *clbk, void *user, stbi_uc *dest, int dest_size, stbi_layout const *layout, int *x, int *y, int *comp)
+{
+   stbi_context *prev = enter_context(ctx);
+   int result;
+   stbi s;
+   start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   result = stbi_load_into_main(&s,dest,dest_size,layout,x,y,comp);
+   active_context = prev;
+   return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  decode in row strips
+//    png and jpeg pass rows on while decoding, other formats (and interlaced
+//    png) decode the whole image first and hand it out in strips
+
+#ifndef STBI_ROW_STRIP_BYTES
+#define STBI_ROW_STRIP_BYTES  (256*1024)
+#endif
+
+static int rows_per_strip(int x, int y, int comp)
+{
+   int n = STBI_ROW_STRIP_BYTES / (x * comp);
+   if (n > y) n = y;
+   return n > 0 ? n : 1;
+}
+
+static int rows_begin(stbi_rows *r, int x, int y, int comp)
+{
+   r->x = x;
+   r->y = y;
+   r->comp = comp;
+   r->strip_rows = rows_per_strip(x, y, comp);
+   r->num_rows = r->first_row = 0;
+   // one byte of slack - the jpeg rgb writers store a 4th byte past each pixel
+   r->strip = (uint8 *) malloc(r->strip_rows * x * comp + 1);
+   if (r->strip == NULL) return e("outofmem", "Out of memory");
+   return 1;
+}
+
+// where the next row goes
+stbi_inline static uint8 *rows_next(stbi_rows *r)
+{
+   return r->strip + r->num_rows * r->x * r->comp;
+}
+
+// a row was written at rows_next; pass the strip on when it's full or the image is done
+static int rows_commit(stbi_rows *r)
+{
+   if (++r->num_rows < r->strip_rows && r->first_row + r->num_rows < r->y)
+      return 1;
+   if (!r->callback(r->user, r->strip, r->first_row, r->num_rows, r->x, r->y, r->comp))
+      return e("aborted", "Decoding stopped by callback");
+   r->first_row += r->num_rows;
+   r->num_rows = 0;
+   return 1;
+}
+
+// fully decoded image - strips point straight into it
+static int rows_from_image(stbi_rows *r, uint8 *data, int x, int y, int comp)
+{
+   int j, n, strip_rows = rows_per_strip(x, y, comp);
+   for (j=0; j < y; j += n) {
+      n = y - j < strip_rows ? y - j : strip_rows;
+      if (!r->callback(r->user, data + (size_t) j * x * comp, j, n, x, y, comp))
+         return e("aborted", "Decoding stopped by callback");
+   }
+   return 1;
+}
+
+static int stbi_load_rows_main(stbi *s, int req_comp, stbi_row_callback callback, void *user, int *x, int *y, int *comp)
+{
+   stbi_rows r;
+   unsigned char *data;
+   int n, result;
+
+   if (req_comp < 0 || req_comp > 4) return e("bad req_comp", "Internal error");
+   r.callback = callback;
+   r.user = user;
+   r.strip = NULL;
+
+   if (stbi_jpeg_test(s))
+      result = stbi_jpeg_load_rows(s, &r, req_comp, x, y, comp);
+   else if (stbi_png_test(s))
+      result = stbi_png_load_rows(s, &r, req_comp, x, y, comp);
+   else {
+      data = stbi_load_main(s, x, y, &n, req_comp);
+      result = data != NULL && rows_from_image(&r, data, *x, *y, req_comp ? req_comp : n);
+      if (data && comp) *comp = n;
+      free(data);
+   }
+
+   free(r.strip);
+   return result;
+}
+
+#ifndef STBI_NO_STDIO
+int stbi_load_rows_ctx(stbi_context *ctx, char const *filename, int req_comp, stbi_row_callback callback, void *user, int *x, int *y, int *comp)
+{
+   stbi_context *prev = enter_context(ctx);
+   FILE *f = fopen(filename, "rb");
+   int result;
+   if (f) {
+      result = stbi_load_from_file_rows_ctx(ctx,f,req_comp,callback,user,x,y,comp);
+      fclose(f);
+   } else
+      result = e("can't fopen", "Unable to open file");
+   active_context = prev;
+   return result;
+}
+
+int stbi_load_from_file_rows_ctx(stbi_context *ctx, FILE *f, int req_comp, stbi_row_callback callback, void *user, int *x, int *y, int *comp)
+{
+   stbi_context *prev = enter_context(ctx);
+   int result;
+   stbi s;
+   start_file(&s,f);
+   result = stbi_load_rows_main(&s,req_comp,callback,user,x,y,comp);
+   active_context = prev;
+   return result;
+}
+#endif //!STBI_NO_STDIO
+
+int stbi_load_from_memory_rows_ctx(stbi_context *ctx, stbi_uc const *buffer, int len, int req_comp, stbi_row_callback callback, void *user, int *x, int *y, int *comp)
+{
+   stbi_context *prev = enter_context(ctx);
+   int result;
+   stbi s;
+   start_mem(&s,buffer,len);
+   result = stbi_load_rows_main(&s,req_comp,callback,user,x,y,comp);
+   active_context = prev;
+   return result;
+}
+
+int stbi_load_from_callbacks_rows_ctx(stbi_context *ctx, stbi_io_callbacks const *clbk, void *user, int req_comp, stbi_row_callback callback, void *callback_user, int *x, int *y, int *comp)
+{
+   stbi_context *prev = enter_context(ctx);
+   int result;
+   stbi s;
+   start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   result = stbi_load_rows_main(&s,req_comp,callback,callback_user,x,y,comp);
+   active_context = prev;
+   return result;
 }
 
 #ifndef STBI_NO_HDR
 static float   *ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
 {
    int i,k,n;
+   float l2h_gamma = settings()->ldr_to_hdr_gamma, l2h_scale = settings()->ldr_to_hdr_scale;
    float *output = (float *) malloc(x * y * comp * sizeof(float));
    if (output == NULL) { free(data); return epf("outofmem", "Out of memory"); }
    // compute number of non-alpha components
@@ -630,6 +1072,7 @@ static float   *ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
 static stbi_uc *hdr_to_ldr(float   *data, int x, int y, int comp)
 {
    int i,k,n;
+   float h2l_gamma_i = 1/settings()->hdr_to_ldr_gamma, h2l_scale_i = 1/settings()->hdr_to_ldr_scale;
    stbi_uc *output = (stbi_uc *) malloc(x * y * comp);
    if (output == NULL) { free(data); return epuc("outofmem", "Out of memory"); }
    // compute number of non-alpha components
@@ -694,6 +1137,15 @@ typedef struct
    int    delta[17];   // old 'firstsymbol' - old 'firstcode'
 } huffman;
 
+#ifdef STBI_SIMD
+typedef unsigned short stbi_dequantize_t;
+#else
+typedef uint8 stbi_dequantize_t;
+#endif
+
+typedef uint8 *(*resample_row_func)(uint8 *out, uint8 *in0, uint8 *in1,
+                                    int w, int hs);
+
 typedef struct
 {
    #ifdef STBI_SIMD
@@ -731,6 +1183,20 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+
+// kernels for this decode, picked by setup_jpeg
+   void (*idct_block_kernel)(uint8 *out, int out_stride, short data[64], stbi_dequantize_t *dequantize);
+   void (*YCbCr_to_RGB_kernel)(uint8 *out, const uint8 *y, const uint8 *pcb, const uint8 *pcr, int count, int step);
+   resample_row_func resample_row_v_2_kernel;
+   resample_row_func resample_row_h_2_kernel;
+   resample_row_func resample_row_hv_2_kernel;
+
+// caller buffer for stbi_load_into, NULL to allocate the output
+   uint8 *dest;
+   int dest_size, dest_alignment;
+
+   // or pass rows on in strips
+   stbi_rows *rows;
 } jpeg;
 
 static int build_huffman(huffman *h, int *count)
@@ -975,12 +1441,6 @@ stbi_inline static uint8 clamp(int x)
    t1 += p2+p4;                                \
    t0 += p1+p3;
 
-#ifdef STBI_SIMD
-typedef unsigned short stbi_dequantize_t;
-#else
-typedef uint8 stbi_dequantize_t;
-#endif
-
 // .344 seconds on 3*anemones.jpg
 static void idct_block(uint8 *out, int out_stride, short data[64], stbi_dequantize_t *dequantize)
 {
@@ -1105,9 +1565,9 @@ static int parse_entropy_coded_data(jpeg *z)
          for (i=0; i < w; ++i) {
             if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
             #ifdef STBI_SIMD
-            stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
+            z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
             #else
-            idct_block(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
+            z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
             #endif
             // every data block is an MCU, so countdown the restart interval
             if (--z->todo <= 0) {
@@ -1135,9 +1595,9 @@ static int parse_entropy_coded_data(jpeg *z)
                      int y2 = (j*z->img_comp[n].v + y)*8;
                      if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
                      #ifdef STBI_SIMD
-                     stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
+                     z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
                      #else
-                     idct_block(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
+                     z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
                      #endif
                   }
                }
@@ -1384,9 +1844,6 @@ static int decode_jpeg_image(jpeg *j)
 
 // static jfif-centered resampling (across block boundaries)
 
-typedef uint8 *(*resample_row_func)(uint8 *out, uint8 *in0, uint8 *in1,
-                                    int w, int hs);
-
 #define div4(x) ((uint8) ((x) >> 2))
 
 static uint8 *resample_row_1(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
@@ -1511,6 +1968,388 @@ void stbi_install_YCbCr_to_RGB(stbi_YCbCr_to_RGB_run func)
 }
 #endif
 
+#ifdef STBI_SSE2
+// SSE2 versions of the kernels above - same integer math, so output is bit-identical
+// for every stream whose dequantized coefficients fit in 16 bits (all valid 8-bit JPEGs)
+
+#ifdef _MSC_VER
+static int sse2_available(void)
+{
+   int info[4];
+   __cpuid(info, 1);
+   return (info[3] >> 26) & 1;
+}
+#else
+static int sse2_available(void)
+{
+   // compiled with __SSE2__, so the rest of the code requires it anyway
+   return 1;
+}
+#endif
+
+static void idct_block_sse2(uint8 *out, int out_stride, short data[64], stbi_dequantize_t *dequantize)
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y))
+
+   // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+   // out(1) = c1[even]*x + c1[odd]*y
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m128i c0##lo = _mm_unpacklo_epi16((x),(y)); \
+      __m128i c0##hi = _mm_unpackhi_epi16((x),(y)); \
+      __m128i out0##_l = _mm_madd_epi16(c0##lo, c0); \
+      __m128i out0##_h = _mm_madd_epi16(c0##hi, c0); \
+      __m128i out1##_l = _mm_madd_epi16(c0##lo, c1); \
+      __m128i out1##_h = _mm_madd_epi16(c0##hi, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m128i out##_l = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), (in)), 4); \
+      __m128i out##_h = _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), (in)), 4)
+
+   #define dct_wadd(out, a, b) \
+      __m128i out##_l = _mm_add_epi32(a##_l, b##_l); \
+      __m128i out##_h = _mm_add_epi32(a##_h, b##_h)
+
+   #define dct_wsub(out, a, b) \
+      __m128i out##_l = _mm_sub_epi32(a##_l, b##_l); \
+      __m128i out##_h = _mm_sub_epi32(a##_h, b##_h)
+
+   // butterfly a/b, add bias, then shift by "s" and pack
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m128i abiased_l = _mm_add_epi32(a##_l, bias); \
+         __m128i abiased_h = _mm_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm_packs_epi32(_mm_srai_epi32(sum_l, s), _mm_srai_epi32(sum_h, s)); \
+         out1 = _mm_packs_epi32(_mm_srai_epi32(dif_l, s), _mm_srai_epi32(dif_h, s)); \
+      }
+
+   // interleave steps for the transposes
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   // IDCT_1D on 8 columns at once, same decomposition as the scalar macro
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m128i rot0_0 = dct_const(f2f(0.5411961f), f2f(0.5411961f) + f2f(-1.847759065f));
+   __m128i rot0_1 = dct_const(f2f(0.5411961f) + f2f( 0.765366865f), f2f(0.5411961f));
+   __m128i rot1_0 = dct_const(f2f(1.175875602f) + f2f(-0.899976223f), f2f(1.175875602f));
+   __m128i rot1_1 = dct_const(f2f(1.175875602f), f2f(1.175875602f) + f2f(-2.562915447f));
+   __m128i rot2_0 = dct_const(f2f(-1.961570560f) + f2f( 0.298631336f), f2f(-1.961570560f));
+   __m128i rot2_1 = dct_const(f2f(-1.961570560f), f2f(-1.961570560f) + f2f( 3.072711026f));
+   __m128i rot3_0 = dct_const(f2f(-0.390180644f) + f2f( 2.053119869f), f2f(-0.390180644f));
+   __m128i rot3_1 = dct_const(f2f(-0.390180644f), f2f(-0.390180644f) + f2f( 1.501321110f));
+
+   // rounding biases of the column and row passes, see idct_block
+   __m128i bias_0 = _mm_set1_epi32(512);
+   __m128i bias_1 = _mm_set1_epi32(65536 + (128<<17));
+   __m128i zero   = _mm_setzero_si128();
+
+   // load and dequantize
+   #define dct_load(row, i) \
+      row = _mm_mullo_epi16(_mm_loadu_si128((const __m128i *) (data + (i)*8)), \
+                            _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (dequantize + (i)*8)), zero))
+
+   dct_load(row0, 0);
+   dct_load(row1, 1);
+   dct_load(row2, 2);
+   dct_load(row3, 3);
+   dct_load(row4, 4);
+   dct_load(row5, 5);
+   dct_load(row6, 6);
+   dct_load(row7, 7);
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack with unsigned saturation - same as clamp()
+      __m128i p0 = _mm_packus_epi16(row0, row1);
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose
+      dct_interleave8(p0, p2);
+      dct_interleave8(p1, p3);
+
+      dct_interleave8(p0, p1);
+      dct_interleave8(p2, p3);
+
+      dct_interleave8(p0, p2);
+      dct_interleave8(p1, p3);
+
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+   #undef dct_const
+   #undef dct_rot
+   #undef dct_widen
+   #undef dct_wadd
+   #undef dct_wsub
+   #undef dct_bfly32o
+   #undef dct_interleave8
+   #undef dct_interleave16
+   #undef dct_pass
+   #undef dct_load
+}
+
+static uint8 *resample_row_v_2_sse2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
+{
+   int i;
+   __m128i zero = _mm_setzero_si128();
+   __m128i bias = _mm_set1_epi16(2);
+   for (i=0; i+8 <= w; i += 8) {
+      __m128i nearw = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (in_near + i)), zero);
+      __m128i farw  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (in_far  + i)), zero);
+      // 3*near + far + 2
+      __m128i sum   = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(nearw, 1), nearw), _mm_add_epi16(farw, bias));
+      _mm_storel_epi64((__m128i *) (out + i), _mm_packus_epi16(_mm_srli_epi16(sum, 2), zero));
+   }
+   for (; i < w; ++i)
+      out[i] = div4(3*in_near[i] + in_far[i] + 2);
+   STBI_NOTUSED(hs);
+   return out;
+}
+
+static uint8 *resample_row_h_2_sse2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
+{
+   int i;
+   uint8 *input = in_near;
+   __m128i zero = _mm_setzero_si128();
+   __m128i bias = _mm_set1_epi16(2);
+
+   if (w == 1)
+      return resample_row_h_2(out, in_near, in_far, w, hs);
+
+   out[0] = input[0];
+   out[1] = div4(input[0]*3 + input[1] + 2);
+   // 8 input pixels per step, input[i+8] is the last one read
+   for (i=1; i+8 < w; i += 8) {
+      __m128i prev = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (input + i - 1)), zero);
+      __m128i curr = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (input + i    )), zero);
+      __m128i next = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (input + i + 1)), zero);
+      __m128i n    = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(curr, 1), curr), bias);
+      __m128i even = _mm_srli_epi16(_mm_add_epi16(n, prev), 2);
+      __m128i odd  = _mm_srli_epi16(_mm_add_epi16(n, next), 2);
+      _mm_storeu_si128((__m128i *) (out + i*2), _mm_packus_epi16(_mm_unpacklo_epi16(even, odd), _mm_unpackhi_epi16(even, odd)));
+   }
+   for (; i < w-1; ++i) {
+      int n = 3*input[i]+2;
+      out[i*2+0] = div4(n+input[i-1]);
+      out[i*2+1] = div4(n+input[i+1]);
+   }
+   out[i*2+0] = div4(input[w-2]*3 + input[w-1] + 2);
+   out[i*2+1] = input[w-1];
+   return out;
+}
+
+static uint8 *resample_row_hv_2_sse2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
+{
+   int i=0,t0,t1;
+   __m128i zero = _mm_setzero_si128();
+   __m128i bias = _mm_set1_epi16(8);
+
+   if (w == 1) {
+      out[0] = out[1] = div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   // groups of 8 pixels, the last pixel of the row is left for the boundary code below
+   for (; i < ((w-1) & ~7); i += 8) {
+      // vertical pass: 3*near + far = 4*near + (far - near)
+      __m128i nearw = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (in_near + i)), zero);
+      __m128i farw  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (in_far  + i)), zero);
+      __m128i curr  = _mm_add_epi16(_mm_slli_epi16(nearw, 2), _mm_sub_epi16(farw, nearw));
+
+      // current row shifted by one pixel either way, the missing ends come from t1 and pixel i+8
+      __m128i prev  = _mm_insert_epi16(_mm_slli_si128(curr, 2), t1, 0);
+      __m128i next  = _mm_insert_epi16(_mm_srli_si128(curr, 2), 3*in_near[i+8] + in_far[i+8], 7);
+
+      // even pixels = 3*cur + prev, odd pixels = 3*cur + next
+      __m128i curb  = _mm_add_epi16(_mm_slli_epi16(curr, 2), bias);
+      __m128i even  = _mm_add_epi16(_mm_sub_epi16(prev, curr), curb);
+      __m128i odd   = _mm_add_epi16(_mm_sub_epi16(next, curr), curb);
+
+      __m128i int0  = _mm_srli_epi16(_mm_unpacklo_epi16(even, odd), 4);
+      __m128i int1  = _mm_srli_epi16(_mm_unpackhi_epi16(even, odd), 4);
+      _mm_storeu_si128((__m128i *) (out + i*2), _mm_packus_epi16(int0, int1));
+
+      t1 = 3*in_near[i+7] + in_far[i+7];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = div16(3*t0 + t1 + 8);
+      out[i*2  ] = div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+
+static void YCbCr_to_RGB_row_sse2(uint8 *out, const uint8 *y, const uint8 *pcb, const uint8 *pcr, int count, int step)
+{
+   // the 16.16 constants of YCbCr_to_RGB_row split into a multiple of 1<<16 and a 16-bit
+   // remainder, so madd can do the fixed point products exactly
+   __m128i cr_const_r = _mm_setr_epi16(float2fixed(1.40200f) - 65536, 0, float2fixed(1.40200f) - 65536, 0,
+                                       float2fixed(1.40200f) - 65536, 0, float2fixed(1.40200f) - 65536, 0);
+   __m128i crcb_const_g = _mm_setr_epi16(65536 - float2fixed(0.71414f), -float2fixed(0.34414f), 65536 - float2fixed(0.71414f), -float2fixed(0.34414f),
+                                         65536 - float2fixed(0.71414f), -float2fixed(0.34414f), 65536 - float2fixed(0.71414f), -float2fixed(0.34414f));
+   __m128i cb_const_b = _mm_setr_epi16(0, float2fixed(1.77200f) - 131072, 0, float2fixed(1.77200f) - 131072,
+                                       0, float2fixed(1.77200f) - 131072, 0, float2fixed(1.77200f) - 131072);
+   __m128i round   = _mm_set1_epi32(32768);
+   __m128i bias    = _mm_set1_epi16(128);
+   __m128i alpha   = _mm_set1_epi16(255);
+   __m128i zero    = _mm_setzero_si128();
+   uint8 rgbx[32];
+   int i, k;
+
+   #define fixed_row(madd_lo, madd_hi) \
+      _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(madd_lo, round), 16), _mm_srai_epi32(_mm_add_epi32(madd_hi, round), 16))
+
+   for (i=0; i+8 <= count; i += 8) {
+      __m128i yw   = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (y   + i)), zero);
+      __m128i cbw  = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (pcb + i)), zero), bias);
+      __m128i crw  = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (pcr + i)), zero), bias);
+      __m128i crcb_lo = _mm_unpacklo_epi16(crw, cbw);
+      __m128i crcb_hi = _mm_unpackhi_epi16(crw, cbw);
+
+      // r = y + cr + (cr*0.402), g = y - cr + (cr*0.28586 - cb*0.34414), b = y + 2*cb + (cb*-0.228)
+      __m128i r = _mm_add_epi16(fixed_row(_mm_madd_epi16(crcb_lo, cr_const_r),   _mm_madd_epi16(crcb_hi, cr_const_r)),   _mm_add_epi16(yw, crw));
+      __m128i g = _mm_add_epi16(fixed_row(_mm_madd_epi16(crcb_lo, crcb_const_g), _mm_madd_epi16(crcb_hi, crcb_const_g)), _mm_sub_epi16(yw, crw));
+      __m128i b = _mm_add_epi16(fixed_row(_mm_madd_epi16(crcb_lo, cb_const_b),   _mm_madd_epi16(crcb_hi, cb_const_b)),   _mm_add_epi16(yw, _mm_slli_epi16(cbw, 1)));
+
+      // clamp to 0..255 and interleave to rgba
+      __m128i rg   = _mm_packus_epi16(r, g);
+      __m128i ba   = _mm_packus_epi16(b, alpha);
+      __m128i rgi  = _mm_unpacklo_epi8(rg, _mm_srli_si128(rg, 8));
+      __m128i bai  = _mm_unpacklo_epi8(ba, _mm_srli_si128(ba, 8));
+      __m128i o0   = _mm_unpacklo_epi16(rgi, bai);
+      __m128i o1   = _mm_unpackhi_epi16(rgi, bai);
+
+      if (step == 4) {
+         _mm_storeu_si128((__m128i *) (out +  0), o0);
+         _mm_storeu_si128((__m128i *) (out + 16), o1);
+      } else {
+         _mm_storeu_si128((__m128i *) (rgbx +  0), o0);
+         _mm_storeu_si128((__m128i *) (rgbx + 16), o1);
+         for (k=0; k < 8; ++k) {
+            out[k*step+0] = rgbx[k*4+0];
+            out[k*step+1] = rgbx[k*4+1];
+            out[k*step+2] = rgbx[k*4+2];
+         }
+      }
+      out += 8*step;
+   }
+
+   #undef fixed_row
+
+   YCbCr_to_RGB_row(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+#endif // STBI_SSE2
+
+// pick the scalar, installed (STBI_SIMD) or SSE2 kernels for this decode
+static void setup_jpeg(jpeg *j)
+{
+   j->idct_block_kernel        = idct_block;
+   j->YCbCr_to_RGB_kernel      = YCbCr_to_RGB_row;
+   j->resample_row_v_2_kernel  = resample_row_v_2;
+   j->resample_row_h_2_kernel  = resample_row_h_2;
+   j->resample_row_hv_2_kernel = resample_row_hv_2;
+   j->dest                     = NULL;
+   j->rows                     = NULL;
+
+   #ifdef STBI_SIMD
+   j->idct_block_kernel   = stbi_idct_installed;
+   j->YCbCr_to_RGB_kernel = stbi_YCbCr_installed;
+   #endif
+
+   #ifdef STBI_SSE2
+   if (!settings()->no_simd && sse2_available()) {
+      j->idct_block_kernel        = idct_block_sse2;
+      j->YCbCr_to_RGB_kernel      = YCbCr_to_RGB_row_sse2;
+      j->resample_row_v_2_kernel  = resample_row_v_2_sse2;
+      j->resample_row_h_2_kernel  = resample_row_h_2_sse2;
+      j->resample_row_hv_2_kernel = resample_row_hv_2_sse2;
+   }
+   #endif
+}
+
 
 // clean up the temporary component buffers
 static void cleanup_jpeg(jpeg *j)
@@ -1560,8 +2399,9 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int re
    {
       int k;
       uint i,j;
-      uint8 *output;
+      uint8 *output, *last_row = NULL;
       uint8 *coutput[4];
+      uint stride = n * z->s->img_x;
 
       stbi_resample res_comp[4];
 
@@ -1581,19 +2421,35 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int re
          r->line0   = r->line1 = z->img_comp[k].data;
 
          if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = resample_row_h_2;
-         else if (r->hs == 2 && r->vs == 2) r->resample = resample_row_hv_2;
+         else if (r->hs == 1 && r->vs == 2) r->resample = z->resample_row_v_2_kernel;
+         else if (r->hs == 2 && r->vs == 1) r->resample = z->resample_row_h_2_kernel;
+         else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
          else                               r->resample = resample_row_generic;
       }
 
-      // can't error after this so, this is safe
-      output = (uint8 *) malloc(n * z->s->img_x * z->s->img_y + 1);
-      if (!output) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
+      if (z->rows) {
+         // rows are written into the strip; its pointer is only returned as the success marker
+         if (!rows_begin(z->rows, z->s->img_x, z->s->img_y, n)) { cleanup_jpeg(z); return NULL; }
+         output = z->rows->strip;
+      } else if (z->dest) {
+         stride = (stride + z->dest_alignment-1) / z->dest_alignment * z->dest_alignment;
+         if ((double) stride * z->s->img_y > z->dest_size) { cleanup_jpeg(z); return epuc("buffer too small", "Destination buffer too small"); }
+         // rgb rows are written with a 4th byte past the end - the last row goes through a
+         // temporary, so nothing is written outside the caller's buffer
+         if (n == 3) {
+            last_row = (uint8 *) malloc(n * z->s->img_x + 1);
+            if (!last_row) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
+         }
+         output = z->dest;
+      } else {
+         // can't error after this so, this is safe
+         output = (uint8 *) malloc(n * z->s->img_x * z->s->img_y + 1);
+         if (!output) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
+      }
 
       // now go ahead and resample
       for (j=0; j < z->s->img_y; ++j) {
-         uint8 *out = output + n * z->s->img_x * j;
+         uint8 *out = z->rows ? rows_next(z->rows) : last_row && j+1 == z->s->img_y ? last_row : output + stride * j;
          for (k=0; k < decode_n; ++k) {
             stbi_resample *r = &res_comp[k];
             int y_bot = r->ystep >= (r->vs >> 1);
@@ -1611,11 +2467,7 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int re
          if (n >= 3) {
             uint8 *y = coutput[0];
             if (z->s->img_n == 3) {
-               #ifdef STBI_SIMD
-               stbi_YCbCr_installed(out, y, coutput[1], coutput[2], z->s.img_x, n);
-               #else
-               YCbCr_to_RGB_row(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               #endif
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
             } else
                for (i=0; i < z->s->img_x; ++i) {
                   out[0] = out[1] = out[2] = y[i];
@@ -1629,6 +2481,11 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int re
             else
                for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
          }
+         if (z->rows && !rows_commit(z->rows)) { cleanup_jpeg(z); return NULL; }
+      }
+      if (last_row) {
+         memcpy(output + stride * (z->s->img_y-1), last_row, n * z->s->img_x);
+         free(last_row);
       }
       cleanup_jpeg(z);
       *out_x = z->s->img_x;
@@ -1642,9 +2499,31 @@ static unsigned char *stbi_jpeg_load(stbi *s, int *x, int *y, int *comp, int req
 {
    jpeg j;
    j.s = s;
+   setup_jpeg(&j);
    return load_jpeg_image(&j, x,y,comp,req_comp);
 }
 
+// jpegs never have alpha, so any layout is written directly
+static int stbi_jpeg_load_into(stbi *s, stbi_uc *dest, int dest_size, int row_alignment, int req_comp, int *x, int *y, int *comp)
+{
+   jpeg j;
+   j.s = s;
+   setup_jpeg(&j);
+   j.dest           = dest;
+   j.dest_size      = dest_size;
+   j.dest_alignment = row_alignment > 1 ? row_alignment : 1;
+   return load_jpeg_image(&j, x,y,comp,req_comp) != NULL;
+}
+
+static int stbi_jpeg_load_rows(stbi *s, stbi_rows *r, int req_comp, int *x, int *y, int *comp)
+{
+   jpeg j;
+   j.s = s;
+   setup_jpeg(&j);
+   j.rows = r;
+   return load_jpeg_image(&j, x,y,comp,req_comp) != NULL;
+}
+
 static int stbi_jpeg_test(stbi *s)
 {
    int r;
@@ -1679,17 +2558,25 @@ static int stbi_jpeg_info(stbi *s, int *x, int *y, int *comp)
 //      - all input must be provided in an upfront buffer
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
-//      - fast huffman
+//      - fast huffman, two literals per lookup
+//      - 64-bit bit buffer, 8 byte match copies
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define ZFAST_BITS  9 // accelerate all cases in default tables
+#define ZFAST_BITS  11 // accelerate all cases in default tables, leaves room for literal pairs
 #define ZFAST_MASK  ((1 << ZFAST_BITS) - 1)
 
+// fast table entry: bits 0..8 symbol, 9..16 second literal, 17..21 code bits, 22..23 symbol count (0 = slow path)
+#define zfast_entry(count,bits,sym,sym2)  ((uint32) (count) << 22 | (uint32) (bits) << 17 | (uint32) (sym2) << 9 | (uint32) (sym))
+#define zfast_count(e)   ((int) ((e) >> 22))
+#define zfast_bits(e)    ((int) ((e) >> 17) & 31)
+#define zfast_sym(e)     ((int) (e) & 511)
+#define zfast_sym2(e)    ((int) ((e) >> 9) & 255)
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
 {
-   uint16 fast[1 << ZFAST_BITS];
+   uint32 fast[1 << ZFAST_BITS];
    uint16 firstcode[16];
    int maxcode[17];
    uint16 firstsymbol[16];
@@ -1714,14 +2601,14 @@ stbi_inline static int bit_reverse(int v, int bits)
    return bitreverse16(v) >> (16-bits);
 }
 
-static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
+static int zbuild_huffman(zhuffman *z, const uint8 *sizelist, int num)
 {
    int i,k=0;
    int code, next_code[16], sizes[17];
 
    // DEFLATE spec for generating codes
    memset(sizes, 0, sizeof(sizes));
-   memset(z->fast, 255, sizeof(z->fast));
+   memset(z->fast, 0, sizeof(z->fast));
    for (i=0; i < num; ++i) 
       ++sizes[sizelist[i]];
    sizes[0] = 0;
@@ -1749,7 +2636,7 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
          if (s <= ZFAST_BITS) {
             int k = bit_reverse(next_code[s],s);
             while (k < (1 << ZFAST_BITS)) {
-               z->fast[k] = (uint16) c;
+               z->fast[k] = zfast_entry(1, s, i, 0);
                k += (1 << s);
             }
          }
@@ -1759,6 +2646,22 @@ static int zbuild_huffman(zhuffman *z, uint8 *sizelist, int num)
    return 1;
 }
 
+// merge literals whose codes fit in the fast table together - literal/length table only
+static void zbuild_literal_pairs(zhuffman *z)
+{
+   int k;
+   // descending, so the entry for the remaining bits (k >> s, always <= k) is still a single symbol
+   for (k=(1 << ZFAST_BITS)-1; k >= 0; --k) {
+      uint32 first = z->fast[k];
+      int s = zfast_bits(first);
+      if (zfast_count(first) == 1 && zfast_sym(first) < 256 && s < ZFAST_BITS) {
+         uint32 second = z->fast[k >> s];
+         if (zfast_count(second) == 1 && zfast_sym(second) < 256 && s + zfast_bits(second) <= ZFAST_BITS)
+            z->fast[k] = zfast_entry(2, s + zfast_bits(second), zfast_sym(first), zfast_sym(second));
+      }
+   }
+}
+
 // zlib-from-memory implementation for PNG reading
 //    because PNG allows splitting the zlib stream arbitrarily,
 //    and it's annoying structurally to have PNG call ZLIB call PNG,
@@ -1769,13 +2672,19 @@ typedef struct
 {
    uint8 *zbuffer, *zbuffer_end;
    int num_bits;
-   uint32 code_buffer;
+   uint64 code_buffer;
 
    char *zout;
    char *zout_start;
    char *zout_end;
    int   z_expandable;
 
+   // streaming: output before zconsumed was taken by 'consume' and is only
+   // kept as the 32k window, so the buffer slides instead of growing
+   int  (*consume)(void *user, uint8 *data, int len);   // returns bytes used, -1 on error
+   void  *consume_user;
+   char  *zconsumed;
+
    zhuffman z_length, z_distance;
 } zbuf;
 
@@ -1785,40 +2694,47 @@ stbi_inline static int zget8(zbuf *z)
    return *z->zbuffer++;
 }
 
+// fills the bit buffer to at least 56 bits
 static void fill_bits(zbuf *z)
 {
+   assert(z->code_buffer < ((uint64) 1 << z->num_bits));
+   #ifdef STBI_LITTLE_ENDIAN
+   if (z->zbuffer_end - z->zbuffer >= 8) {
+      // load 8 bytes, keep the whole ones that fit
+      uint64 word;
+      int n = (63 - z->num_bits) >> 3;
+      memcpy(&word, z->zbuffer, 8);
+      z->code_buffer |= word << z->num_bits;
+      z->zbuffer += n;
+      z->num_bits += n * 8;
+      z->code_buffer &= ((uint64) 1 << z->num_bits) - 1;
+      return;
+   }
+   #endif
    do {
-      assert(z->code_buffer < (1U << z->num_bits));
-      z->code_buffer |= zget8(z) << z->num_bits;
+      z->code_buffer |= (uint64) zget8(z) << z->num_bits;
       z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= 48);
 }
 
 stbi_inline static unsigned int zreceive(zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) (z->code_buffer & ((1 << n) - 1));
    z->code_buffer >>= n;
    z->num_bits -= n;
    return k;   
 }
 
-stbi_inline static int zhuffman_decode(zbuf *a, zhuffman *z)
+// code longer than ZFAST_BITS
+static int zhuffman_decode_slow(zbuf *a, zhuffman *z)
 {
    int b,s,k;
-   if (a->num_bits < 16) fill_bits(a);
-   b = z->fast[a->code_buffer & ZFAST_MASK];
-   if (b < 0xffff) {
-      s = z->size[b];
-      a->code_buffer >>= s;
-      a->num_bits -= s;
-      return z->value[b];
-   }
 
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = bit_reverse(a->code_buffer, 16);
+   k = bit_reverse((int) (a->code_buffer & 0xffff), 16);
    for (s=ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
@@ -1831,10 +2747,44 @@ stbi_inline static int zhuffman_decode(zbuf *a, zhuffman *z)
    return z->value[b];
 }
 
+// single symbol tables only (distance, code lengths)
+stbi_inline static int zhuffman_decode(zbuf *a, zhuffman *z)
+{
+   uint32 b;
+   if (a->num_bits < 16) fill_bits(a);
+   b = z->fast[a->code_buffer & ZFAST_MASK];
+   if (b) {
+      a->code_buffer >>= zfast_bits(b);
+      a->num_bits -= zfast_bits(b);
+      return zfast_sym(b);
+   }
+   return zhuffman_decode_slow(a, z);
+}
+
+// hand finished output to the consumer and drop what's no longer in the window
+static int zslide(zbuf *z, int n)
+{
+   int drop, used = z->consume(z->consume_user, (uint8 *) z->zconsumed, (int) (z->zout - z->zconsumed));
+   if (used < 0) return 0;
+   z->zconsumed += used;
+
+   drop = (int) (z->zconsumed - z->zout_start);
+   if (drop > (int) (z->zout - z->zout_start) - 32768)
+      drop = (int) (z->zout - z->zout_start) - 32768;
+   if (drop > 0) {
+      memmove(z->zout_start, z->zout_start + drop, z->zout - z->zout_start - drop);
+      z->zconsumed -= drop;
+      z->zout      -= drop;
+   }
+   if (z->zout + n > z->zout_end) return e("output buffer limit","Corrupt PNG");
+   return 1;
+}
+
 static int expand(zbuf *z, int n)  // need to make room for n bytes
 {
    char *q;
    int cur, limit;
+   if (z->consume) return zslide(z, n);
    if (!z->z_expandable) return e("output buffer limit","Corrupt PNG");
    cur   = (int) (z->zout     - z->zout_start);
    limit = (int) (z->zout_end - z->zout_start);
@@ -1865,7 +2815,26 @@ static int dist_extra[32] =
 static int parse_huffman_block(zbuf *a)
 {
    for(;;) {
-      int z = zhuffman_decode(a, &a->z_length);
+      int z;
+      uint32 b;
+      // 56 bits cover a length and a distance code with their extra bits
+      if (a->num_bits < 48) fill_bits(a);
+      b = a->z_length.fast[a->code_buffer & ZFAST_MASK];
+      if (zfast_count(b) == 2) {
+         if (a->zout + 2 > a->zout_end) if (!expand(a, 2)) return 0;
+         a->zout[0] = (char) zfast_sym(b);
+         a->zout[1] = (char) zfast_sym2(b);
+         a->zout += 2;
+         a->code_buffer >>= zfast_bits(b);
+         a->num_bits -= zfast_bits(b);
+         continue;
+      }
+      if (b) {
+         z = zfast_sym(b);
+         a->code_buffer >>= zfast_bits(b);
+         a->num_bits -= zfast_bits(b);
+      } else
+         z = zhuffman_decode_slow(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return e("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (a->zout >= a->zout_end) if (!expand(a, 1)) return 0;
@@ -1884,8 +2853,23 @@ static int parse_huffman_block(zbuf *a)
          if (a->zout - a->zout_start < dist) return e("bad dist","Corrupt PNG");
          if (a->zout + len > a->zout_end) if (!expand(a, len)) return 0;
          p = (uint8 *) (a->zout - dist);
-         while (len--)
-            *a->zout++ = *p++;
+         if (dist >= 8 && a->zout + len + 8 <= a->zout_end) {
+            // 8 bytes at a time - each step reads bytes written before it, the overshoot is overwritten later
+            uint8 *q = (uint8 *) a->zout;
+            a->zout += len;
+            do {
+               memcpy(q, p, 8);
+               q += 8;
+               p += 8;
+               len -= 8;
+            } while (len > 0);
+         } else if (dist == 1) {
+            memset(a->zout, *p, len);
+            a->zout += len;
+         } else {
+            while (len--)
+               *a->zout++ = *p++;
+         }
       }
    }
 }
@@ -1933,6 +2917,7 @@ static int compute_huffman_codes(zbuf *a)
    if (n != hlit+hdist) return e("bad codelengths","Corrupt PNG");
    if (!zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
    if (!zbuild_huffman(&a->z_distance, lencodes+hlit, hdist)) return 0;
+   zbuild_literal_pairs(&a->z_length);
    return 1;
 }
 
@@ -1944,21 +2929,27 @@ static int parse_uncompressed_block(zbuf *a)
       zreceive(a, a->num_bits & 7); // discard
    // drain the bit-packed data into header
    k = 0;
-   while (a->num_bits > 0) {
+   while (a->num_bits > 0 && k < 4) {
       header[k++] = (uint8) (a->code_buffer & 255); // wtf this warns?
       a->code_buffer >>= 8;
       a->num_bits -= 8;
    }
-   assert(a->num_bits == 0);
    // now fill header the normal way
    while (k < 4)
       header[k++] = (uint8) zget8(a);
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return e("zlib corrupt","Corrupt PNG");
-   if (a->zbuffer + len > a->zbuffer_end) return e("read past buffer","Corrupt PNG");
    if (a->zout + len > a->zout_end)
       if (!expand(a, len)) return 0;
+   // the 64-bit buffer can still hold the first bytes of the block
+   while (a->num_bits > 0 && len > 0) {
+      *a->zout++ = (char) (a->code_buffer & 255);
+      a->code_buffer >>= 8;
+      a->num_bits -= 8;
+      --len;
+   }
+   if (a->zbuffer + len > a->zbuffer_end) return e("read past buffer","Corrupt PNG");
    memcpy(a->zout, a->zbuffer, len);
    a->zbuffer += len;
    a->zout += len;
@@ -1978,18 +2969,27 @@ static int parse_zlib_header(zbuf *a)
    return 1;
 }
 
-// @TODO: should statically initialize these for optimal thread safety
-static uint8 default_length[288], default_distance[32];
-static void init_defaults(void)
+// fixed huffman code lengths from the spec - 0..143: 8, 144..255: 9, 256..279: 7, 280..287: 8
+static const uint8 default_length[288] =
+{
+   8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+   8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+   8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+   8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+   8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+   8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+   9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+   9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+   9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+   9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+   9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,7,7,7,7,7,7,7,7,
+   7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,8,8,8,8,8,8,8,8
+};
+static const uint8 default_distance[32] =
 {
-   int i;   // use <= to match clearly with spec
-   for (i=0; i <= 143; ++i)     default_length[i]   = 8;
-   for (   ; i <= 255; ++i)     default_length[i]   = 9;
-   for (   ; i <= 279; ++i)     default_length[i]   = 7;
-   for (   ; i <= 287; ++i)     default_length[i]   = 8;
-
-   for (i=0; i <=  31; ++i)     default_distance[i] = 5;
-}
+   5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+   5,5,5,5,5,5,5,5
+};
 
 int stbi_png_partial; // a quick hack to only allow decoding some of a PNG... I should implement real streaming support instead
 static int parse_zlib(zbuf *a, int parse_header)
@@ -2009,15 +3009,15 @@ static int parse_zlib(zbuf *a, int parse_header)
       } else {
          if (type == 1) {
             // use fixed code lengths
-            if (!default_distance[31]) init_defaults();
             if (!zbuild_huffman(&a->z_length  , default_length  , 288)) return 0;
             if (!zbuild_huffman(&a->z_distance, default_distance,  32)) return 0;
+            zbuild_literal_pairs(&a->z_length);
          } else {
             if (!compute_huffman_codes(a)) return 0;
          }
          if (!parse_huffman_block(a)) return 0;
       }
-      if (stbi_png_partial && a->zout - a->zout_start > 65536)
+      if (stbi_png_partial && !a->consume && a->zout - a->zout_start > 65536)
          break;
    } while (!final);
    return 1;
@@ -2029,10 +3029,32 @@ static int do_zlib(zbuf *a, char *obuf, int olen, int exp, int parse_header)
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
+   a->consume      = NULL;
 
    return parse_zlib(a, parse_header);
 }
 
+// inflate into a buffer of bufsize bytes that slides over the output, which
+// all goes through 'consume' in order
+static int zlib_decode_stream(const char *buffer, int len, int parse_header, int bufsize, int (*consume)(void *user, uint8 *data, int len), void *user)
+{
+   zbuf a;
+   int result;
+   char *p = (char *) malloc(bufsize);
+   if (p == NULL) return e("outofmem", "Out of memory");
+   a.zbuffer = (uint8 *) buffer;
+   a.zbuffer_end = (uint8 *) buffer + len;
+   a.zout_start = a.zout = a.zconsumed = p;
+   a.zout_end = p + bufsize;
+   a.z_expandable = 0;
+   a.consume = consume;
+   a.consume_user = user;
+   result = parse_zlib(&a, parse_header) &&
+            consume(user, (uint8 *) a.zconsumed, (int) (a.zout - a.zconsumed)) >= 0;
+   free(p);
+   return result;
+}
+
 char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen)
 {
    zbuf a;
@@ -2148,6 +3170,7 @@ typedef struct
 {
    stbi *s;
    uint8 *idata, *expanded, *out;
+   stbi_rows *rows;   // stream rows instead of building 'out'
 } png;
 
 
@@ -2172,18 +3195,182 @@ static int paeth(int a, int b, int c)
    return c;
 }
 
+#ifdef STBI_SSE2
+// SSE2 unfiltering of a whole row when img_n == out_n - up works on any pixel size,
+// sub/avg/paeth one 3 or 4 byte pixel per step (the left neighbour of each pixel is the previous result)
+// 3 byte pixels are assembled bytewise - 4 byte accesses would run past the end of the row buffers
+stbi_inline static __m128i load_pixel(const uint8 *p, int n)
+{
+   int v;
+   if (n == 4)
+      memcpy(&v, p, 4);
+   else
+      v = p[0] | p[1] << 8 | p[2] << 16;
+   return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static void store_pixel(uint8 *p, __m128i v, int n)
+{
+   int t = _mm_cvtsi128_si32(v);
+   if (n == 4)
+      memcpy(p, &t, 4);
+   else {
+      p[0] = (uint8) t;
+      p[1] = (uint8) (t >> 8);
+      p[2] = (uint8) (t >> 16);
+   }
+}
+
+static int unfilter_row_sse2(int filter, uint8 *cur, const uint8 *prior, const uint8 *raw, uint32 x, int n)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i a = zero, c = zero;   // left and upper left, zero for the first pixel
+   uint32 i, len = x*n;
+
+   if (filter == F_up) {
+      for (i=0; i+16 <= len; i += 16)
+         _mm_storeu_si128((__m128i *) (cur + i), _mm_add_epi8(_mm_loadu_si128((const __m128i *) (raw + i)), _mm_loadu_si128((const __m128i *) (prior + i))));
+      for (; i < len; ++i)
+         cur[i] = raw[i] + prior[i];
+      return 1;
+   }
+   if (n != 3 && n != 4)
+      return 0;
+
+   switch (filter) {
+      case F_sub:
+         for (i=0; i < len; i += n) {
+            a = _mm_add_epi8(load_pixel(raw + i, n), a);
+            store_pixel(cur + i, a, n);
+         }
+         return 1;
+      case F_avg:
+         for (i=0; i < len; i += n) {
+            // floor((a+b)/2) from the rounding-up pavgb
+            __m128i b = load_pixel(prior + i, n);
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+            a = _mm_add_epi8(load_pixel(raw + i, n), avg);
+            store_pixel(cur + i, a, n);
+         }
+         return 1;
+      case F_paeth:
+         // 16-bit lanes: pa = |b-c|, pb = |a-c|, pc = |a+b-2c|, ties resolved a, b, c like paeth()
+         for (i=0; i < len; i += n) {
+            __m128i b = _mm_unpacklo_epi8(load_pixel(prior + i, n), zero);
+            __m128i aw = _mm_unpacklo_epi8(a, zero);
+            __m128i pa = _mm_sub_epi16(b, c);
+            __m128i pb = _mm_sub_epi16(aw, c);
+            __m128i pc = _mm_add_epi16(pa, pb);
+            __m128i smallest, use_a, use_b, nearest;
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            use_a = _mm_cmpeq_epi16(smallest, pa);
+            use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(smallest, pb));
+            nearest = _mm_or_si128(_mm_and_si128(use_a, aw), _mm_or_si128(_mm_and_si128(use_b, b), _mm_andnot_si128(_mm_or_si128(use_a, use_b), c)));
+            a = _mm_add_epi8(load_pixel(raw + i, n), _mm_packus_epi16(nearest, zero));
+            store_pixel(cur + i, a, n);
+            c = b;
+         }
+         return 1;
+   }
+   return 0;
+}
+#endif
+
+// SSE2 unfiltering only writes img_n components per pixel
+static int png_simd(int img_n, int out_n)
+{
+   #ifdef STBI_SSE2
+   return img_n == out_n && !settings()->no_simd && sse2_available();
+   #else
+   STBI_NOTUSED(img_n);
+   STBI_NOTUSED(out_n);
+   return 0;
+   #endif
+}
+
+// unfilter one scanline - raw starts with the filter byte, prior is the
+// row above and isn't read for the first row
+static int unfilter_png_row(uint8 *cur, uint8 *prior, uint8 *raw, int first_row, uint32 x, int img_n, int out_n, int simd)
+{
+   uint32 i;
+   int k;
+   int filter = *raw++;
+   if (filter > 4) return e("invalid filter","Corrupt PNG");
+   // if first row, use special filter that doesn't sample previous row
+   if (first_row) filter = first_row_filter[filter];
+   #ifdef STBI_SSE2
+   if (simd && filter != F_none && filter <= F_paeth && unfilter_row_sse2(filter, cur, prior, raw, x, img_n))
+      return 1;
+   #else
+   STBI_NOTUSED(simd);
+   #endif
+   // handle first pixel explicitly
+   for (k=0; k < img_n; ++k) {
+      switch (filter) {
+         case F_none       : cur[k] = raw[k]; break;
+         case F_sub        : cur[k] = raw[k]; break;
+         case F_up         : cur[k] = raw[k] + prior[k]; break;
+         case F_avg        : cur[k] = raw[k] + (prior[k]>>1); break;
+         case F_paeth      : cur[k] = (uint8) (raw[k] + paeth(0,prior[k],0)); break;
+         case F_avg_first  : cur[k] = raw[k]; break;
+         case F_paeth_first: cur[k] = raw[k]; break;
+      }
+   }
+   if (img_n != out_n) cur[img_n] = 255;
+   raw += img_n;
+   cur += out_n;
+   prior += out_n;
+   // this is a little gross, so that we don't switch per-pixel or per-component
+   if (img_n == out_n) {
+      #define CASE(f) \
+          case f:     \
+             for (i=x-1; i >= 1; --i, raw+=img_n,cur+=img_n,prior+=img_n) \
+                for (k=0; k < img_n; ++k)
+      switch (filter) {
+         CASE(F_none)  cur[k] = raw[k]; break;
+         CASE(F_sub)   cur[k] = raw[k] + cur[k-img_n]; break;
+         CASE(F_up)    cur[k] = raw[k] + prior[k]; break;
+         CASE(F_avg)   cur[k] = raw[k] + ((prior[k] + cur[k-img_n])>>1); break;
+         CASE(F_paeth)  cur[k] = (uint8) (raw[k] + paeth(cur[k-img_n],prior[k],prior[k-img_n])); break;
+         CASE(F_avg_first)    cur[k] = raw[k] + (cur[k-img_n] >> 1); break;
+         CASE(F_paeth_first)  cur[k] = (uint8) (raw[k] + paeth(cur[k-img_n],0,0)); break;
+      }
+      #undef CASE
+   } else {
+      assert(img_n+1 == out_n);
+      #define CASE(f) \
+          case f:     \
+             for (i=x-1; i >= 1; --i, cur[img_n]=255,raw+=img_n,cur+=out_n,prior+=out_n) \
+                for (k=0; k < img_n; ++k)
+      switch (filter) {
+         CASE(F_none)  cur[k] = raw[k]; break;
+         CASE(F_sub)   cur[k] = raw[k] + cur[k-out_n]; break;
+         CASE(F_up)    cur[k] = raw[k] + prior[k]; break;
+         CASE(F_avg)   cur[k] = raw[k] + ((prior[k] + cur[k-out_n])>>1); break;
+         CASE(F_paeth)  cur[k] = (uint8) (raw[k] + paeth(cur[k-out_n],prior[k],prior[k-out_n])); break;
+         CASE(F_avg_first)    cur[k] = raw[k] + (cur[k-out_n] >> 1); break;
+         CASE(F_paeth_first)  cur[k] = (uint8) (raw[k] + paeth(cur[k-out_n],0,0)); break;
+      }
+      #undef CASE
+   }
+   return 1;
+}
+
 // create the png data from post-deflated data
-static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, uint32 x, uint32 y)
+static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, uint32 x, uint32 y, int partial)
 {
    stbi *s = a->s;
-   uint32 i,j,stride = x*out_n;
-   int k;
+   uint32 j,stride = x*out_n;
    int img_n = s->img_n; // copy it into a local for later
+   int simd = png_simd(img_n, out_n);
    assert(out_n == s->img_n || out_n == s->img_n+1);
-   if (stbi_png_partial) y = 1;
+   if (partial) y = 1;
    a->out = (uint8 *) malloc(x * y * out_n);
    if (!a->out) return e("outofmem", "Out of memory");
-   if (!stbi_png_partial) {
+   if (!partial) {
       if (s->img_x == x && s->img_y == y) {
          if (raw_len != (img_n * x + 1) * y) return e("not enough pixels","Corrupt PNG");
       } else { // interlaced:
@@ -2192,60 +3379,8 @@ static int create_png_image_raw(png *a, uint8 *raw, uint32 raw_len, int out_n, u
    }
    for (j=0; j < y; ++j) {
       uint8 *cur = a->out + stride*j;
-      uint8 *prior = cur - stride;
-      int filter = *raw++;
-      if (filter > 4) return e("invalid filter","Corrupt PNG");
-      // if first row, use special filter that doesn't sample previous row
-      if (j == 0) filter = first_row_filter[filter];
-      // handle first pixel explicitly
-      for (k=0; k < img_n; ++k) {
-         switch (filter) {
-            case F_none       : cur[k] = raw[k]; break;
-            case F_sub        : cur[k] = raw[k]; break;
-            case F_up         : cur[k] = raw[k] + prior[k]; break;
-            case F_avg        : cur[k] = raw[k] + (prior[k]>>1); break;
-            case F_paeth      : cur[k] = (uint8) (raw[k] + paeth(0,prior[k],0)); break;
-            case F_avg_first  : cur[k] = raw[k]; break;
-            case F_paeth_first: cur[k] = raw[k]; break;
-         }
-      }
-      if (img_n != out_n) cur[img_n] = 255;
-      raw += img_n;
-      cur += out_n;
-      prior += out_n;
-      // this is a little gross, so that we don't switch per-pixel or per-component
-      if (img_n == out_n) {
-         #define CASE(f) \
-             case f:     \
-                for (i=x-1; i >= 1; --i, raw+=img_n,cur+=img_n,prior+=img_n) \
-                   for (k=0; k < img_n; ++k)
-         switch (filter) {
-            CASE(F_none)  cur[k] = raw[k]; break;
-            CASE(F_sub)   cur[k] = raw[k] + cur[k-img_n]; break;
-            CASE(F_up)    cur[k] = raw[k] + prior[k]; break;
-            CASE(F_avg)   cur[k] = raw[k] + ((prior[k] + cur[k-img_n])>>1); break;
-            CASE(F_paeth)  cur[k] = (uint8) (raw[k] + paeth(cur[k-img_n],prior[k],prior[k-img_n])); break;
-            CASE(F_avg_first)    cur[k] = raw[k] + (cur[k-img_n] >> 1); break;
-            CASE(F_paeth_first)  cur[k] = (uint8) (raw[k] + paeth(cur[k-img_n],0,0)); break;
-         }
-         #undef CASE
-      } else {
-         assert(img_n+1 == out_n);
-         #define CASE(f) \
-             case f:     \
-                for (i=x-1; i >= 1; --i, cur[img_n]=255,raw+=img_n,cur+=out_n,prior+=out_n) \
-                   for (k=0; k < img_n; ++k)
-         switch (filter) {
-            CASE(F_none)  cur[k] = raw[k]; break;
-            CASE(F_sub)   cur[k] = raw[k] + cur[k-out_n]; break;
-            CASE(F_up)    cur[k] = raw[k] + prior[k]; break;
-            CASE(F_avg)   cur[k] = raw[k] + ((prior[k] + cur[k-out_n])>>1); break;
-            CASE(F_paeth)  cur[k] = (uint8) (raw[k] + paeth(cur[k-out_n],prior[k],prior[k-out_n])); break;
-            CASE(F_avg_first)    cur[k] = raw[k] + (cur[k-out_n] >> 1); break;
-            CASE(F_paeth_first)  cur[k] = (uint8) (raw[k] + paeth(cur[k-out_n],0,0)); break;
-         }
-         #undef CASE
-      }
+      if (!unfilter_png_row(cur, j ? cur - stride : cur, raw, j == 0, x, img_n, out_n, simd)) return 0;
+      raw += img_n*x + 1;
    }
    return 1;
 }
@@ -2254,11 +3389,8 @@ static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n, int i
 {
    uint8 *final;
    int p;
-   int save;
    if (!interlaced)
-      return create_png_image_raw(a, raw, raw_len, out_n, a->s->img_x, a->s->img_y);
-   save = stbi_png_partial;
-   stbi_png_partial = 0;
+      return create_png_image_raw(a, raw, raw_len, out_n, a->s->img_x, a->s->img_y, stbi_png_partial);
 
    // de-interlacing
    final = (uint8 *) malloc(a->s->img_x * a->s->img_y * out_n);
@@ -2272,7 +3404,7 @@ static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n, int i
       x = (a->s->img_x - xorig[p] + xspc[p]-1) / xspc[p];
       y = (a->s->img_y - yorig[p] + yspc[p]-1) / yspc[p];
       if (x && y) {
-         if (!create_png_image_raw(a, raw, raw_len, out_n, x, y)) {
+         if (!create_png_image_raw(a, raw, raw_len, out_n, x, y, 0)) {
             free(final);
             return 0;
          }
@@ -2287,15 +3419,12 @@ static int create_png_image(png *a, uint8 *raw, uint32 raw_len, int out_n, int i
    }
    a->out = final;
 
-   stbi_png_partial = save;
    return 1;
 }
 
-static int compute_transparency(png *z, uint8 tc[3], int out_n)
+static int compute_transparency(uint8 *p, uint32 pixel_count, uint8 tc[3], int out_n)
 {
-   stbi *s = z->s;
-   uint32 i, pixel_count = s->img_x * s->img_y;
-   uint8 *p = z->out;
+   uint32 i;
 
    // compute color-based transparency, assuming we've
    // already got 255 as the alpha value in the output
@@ -2316,16 +3445,9 @@ static int compute_transparency(png *z, uint8 tc[3], int out_n)
    return 1;
 }
 
-static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n)
+static void apply_palette(uint8 *p, uint8 *orig, uint32 pixel_count, uint8 *palette, int pal_img_n)
 {
-   uint32 i, pixel_count = a->s->img_x * a->s->img_y;
-   uint8 *p, *temp_out, *orig = a->out;
-
-   p = (uint8 *) malloc(pixel_count * pal_img_n);
-   if (p == NULL) return e("outofmem", "Out of memory");
-
-   // between here and free(out) below, exitting would leak
-   temp_out = p;
+   uint32 i;
 
    if (pal_img_n == 3) {
       for (i=0; i < pixel_count; ++i) {
@@ -2345,33 +3467,37 @@ static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n)
          p += 4;
       }
    }
+}
+
+static int expand_palette(png *a, uint8 *palette, int len, int pal_img_n)
+{
+   uint32 pixel_count = a->s->img_x * a->s->img_y;
+   uint8 *p = (uint8 *) malloc(pixel_count * pal_img_n);
+   if (p == NULL) return e("outofmem", "Out of memory");
+
+   apply_palette(p, a->out, pixel_count, palette, pal_img_n);
    free(a->out);
-   a->out = temp_out;
+   a->out = p;
 
    STBI_NOTUSED(len);
 
    return 1;
 }
 
-static int stbi_unpremultiply_on_load = 0;
-static int stbi_de_iphone_flag = 0;
-
 void stbi_set_unpremultiply_on_load(int flag_true_if_should_unpremultiply)
 {
-   stbi_unpremultiply_on_load = flag_true_if_should_unpremultiply;
+   default_context.unpremultiply_on_load = flag_true_if_should_unpremultiply;
 }
 void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert)
 {
-   stbi_de_iphone_flag = flag_true_if_should_convert;
+   default_context.convert_iphone_png_to_rgb = flag_true_if_should_convert;
 }
 
-static void stbi_de_iphone(png *z)
+static void stbi_de_iphone(uint8 *p, uint32 pixel_count, int out_n)
 {
-   stbi *s = z->s;
-   uint32 i, pixel_count = s->img_x * s->img_y;
-   uint8 *p = z->out;
+   uint32 i;
 
-   if (s->img_out_n == 3) {  // convert bgr to rgb
+   if (out_n == 3) {  // convert bgr to rgb
       for (i=0; i < pixel_count; ++i) {
          uint8 t = p[0];
          p[0] = p[2];
@@ -2379,8 +3505,8 @@ static void stbi_de_iphone(png *z)
          p += 3;
       }
    } else {
-      assert(s->img_out_n == 4);
-      if (stbi_unpremultiply_on_load) {
+      assert(out_n == 4);
+      if (settings()->unpremultiply_on_load) {
          // convert bgr to rgb and unpremultiply
          for (i=0; i < pixel_count; ++i) {
             uint8 a = p[3];
@@ -2407,6 +3533,92 @@ static void stbi_de_iphone(png *z)
    }
 }
 
+// streamed png: scanlines are unfiltered and converted as they're inflated
+typedef struct
+{
+   png *z;
+   uint8 *palette, *tc;
+   int pal_img_n, has_trans, iphone, simd;
+   int out_n;         // components after unfiltering (with tRNS alpha)
+   int row_n;         // components after the palette is applied
+   uint8 *cur, *prior, *tmp, *pal_row;
+   uint32 row;        // next scanline
+} png_stream;
+
+static int png_consume(void *user, uint8 *data, int len)
+{
+   png_stream *ps = (png_stream *) user;
+   stbi *s = ps->z->s;
+   stbi_rows *r = ps->z->rows;
+   uint32 x = s->img_x;
+   int raw_row = x * s->img_n + 1, used = 0;
+
+   for (; len - used >= raw_row; used += raw_row, ++ps->row) {
+      uint8 *row = ps->cur, *t;
+      if (ps->row == s->img_y) break;
+      if (!unfilter_png_row(ps->cur, ps->prior, data + used, ps->row == 0, x, s->img_n, ps->out_n, ps->simd))
+         return -1;
+      // cur is the next row's prior, so fix-ups work on a copy
+      if (ps->has_trans || ps->iphone) {
+         memcpy(ps->tmp, ps->cur, x * ps->out_n);
+         row = ps->tmp;
+         if (ps->has_trans && !compute_transparency(row, x, ps->tc, ps->out_n)) return -1;
+         if (ps->iphone) stbi_de_iphone(row, x, ps->out_n);
+      }
+      if (ps->pal_img_n) {
+         apply_palette(ps->pal_row, row, x, ps->palette, ps->row_n);
+         row = ps->pal_row;
+      }
+      convert_row(rows_next(r), row, ps->row_n, r->comp, x);
+      if (!rows_commit(r)) return -1;
+      t = ps->cur; ps->cur = ps->prior; ps->prior = t;
+   }
+
+   if (ps->row == s->img_y && used < len) {
+      e("too much data", "Corrupt PNG");
+      return -1;
+   }
+   return used;
+}
+
+static int png_stream_rows(png *z, uint32 ioff, int parse_header, int req_comp, uint8 *palette, int pal_img_n, int has_trans, uint8 tc[3], int iphone)
+{
+   stbi *s = z->s;
+   png_stream ps;
+   uint8 *buffers;
+   uint32 x = s->img_x;
+   int result, comp;
+
+   ps.z = z;
+   ps.palette = palette;
+   ps.tc = tc;
+   ps.pal_img_n = pal_img_n;
+   ps.has_trans = has_trans;
+   ps.iphone = iphone && s->img_out_n > 2;
+   ps.out_n = s->img_out_n;
+   ps.row_n = pal_img_n ? (req_comp >= 3 ? req_comp : pal_img_n) : s->img_out_n;
+   ps.simd = png_simd(s->img_n, ps.out_n);
+   ps.row = 0;
+   comp = req_comp ? req_comp : ps.row_n;
+
+   buffers = (uint8 *) malloc(x * (3*ps.out_n + 4));
+   if (buffers == NULL) return e("outofmem", "Out of memory");
+   ps.cur     = buffers;
+   ps.prior   = ps.cur   + x * ps.out_n;
+   ps.tmp     = ps.prior + x * ps.out_n;
+   ps.pal_row = ps.tmp   + x * ps.out_n;
+
+   result = rows_begin(z->rows, x, s->img_y, comp) &&
+            zlib_decode_stream((char *) z->idata, ioff, parse_header, 4*65536 + x*s->img_n+1, png_consume, &ps);
+   if (result && ps.row != s->img_y)
+      result = e("not enough pixels","Corrupt PNG");
+   free(buffers);
+
+   if (pal_img_n) s->img_n = pal_img_n;  // record the actual colors we had
+   s->img_out_n = comp;
+   return result;
+}
+
 static int parse_png_file(png *z, int scan, int req_comp)
 {
    uint8 palette[1024], pal_img_n=0;
@@ -2427,7 +3639,7 @@ static int parse_png_file(png *z, int scan, int req_comp)
       chunk c = get_chunk_header(s);
       switch (c.type) {
          case PNG_TYPE('C','g','B','I'):
-            iphone = stbi_de_iphone_flag;
+            iphone = settings()->convert_iphone_png_to_rgb;
             skip(s, c.length);
             break;
          case PNG_TYPE('I','H','D','R'): {
@@ -2514,18 +3726,25 @@ static int parse_png_file(png *z, int scan, int req_comp)
             if (first) return e("first not IHDR", "Corrupt PNG");
             if (scan != SCAN_load) return 1;
             if (z->idata == NULL) return e("no IDAT","Corrupt PNG");
-            z->expanded = (uint8 *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, 16384, (int *) &raw_len, !iphone);
-            if (z->expanded == NULL) return 0; // zlib should set error
-            free(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
+            // interlaced passes only make up the image together, so those are decoded in full
+            if (z->rows && !interlace) {
+               if (!png_stream_rows(z, ioff, !iphone, req_comp, palette, pal_img_n, has_trans, tc, iphone)) return 0;
+               free(z->idata); z->idata = NULL;
+               return 1;
+            }
+            // size of a non-interlaced image, so the output buffer doesn't have to grow while inflating
+            z->expanded = (uint8 *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, (s->img_x*s->img_n+1)*s->img_y, (int *) &raw_len, !iphone);
+            if (z->expanded == NULL) return 0; // zlib should set error
+            free(z->idata); z->idata = NULL;
             if (!create_png_image(z, z->expanded, raw_len, s->img_out_n, interlace)) return 0;
             if (has_trans)
-               if (!compute_transparency(z, tc, s->img_out_n)) return 0;
+               if (!compute_transparency(z->out, s->img_x * s->img_y, tc, s->img_out_n)) return 0;
             if (iphone && s->img_out_n > 2)
-               stbi_de_iphone(z);
+               stbi_de_iphone(z->out, s->img_x * s->img_y, s->img_out_n);
             if (pal_img_n) {
                // pal_img_n == 3 or 4
                s->img_n = pal_img_n; // record the actual colors we had
@@ -2541,17 +3760,9 @@ static int parse_png_file(png *z, int scan, int req_comp)
          default:
             // if critical, fail
             if (first) return e("first not IHDR", "Corrupt PNG");
-            if ((c.type & (1 << 29)) == 0) {
-               #ifndef STBI_NO_FAILURE_STRINGS
-               // not threadsafe
-               static char invalid_chunk[] = "XXXX chunk not known";
-               invalid_chunk[0] = (uint8) (c.type >> 24);
-               invalid_chunk[1] = (uint8) (c.type >> 16);
-               invalid_chunk[2] = (uint8) (c.type >>  8);
-               invalid_chunk[3] = (uint8) (c.type >>  0);
-               #endif
-               return e(invalid_chunk, "PNG not supported: unknown chunk type");
-            }
+            if ((c.type & (1 << 29)) == 0)
+               // constant string - failure reasons may be read on other threads
+               return e("unknown critical chunk", "PNG not supported: unknown chunk type");
             skip(s, c.length);
             break;
       }
@@ -2587,9 +3798,41 @@ static unsigned char *stbi_png_load(stbi *s, int *x, int *y, int *comp, int req_
 {
    png p;
    p.s = s;
+   p.rows = NULL;
    return do_png(&p, x,y,comp,req_comp);
 }
 
+static int stbi_png_load_rows(stbi *s, stbi_rows *r, int req_comp, int *x, int *y, int *comp)
+{
+   png p;
+   int result = 0;
+   p.s = s;
+   p.rows = r;
+   if (parse_png_file(&p, SCAN_load, req_comp)) {
+      result = 1;
+      if (p.out) {
+         // interlaced, decoded in full
+         unsigned char *data = p.out;
+         p.out = NULL;
+         if (req_comp && req_comp != s->img_out_n) {
+            data = convert_format(data, s->img_out_n, req_comp, s->img_x, s->img_y);
+            s->img_out_n = req_comp;
+         }
+         result = data != NULL && rows_from_image(r, data, s->img_x, s->img_y, s->img_out_n);
+         free(data);
+      }
+      if (result) {
+         *x = s->img_x;
+         *y = s->img_y;
+         if (comp) *comp = s->img_n;
+      }
+   }
+   free(p.out);
+   free(p.expanded);
+   free(p.idata);
+   return result;
+}
+
 static int stbi_png_test(stbi *s)
 {
    int r;
@@ -2614,6 +3857,7 @@ static int      stbi_png_info(stbi *s, int *x, int *y, int *comp)
 {
    png p;
    p.s = s;
+   p.rows = NULL;
    return stbi_png_info_raw(&p, x, y, comp);
 }
 
@@ -3645,7 +4889,7 @@ static int stbi_gif_header(stbi *s, stbi_gif *g, int *comp, int is_info)
    if (version != '7' && version != '9')    return e("not GIF", "Corrupt GIF");
    if (get8(s) != 'a')                      return e("not GIF", "Corrupt GIF");
  
-   failure_reason = "";
+   set_failure("");
    g->w = get16le(s);
    g->h = get16le(s);
    g->flags = get8(s);
@@ -59,6 +59,24 @@
 //
 // ===========================================================================
 //
+// Thread safety:
+//
+// Images can be decoded on several threads at once. Each load runs with an
+// stbi_context holding the settings below and the failure reason of that
+// load; the plain entry points use a copy of the global settings and keep
+// the failure reason per thread. To decode with your own settings:
+//
+//    stbi_context ctx;
+//    stbi_context_init(&ctx);   // copy of the global settings
+//    ctx.hdr_to_ldr_gamma = 1.0f;
+//    data = stbi_load_ctx(&ctx, filename, &x, &y, &n, 0);
+//    if (!data) puts(ctx.failure_reason);
+//
+// The global setters (stbi_hdr_to_ldr_gamma etc.) must not be called while
+// other threads are decoding.
+//
+// ===========================================================================
+//
 // iPhone PNG support:
 //
 // By default we convert iphone-formatted PNGs back to RGB; nominally they
@@ -149,6 +167,21 @@ extern "C" {
 // PRIMARY API - works on images of any type
 //
 
+// per-load settings and error state, see "Thread safety" above
+typedef struct
+{
+   const char *failure_reason;      // set when a load returns NULL
+   float hdr_to_ldr_gamma;
+   float hdr_to_ldr_scale;
+   float ldr_to_hdr_gamma;
+   float ldr_to_hdr_scale;
+   int   unpremultiply_on_load;
+   int   convert_iphone_png_to_rgb;
+   int   no_simd;                   // decode with the scalar JPEG and PNG kernels (for comparisons)
+} stbi_context;
+
+extern void stbi_context_init(stbi_context *ctx);
+
 //
 // load image by filename, open file, or memory buffer
 //
@@ -170,6 +203,65 @@ typedef struct
 
 extern stbi_uc *stbi_load_from_callbacks  (stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp);
 
+// same as above, with settings and failure reason in 'ctx'
+extern stbi_uc *stbi_load_from_memory_ctx    (stbi_context *ctx, stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
+extern stbi_uc *stbi_load_from_callbacks_ctx (stbi_context *ctx, stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp);
+#ifndef STBI_NO_STDIO
+extern stbi_uc *stbi_load_ctx                (stbi_context *ctx, char const *filename, int *x, int *y, int *comp, int req_comp);
+extern stbi_uc *stbi_load_from_file_ctx      (stbi_context *ctx, FILE *f,              int *x, int *y, int *comp, int req_comp);
+#endif
+
+// decode into a caller buffer (e.g. a mapped pixel buffer or file) instead of
+// a malloc'd one. Get the size with stbi_info and stbi_layout_stride first:
+//
+//    stbi_layout layout = { 4, 4, 0 };   // rgba, 4 byte aligned rows
+//    stbi_info(filename, &x, &y, &n);
+//    size = stbi_layout_stride(&layout, x) * y;
+//    ok = stbi_load_into_ctx(&ctx, filename, dest, size, &layout, &x, &y, &n);
+//
+// The buffer is only written, front to back, so write-combined memory is fine;
+// row padding is not meaningful. 8-bit sRGB data is returned as stored, and
+// premultiplying works on the stored values. Returns 1 on success, 0 on
+// failure (reason in ctx->failure_reason).
+typedef struct
+{
+   int comp;                // 1..4 components per pixel, converted like req_comp
+   int row_alignment;       // rows start at multiples of 1, 2, 4 or 8 bytes (like GL_UNPACK_ALIGNMENT), 0 = packed
+   int premultiply_alpha;   // multiply color by alpha when comp is 2 or 4
+} stbi_layout;
+
+extern int stbi_layout_stride(stbi_layout const *layout, int x);   // bytes per row
+
+extern int stbi_load_from_memory_into_ctx    (stbi_context *ctx, stbi_uc const *buffer, int len, stbi_uc *dest, int dest_size, stbi_layout const *layout, int *x, int *y, int *comp);
+extern int stbi_load_from_callbacks_into_ctx (stbi_context *ctx, stbi_io_callbacks const *clbk, void *user, stbi_uc *dest, int dest_size, stbi_layout const *layout, int *x, int *y, int *comp);
+#ifndef STBI_NO_STDIO
+extern int stbi_load_into_ctx                (stbi_context *ctx, char const *filename, stbi_uc *dest, int dest_size, stbi_layout const *layout, int *x, int *y, int *comp);
+extern int stbi_load_from_file_into_ctx      (stbi_context *ctx, FILE *f,              stbi_uc *dest, int dest_size, stbi_layout const *layout, int *x, int *y, int *comp);
+#endif
+
+// decode in strips of rows, top to bottom, so they can be used (uploaded,
+// written out) while the rest of the image is still being decoded. 'rows' holds
+// num_rows packed rows of x*comp bytes starting at image row first_row and is
+// only valid during the call; return 0 to stop decoding. comp is req_comp, or
+// the image components if req_comp is 0 (*comp gets the image components like
+// stbi_load). Strips are at most STBI_ROW_STRIP_BYTES unless a single row is
+// larger.
+//
+// Memory: non-interlaced PNG keeps only the compressed data, a 32k inflate
+// window and two scanlines; JPEG keeps its component planes (baseline JPEG has
+// to be fully entropy decoded before the first row comes out) but never the
+// full output image; interlaced PNG and the other formats are decoded in full
+// and then passed on in strips. Returns 1 on success, 0 on failure or when
+// stopped (reason in ctx->failure_reason).
+typedef int (*stbi_row_callback)(void *user, stbi_uc const *rows, int first_row, int num_rows, int x, int y, int comp);
+
+extern int stbi_load_from_memory_rows_ctx    (stbi_context *ctx, stbi_uc const *buffer, int len, int req_comp, stbi_row_callback callback, void *user, int *x, int *y, int *comp);
+extern int stbi_load_from_callbacks_rows_ctx (stbi_context *ctx, stbi_io_callbacks const *clbk, void *user, int req_comp, stbi_row_callback callback, void *callback_user, int *x, int *y, int *comp);
+#ifndef STBI_NO_STDIO
+extern int stbi_load_rows_ctx                (stbi_context *ctx, char const *filename, int req_comp, stbi_row_callback callback, void *user, int *x, int *y, int *comp);
+extern int stbi_load_from_file_rows_ctx      (stbi_context *ctx, FILE *f,              int req_comp, stbi_row_callback callback, void *user, int *x, int *y, int *comp);
+#endif
+
 #ifndef STBI_NO_HDR
    extern float *stbi_loadf_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
 
@@ -180,6 +272,13 @@ extern stbi_uc *stbi_load_from_callbacks  (stbi_io_callbacks const *clbk, void *
    
    extern float *stbi_loadf_from_callbacks  (stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp);
 
+   extern float *stbi_loadf_from_memory_ctx    (stbi_context *ctx, stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
+   extern float *stbi_loadf_from_callbacks_ctx (stbi_context *ctx, stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp);
+   #ifndef STBI_NO_STDIO
+   extern float *stbi_loadf_ctx                (stbi_context *ctx, char const *filename, int *x, int *y, int *comp, int req_comp);
+   extern float *stbi_loadf_from_file_ctx      (stbi_context *ctx, FILE *f,              int *x, int *y, int *comp, int req_comp);
+   #endif
+
    extern void   stbi_hdr_to_ldr_gamma(float gamma);
    extern void   stbi_hdr_to_ldr_scale(float scale);
 
@@ -196,8 +295,7 @@ extern int      stbi_is_hdr_from_file(FILE *f);
 #endif // STBI_NO_STDIO
 
 
-// get a VERY brief reason for failure
-// NOT THREADSAFE
+// get a VERY brief reason for failure of the last plain (non _ctx) call on this thread
 extern const char *stbi_failure_reason  (void); 
 
 // free the loaded image -- this is just free()
@@ -0,0 +1,44 @@
+# Packs common_res shaders (*.vsh, *.fsh, *.gsh) into common_src/renderer/ShaderBundle.cpp.
+# Runs as a pre-build step (see PropertySheet.props) - output is only rewritten when shaders change.
+$ErrorActionPreference = "Stop"
+
+$resDir  = $PSScriptRoot
+$outFile = Join-Path $PSScriptRoot "..\common_src\renderer\ShaderBundle.cpp"
+
+# ordinal sort - ShaderManager looks shaders up with binary search (strcmp)
+$names = @(Get-ChildItem -Path $resDir -File | Where-Object { @(".vsh", ".fsh", ".gsh") -contains $_.Extension } | ForEach-Object { $_.Name })
+[Array]::Sort($names, [StringComparer]::Ordinal)
+
+$data  = New-Object Text.StringBuilder
+$table = New-Object Text.StringBuilder
+
+foreach ($name in $names)
+{
+    $text = [IO.File]::ReadAllText((Join-Path $resDir $name)) -replace "`r", ""
+    $var  = "shader_" + ($name -replace "[^A-Za-z0-9]", "_")
+
+    # MSVC limits a single string literal to ~16KB
+    if ($text.Length -gt 16000) { throw "$name is too large to embed" }
+    if ($text.Contains(')shader"')) { throw "$name contains raw string delimiter" }
+
+    [void]$data.Append("static const char $var[] = R`"shader($text)shader`";`n`n")
+    [void]$table.Append("    { `"$name`", $var, sizeof($var) - 1 },`n")
+}
+
+$out = "// generated by common_res/pack_shaders.ps1 - do not edit`n" +
+       "#include `"renderer/ShaderBundle.hpp`"`n`n" +
+       $data.ToString() +
+       "// sorted by name`n" +
+       "const BundledShader shaderBundle[] = {`n" +
+       $table.ToString() +
+       "};`n`n" +
+       "const size_t shaderBundleCount = sizeof(shaderBundle) / sizeof(shaderBundle[0]);`n"
+
+# keep timestamp (and avoid recompiling) when nothing changed
+if ((Test-Path $outFile) -and ([IO.File]::ReadAllText($outFile) -ceq $out))
+{
+    exit 0
+}
+
+[IO.File]::WriteAllText($outFile, $out, (New-Object Text.UTF8Encoding $false))
+Write-Host "Packed $($names.Count) shaders into $outFile"
@@ -30,7 +30,7 @@ Font::Font(const char *tex) : m_scale(1.f, 1.f), m_position(0.0f, 0.0f, 0.0f), m
     glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
 
     const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::FontShader);
-    m_vertexPosAttr = glGetAttribLocation(shader.id, "inVertex");
+    m_vertexPosAttr = shader.GetAttribLocation(SHADER_VAR("inVertex"));
 
     glEnableVertexAttribArray(m_vertexPosAttr);
     glVertexAttribPointer(m_vertexPosAttr, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
@@ -39,11 +39,14 @@ Font::Font(const char *tex) : m_scale(1.f, 1.f), m_position(0.0f, 0.0f, 0.0f), m
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    m_texture = TextureManager::GetInstance()->LoadTexture(tex);
+    // glyphs share an atlas page with other UI textures, so text and icons can be drawn without rebinding
+    if (!TextureManager::GetInstance()->GetAtlas().Insert(tex, &m_region))
+        memset(&m_region, 0, sizeof(m_region));
 
-    // disable l. filter for this texture (it's bound in Load())
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    // disable l. filter for glyphs only
+    glGenSamplers(1, &m_sampler);
+    glSamplerParameteri(m_sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glSamplerParameteri(m_sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 }
 
 Font::~Font()
@@ -56,13 +59,17 @@ Font::~Font()
 
     glDisableVertexAttribArray(m_vertexPosAttr);
 
+    if (glIsSampler(m_sampler))
+        glDeleteSamplers(1, &m_sampler);
+
     if (glIsVertexArray(m_fontVertexArray))
         glDeleteVertexArrays(1, &m_fontVertexArray);
 }
 
 void Font::renderAt(const Math::Vector3f &pos, int w, int h, int uo, int vo, const Math::Vector4f &color)
 {
-    LOG_MESSAGE_ASSERT(m_texture != NULL, "Trying to render with no texture?");
+    const Texture *page = TextureManager::GetInstance()->GetTexture(m_region.page);
+    LOG_MESSAGE_ASSERT(page != NULL, "Trying to render with no texture?");
 
     Math::Matrix4f texMatrix, mvMatrix;
 
@@ -70,16 +77,14 @@ void Font::renderAt(const Math::Vector3f &pos, int w, int h, int uo, int vo, con
     Math::Scale(mvMatrix, 2.f * w / g_renderContext.height, 2.f * h / g_renderContext.height);
     Math::Scale(mvMatrix, m_scale.m_x, m_scale.m_y);
 
-    Math::Scale(texMatrix, 1.f / m_texture->Width(), -1.f / m_texture->Height());
-    Math::Translate(texMatrix, (float)uo, (float)-vo);
+    Math::Scale(texMatrix, 1.f / page->Width(), -1.f / page->Height());
+    Math::Translate(texMatrix, (float)(m_region.x + uo), (float)-(m_region.y + vo));
     Math::Scale(texMatrix, (float)w, (float)h);
 
-    Math::Matrix4f MVP = g_cameraDirector.GetActiveCamera()->ProjectionMatrix() * mvMatrix;
-
-    // update matrices
+    // update matrices (projection is shared by all glyphs through overlay view constants)
     const ShaderProgram &shader = ShaderManager::GetInstance()->GetActiveShader();
     glUniformMatrix4fv(shader.uniforms[TextureMatrix], 1, GL_FALSE, &texMatrix[0]);
-    glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &MVP[0]);
+    glUniformMatrix4fv(shader.uniforms[ModelMatrix], 1, GL_FALSE, &mvMatrix[0]);
     glUniform4fv(shader.uniforms[VertexColor], 1, &color.m_x);
 
     glBindVertexArray(m_fontVertexArray);
@@ -111,8 +116,13 @@ void Font::drawText(const std::string &text, const Math::Vector3f &position, con
     Camera::CameraMode camMode = g_cameraDirector.GetActiveCamera()->GetMode();
     g_cameraDirector.GetActiveCamera()->SetMode(Camera::CAM_ORTHO);
 
-    TextureManager::GetInstance()->BindTexture(m_texture);
+    // text is drawn in screen space - switch to overlay view and restore eye view afterwards
+    int eyeView = ShaderManager::GetInstance()->GetBoundView();
+    ShaderManager::GetInstance()->UpdateOverlayConstants(&g_cameraDirector.GetActiveCamera()->ProjectionMatrix()[0]);
+
+    TextureManager::GetInstance()->BindTexture(m_region.page);
     ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::FontShader);
+    glBindSampler(0, m_sampler);
 
     Math::Vector3f pos = position;
 
@@ -128,6 +138,11 @@ void Font::drawText(const std::string &text, const Math::Vector3f &position, con
         pos.m_x += m_scale.m_x * (CHAR_SPACING / g_renderContext.scrRatio) * CHAR_WIDTH / g_renderContext.height;
     }
 
+    glBindSampler(0, 0);
+
+    if (eyeView >= 0)
+        ShaderManager::GetInstance()->BindViewConstants(eyeView);
+
     g_cameraDirector.GetActiveCamera()->SetMode(camMode);
 
     glDisable(GL_BLEND);
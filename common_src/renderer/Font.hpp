@@ -2,10 +2,9 @@
 #define FONT_HPP
 
 #include "renderer/OpenGL.hpp"
+#include "renderer/TextureAtlas.hpp"
 #include <string>
 
-class Texture;
-
 class Font
 {
 public:
@@ -20,7 +19,7 @@ public:
     void drawText(const std::string &text, float x, float y, float z=-1.0f);
 private:
     void renderAt(const Math::Vector3f &pos, int w, int h, int uo, int vo, const Math::Vector4f &color);
-    Texture*        m_texture;
+    AtlasRegion     m_region;    // font sheet in the shared UI atlas
     Math::Vector2f  m_scale;
     Math::Vector3f  m_position;
     Math::Vector4f  m_color;
@@ -32,6 +31,7 @@ private:
     GLuint m_indexBuffer;     // IBO
 
     GLuint m_vertexPosAttr;   // attribute location
+    GLuint m_sampler;         // nearest filtering without changing the shared atlas page
 };
 
 #endif
\ No newline at end of file
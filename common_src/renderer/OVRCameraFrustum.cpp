@@ -123,7 +123,7 @@ void OVRCameraFrustum::Recalculate(ovrSession session)
 void OVRCameraFrustum::OnRender()
 {
     const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::OVRFrustumShader);
-    GLuint vertexPositionAttr = glGetAttribLocation(shader.id, "inVertex");
+    GLuint vertexPositionAttr = shader.GetAttribLocation(SHADER_VAR("inVertex"));
 
     const float frustumColor[4] = { 0.67f, 0.27f, 0.05f, 1.f };
     const float planeColor[4] = { 1.f, 0.f, 0.f, 1.f };
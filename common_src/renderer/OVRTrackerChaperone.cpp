@@ -153,7 +153,7 @@ void OVRTrackerChaperone::Recalculate(ovrSession session, const OVR::Vector3f &h
 void OVRTrackerChaperone::OnRender()
 {
     const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::OVRFrustumShader);
-    GLuint vertexPositionAttr = glGetAttribLocation(shader.id, "inVertex");
+    GLuint vertexPositionAttr = shader.GetAttribLocation(SHADER_VAR("inVertex"));
 
     glDisable(GL_DEPTH_TEST);
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
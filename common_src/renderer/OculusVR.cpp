@@ -1,6 +1,27 @@
 #include "renderer/OculusVR.hpp"
 #include "renderer/ShaderManager.hpp"
 
+// number of GPU timer samples averaged per eye before logging
+static const int GPU_TIMER_FRAMES = 300;
+
+// ViewConstants slot used by far-field pass (eyes use their own index)
+static const int FAR_FIELD_VIEW = ovrEye_Count;
+
+// fill shared ViewConstants block of given view slot
+static void UpdateViewConstants(int view, const OVR::Matrix4f &projection, const OVR::Matrix4f &viewMatrix, const OVR::Vector3f &eyePos)
+{
+    ViewConstants constants;
+    memcpy(constants.viewProjectionMatrix, &(projection * viewMatrix).Transposed().M[0][0], sizeof(constants.viewProjectionMatrix));
+    memcpy(constants.viewMatrix, &viewMatrix.Transposed().M[0][0], sizeof(constants.viewMatrix));
+    memcpy(constants.projectionMatrix, &projection.Transposed().M[0][0], sizeof(constants.projectionMatrix));
+
+    constants.eyePosition[0] = eyePos.x;
+    constants.eyePosition[1] = eyePos.y;
+    constants.eyePosition[2] = eyePos.z;
+    constants.eyePosition[3] = 1.f;
+
+    ShaderManager::GetInstance()->UpdateViewConstants(view, constants);
+}
 
 OculusVR::OVRBuffer::OVRBuffer(const ovrSession &session, int eyeIdx)
 {
@@ -49,6 +70,8 @@ OculusVR::OVRBuffer::OVRBuffer(const ovrSession &session, int eyeIdx)
     // MSAA color texture and fbo setup
     // simply comment this line out to skip MSAA altogether
     SetupMSAA();
+
+    SetupRadialMask(hmdDesc.DefaultEyeFov[eyeIdx]);
 }
 
 void OculusVR::OVRBuffer::SetupMSAA()
@@ -139,6 +162,147 @@ void OculusVR::OVRBuffer::OnRenderFinish()
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
 }
 
+void OculusVR::OVRBuffer::SetupRadialMask(const ovrFovPort &fov)
+{
+    // mask is centered on the projection center, which is off-center for asymmetric eye FOV
+    float centerX = (fov.LeftTan - fov.RightTan) / (fov.LeftTan + fov.RightTan);
+    float centerY = (fov.DownTan - fov.UpTan) / (fov.UpTan + fov.DownTan);
+    m_maskCenter[0] = (centerX + 1.f) * 0.5f * m_eyeTextureSize.w;
+    m_maskCenter[1] = (centerY + 1.f) * 0.5f * m_eyeTextureSize.h;
+
+    glGenVertexArrays(1, &m_maskVertexArray);
+    glGenFramebuffers(1, &m_maskFbo);
+
+    // same format as the swap chain texture, so the copy is a plain blit
+    glGenTextures(1, &m_maskTexture);
+    glBindTexture(GL_TEXTURE_2D, m_maskTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, m_eyeTextureSize.w, m_eyeTextureSize.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glGenQueries(1, &m_gpuTimerQuery);
+}
+
+void OculusVR::OVRBuffer::RenderRadialMask()
+{
+    // fill masked pixels with near plane depth, so that scene fragments fail early depth test there
+    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::RadialMaskShader);
+    glUniform4f(shader.uniforms[RadialMask], m_maskCenter[0], m_maskCenter[1],
+                1.f / (m_maskRadius * 0.5f * m_eyeTextureSize.w), 1.f / (m_maskRadius * 0.5f * m_eyeTextureSize.h));
+
+    // save state touched below - scene pass keeps whatever depth/color setup it had before the mask
+    GLint     prevDepthFunc;
+    GLboolean prevColorMask[4], prevDepthMask;
+    GLboolean depthOn = glIsEnabled(GL_DEPTH_TEST);
+    glGetIntegerv(GL_DEPTH_FUNC, &prevDepthFunc);
+    glGetBooleanv(GL_COLOR_WRITEMASK, prevColorMask);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &prevDepthMask);
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+
+    glBindVertexArray(m_maskVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glDepthFunc(prevDepthFunc);
+    glDepthMask(prevDepthMask);
+    glColorMask(prevColorMask[0], prevColorMask[1], prevColorMask[2], prevColorMask[3]);
+
+    if (!depthOn)
+        glDisable(GL_DEPTH_TEST);
+}
+
+void OculusVR::OVRBuffer::ReconstructRadialMask()
+{
+    // copy eye texture, so masked pixels can be filled in from their shaded neighbours
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_eyeFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_eyeTexId, 0);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_maskFbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_maskTexture, 0);
+
+    LOG_MESSAGE_ASSERT((glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE), "Could not complete framebuffer operation");
+
+    glBlitFramebuffer(0, 0, m_eyeTextureSize.w, m_eyeTextureSize.h,
+                      0, 0, m_eyeTextureSize.w, m_eyeTextureSize.h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_eyeFbo);
+    glViewport(0, 0, m_eyeTextureSize.w, m_eyeTextureSize.h);
+
+    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::RadialReconstructShader);
+    glUniform4f(shader.uniforms[RadialMask], m_maskCenter[0], m_maskCenter[1],
+                1.f / (m_maskRadius * 0.5f * m_eyeTextureSize.w), 1.f / (m_maskRadius * 0.5f * m_eyeTextureSize.h));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_maskTexture);
+
+    // texelFetch decodes sRGB, so encode the result back on write
+    GLboolean depthOn = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_FRAMEBUFFER_SRGB);
+
+    glBindVertexArray(m_maskVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    if (depthOn)
+        glEnable(GL_DEPTH_TEST);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OculusVR::OVRBuffer::BeginGpuTimer()
+{
+    if (m_gpuTimerFrames > 0 && !m_gpuTimerPending)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, m_gpuTimerQuery);
+        m_gpuTimerActive = true;
+    }
+}
+
+void OculusVR::OVRBuffer::EndGpuTimer()
+{
+    if (m_gpuTimerActive)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_gpuTimerActive  = false;
+        m_gpuTimerPending = true;
+    }
+}
+
+void OculusVR::OVRBuffer::UpdateGpuTimer(int eyeIdx)
+{
+    if (!m_gpuTimerPending)
+        return;
+
+    // don't stall waiting for the GPU - try again next frame
+    GLint available = 0;
+    glGetQueryObjectiv(m_gpuTimerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (!available)
+        return;
+
+    GLuint64 elapsedNs = 0;
+    glGetQueryObjectui64v(m_gpuTimerQuery, GL_QUERY_RESULT, &elapsedNs);
+    m_gpuTimerPending = false;
+    m_gpuTime += elapsedNs * 1e-6;
+
+    if (--m_gpuTimerFrames == 0)
+    {
+        LOG_MESSAGE("[RadialMask] " << (eyeIdx == ovrEye_Left ? "Left" : "Right") << " eye (" << (m_maskEnabled ? "masked" : "unmasked")
+                    << "): " << m_gpuTime / GPU_TIMER_FRAMES << " ms GPU");
+        m_gpuTime = 0.0;
+    }
+}
+
 void OculusVR::OVRBuffer::Destroy(const ovrSession &session)
 {
     if (glIsFramebuffer(m_eyeFbo))
@@ -156,9 +320,308 @@ void OculusVR::OVRBuffer::Destroy(const ovrSession &session)
     if (glIsTexture(m_depthTexMSAA))
         glDeleteTextures(1, &m_depthTexMSAA);
 
+    if (glIsVertexArray(m_maskVertexArray))
+        glDeleteVertexArrays(1, &m_maskVertexArray);
+
+    if (glIsFramebuffer(m_maskFbo))
+        glDeleteFramebuffers(1, &m_maskFbo);
+
+    if (glIsTexture(m_maskTexture))
+        glDeleteTextures(1, &m_maskTexture);
+
+    if (glIsQuery(m_gpuTimerQuery))
+        glDeleteQueries(1, &m_gpuTimerQuery);
+
     ovr_DestroyTextureSwapChain(session, m_swapTextureChain);
 }
 
+OculusVR::FarFieldBuffer::FarFieldBuffer(const ovrSession &session, const ovrFovPort &fov)
+{
+    m_textureSize = ovr_GetFovTextureSize(session, ovrEye_Left, fov, 1.0f);
+
+    glGenFramebuffers(1, &m_fbo);
+    glGenVertexArrays(1, &m_vertexArray);
+
+    // linear color format - composite pass copies the data without any conversion
+    glGenTextures(1, &m_colorTex);
+    glBindTexture(GL_TEXTURE_2D, m_colorTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_textureSize.w, m_textureSize.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glGenTextures(1, &m_depthBuffer);
+    glBindTexture(GL_TEXTURE_2D, m_depthBuffer);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_textureSize.w, m_textureSize.h, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTex, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthBuffer, 0);
+
+    LOG_MESSAGE_ASSERT((glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE), "Could not create far-field framebuffer");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OculusVR::FarFieldBuffer::OnRender()
+{
+    // Switch to far-field render target
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, m_textureSize.w, m_textureSize.h);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void OculusVR::FarFieldBuffer::Composite(const OVR::Matrix4f &eyeToFarField)
+{
+    // far-field image becomes the background of currently bound eye buffer - no depth is written,
+    // so near-field geometry is drawn on top of it
+    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::FarFieldShader);
+    glUniformMatrix4fv(shader.uniforms[TextureMatrix], 1, GL_FALSE, &eyeToFarField.Transposed().M[0][0]);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_colorTex);
+
+    GLboolean depthOn = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+
+    glBindVertexArray(m_vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glDepthMask(GL_TRUE);
+    if (depthOn)
+        glEnable(GL_DEPTH_TEST);
+}
+
+void OculusVR::FarFieldBuffer::Destroy()
+{
+    if (glIsFramebuffer(m_fbo))
+        glDeleteFramebuffers(1, &m_fbo);
+
+    if (glIsTexture(m_colorTex))
+        glDeleteTextures(1, &m_colorTex);
+
+    if (glIsTexture(m_depthBuffer))
+        glDeleteTextures(1, &m_depthBuffer);
+
+    if (glIsVertexArray(m_vertexArray))
+        glDeleteVertexArrays(1, &m_vertexArray);
+}
+
+OculusVR::StereoReprojection::StereoReprojection(const ovrSizei &size) : m_size(size)
+{
+    m_tileCount.w = (size.w + TILE_SIZE - 1) / TILE_SIZE;
+    m_tileCount.h = (size.h + TILE_SIZE - 1) / TILE_SIZE;
+
+    glGenVertexArrays(1, &m_vertexArray);
+    glGenFramebuffers(1, &m_fbo);
+    glGenFramebuffers(1, &m_tileFbo);
+    glGenFramebuffers(1, &m_refFbo);
+
+    GLuint *textures[] = { &m_colorTex, &m_depthBuffer, &m_tileTex, &m_refTex, &m_eyeCopyTex, &m_diffTex };
+
+    for (size_t i = 0; i < sizeof(textures) / sizeof(textures[0]); i++)
+    {
+        glGenTextures(1, textures[i]);
+        glBindTexture(GL_TEXTURE_2D, *textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // color textures match the swap chain format, so sRGB is decoded on read and encoded on write
+    glBindTexture(GL_TEXTURE_2D, m_colorTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, size.w, size.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, m_depthBuffer);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size.w, size.h, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glBindTexture(GL_TEXTURE_2D, m_tileTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, m_tileCount.w, m_tileCount.h, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, m_refTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, size.w, size.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, m_eyeCopyTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, size.w, size.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    // error is averaged by generating mipmaps - the last level holds the mean
+    glBindTexture(GL_TEXTURE_2D, m_diffTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size.w, size.h, 0, GL_RGBA, GL_FLOAT, NULL);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTex, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthBuffer, 0);
+    LOG_MESSAGE_ASSERT((glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE), "Could not create reprojection framebuffer");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_tileFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_tileTex, 0);
+    LOG_MESSAGE_ASSERT((glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE), "Could not create reprojection tile framebuffer");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OculusVR::StereoReprojection::Reproject(GLuint srcColorTex, GLuint srcDepthTex, const OVR::Matrix4f &srcToDst)
+{
+    // scatter source eye pixels into destination eye - depth test keeps the nearest one
+    static const GLfloat zero[] = { 0.f, 0.f, 0.f, 0.f };
+    static const GLfloat one    = 1.f;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, m_size.w, m_size.h);
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_DEPTH, 0, &one);
+
+    const ShaderProgram &shader = ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::ReprojectShader);
+    glUniformMatrix4fv(shader.uniforms[ModelViewProjectionMatrix], 1, GL_FALSE, &srcToDst.Transposed().M[0][0]);
+
+    // vertex shader maps point index to a pixel of the source depth texture, so draw exactly one point per such pixel
+    GLint srcWidth, srcHeight;
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, srcDepthTex);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &srcWidth);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &srcHeight);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, srcColorTex);
+
+    GLboolean depthOn = glIsEnabled(GL_DEPTH_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_FRAMEBUFFER_SRGB);
+
+    glBindVertexArray(m_vertexArray);
+    glDrawArrays(GL_POINTS, 0, srcWidth * srcHeight);
+
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    glDisable(GL_DEPTH_TEST);
+
+    // classify tiles containing disocclusion holes
+    glBindFramebuffer(GL_FRAMEBUFFER, m_tileFbo);
+    glViewport(0, 0, m_tileCount.w, m_tileCount.h);
+
+    ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::ReprojectTilesShader);
+    glBindTexture(GL_TEXTURE_2D, m_colorTex);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    if (depthOn)
+        glEnable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OculusVR::StereoReprojection::Composite()
+{
+    // write reprojected image to currently bound eye buffer, leaving far plane depth only where re-rendering is needed
+    ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::ReprojectCompositeShader);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_tileTex);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_colorTex);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    glEnable(GL_FRAMEBUFFER_SRGB);
+
+    glBindVertexArray(m_vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    glDepthFunc(GL_LESS);
+}
+
+void OculusVR::StereoReprojection::CompositeReference()
+{
+    // same as regular composite, but into a separate texture - eye itself is fully rendered for comparison
+    static const GLfloat zero[] = { 0.f, 0.f, 0.f, 0.f };
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_refFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_refTex, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+    glViewport(0, 0, m_size.w, m_size.h);
+    glClearBufferfv(GL_COLOR, 0, zero);
+
+    GLboolean depthOn = glIsEnabled(GL_DEPTH_TEST);
+    Composite();
+
+    if (!depthOn)
+        glDisable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OculusVR::StereoReprojection::MeasureError(GLuint eyeFbo, GLuint eyeTexId)
+{
+    // copy fully rendered eye before it's committed
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, eyeFbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, eyeTexId, 0);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_refFbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_eyeCopyTex, 0);
+
+    glBlitFramebuffer(0, 0, m_size.w, m_size.h, 0, 0, m_size.w, m_size.h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+
+    // per-pixel error
+    glBindFramebuffer(GL_FRAMEBUFFER, m_refFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_diffTex, 0);
+    glViewport(0, 0, m_size.w, m_size.h);
+
+    ShaderManager::GetInstance()->UseShaderProgram(ShaderManager::ReprojectDiffShader);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_eyeCopyTex);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_refTex);
+
+    GLboolean depthOn = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+
+    glBindVertexArray(m_vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    if (depthOn)
+        glEnable(GL_DEPTH_TEST);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // average and read back (stalls, but it's done on request only)
+    int lastLevel = 0;
+    for (int size = max(m_size.w, m_size.h); size > 1; size >>= 1)
+        lastLevel++;
+
+    GLfloat mean[4];
+    glBindTexture(GL_TEXTURE_2D, m_diffTex);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glGetTexImage(GL_TEXTURE_2D, lastLevel, GL_RGBA, GL_FLOAT, mean);
+
+    // errors are averaged over all pixels, re-rendered ones having zero error
+    float psnr = mean[1] > 0.f ? 10.f * log10f(1.f / mean[1]) : 0.f;
+    LOG_MESSAGE("[Reprojection] mean abs error: " << mean[0] * 255.f << " (0-255), PSNR: " << psnr << " dB, re-rendered: " << mean[2] * 100.f << "% of pixels");
+}
+
+void OculusVR::StereoReprojection::Destroy()
+{
+    if (glIsVertexArray(m_vertexArray))
+        glDeleteVertexArrays(1, &m_vertexArray);
+
+    GLuint fbos[] = { m_fbo, m_tileFbo, m_refFbo };
+    glDeleteFramebuffers(3, fbos);
+
+    GLuint textures[] = { m_colorTex, m_depthBuffer, m_tileTex, m_refTex, m_eyeCopyTex, m_diffTex };
+    glDeleteTextures(6, textures);
+}
+
 OculusVR::~OculusVR()
 {
     ovr_Destroy(m_hmdSession);
@@ -202,6 +665,32 @@ bool OculusVR::InitVRBuffers(int windowWidth, int windowHeight)
         m_eyeRenderDesc[eyeIdx] = ovr_GetRenderDesc(m_hmdSession, (ovrEyeType)eyeIdx, m_hmdDesc.DefaultEyeFov[eyeIdx]);
     }
 
+    // far-field FOV is a union of both eye FOVs, so it covers everything either eye can see
+    const ovrFovPort &leftFov  = m_hmdDesc.DefaultEyeFov[ovrEye_Left];
+    const ovrFovPort &rightFov = m_hmdDesc.DefaultEyeFov[ovrEye_Right];
+    m_farFieldFov.UpTan    = max(leftFov.UpTan, rightFov.UpTan);
+    m_farFieldFov.DownTan  = max(leftFov.DownTan, rightFov.DownTan);
+    m_farFieldFov.LeftTan  = max(leftFov.LeftTan, rightFov.LeftTan);
+    m_farFieldFov.RightTan = max(leftFov.RightTan, rightFov.RightTan);
+
+    // Eye and center eye share orientation and the eye offset is negligible at far-field distance,
+    // so eye to far-field mapping is a fixed scale/bias of tangent space coordinates.
+    const ovrFovPort &ff = m_farFieldFov;
+    for (int eyeIdx = 0; eyeIdx < ovrEye_Count; eyeIdx++)
+    {
+        const ovrFovPort &fov = m_hmdDesc.DefaultEyeFov[eyeIdx];
+        float sx = (fov.LeftTan + fov.RightTan) / (ff.LeftTan + ff.RightTan);
+        float sy = (fov.UpTan + fov.DownTan) / (ff.UpTan + ff.DownTan);
+        float bx = ((fov.RightTan - fov.LeftTan) - (ff.RightTan - ff.LeftTan)) / (ff.LeftTan + ff.RightTan);
+        float by = ((fov.UpTan - fov.DownTan) - (ff.UpTan - ff.DownTan)) / (ff.UpTan + ff.DownTan);
+
+        // NDC to texture coordinates
+        m_eyeToFarField[eyeIdx] = OVR::Matrix4f(0.5f * sx, 0.f, 0.f, 0.5f * bx + 0.5f,
+                                                0.f, 0.5f * sy, 0.f, 0.5f * by + 0.5f,
+                                                0.f, 0.f, 1.f, 0.f,
+                                                0.f, 0.f, 0.f, 1.f);
+    }
+
     memset(&m_mirrorDesc, 0, sizeof(m_mirrorDesc));
     m_mirrorDesc.Width  = windowWidth;
     m_mirrorDesc.Height = windowHeight;
@@ -304,6 +793,20 @@ void OculusVR::DestroyVR()
 
         ovr_DestroyMirrorTexture(m_hmdSession, m_mirrorTexture);
 
+        if (m_reprojection)
+        {
+            m_reprojection->Destroy();
+            delete m_reprojection;
+            m_reprojection = nullptr;
+        }
+
+        if (m_farFieldBuffer)
+        {
+            m_farFieldBuffer->Destroy();
+            delete m_farFieldBuffer;
+            m_farFieldBuffer = nullptr;
+        }
+
         for (int eyeIdx = 0; eyeIdx < ovrEye_Count; eyeIdx++)
         {
             m_eyeBuffers[eyeIdx]->Destroy(m_hmdSession);
@@ -330,6 +833,8 @@ void OculusVR::OnRenderStart()
 
     // Get both eye poses simultaneously, with IPD offset already included.
     ovr_GetEyePoses(m_hmdSession, m_frameIndex, ovrTrue, m_hmdToEyeOffset, m_eyeRenderPose, &m_sensorSampleTime);    
+
+    ShaderManager::GetInstance()->UpdateFrameConstants(m_frameTiming);
 }
 
 
@@ -340,25 +845,75 @@ const OVR::Matrix4f OculusVR::OnEyeRender(int eyeIndex)
     ovr_GetTextureSwapChainCurrentIndex(m_hmdSession, m_eyeBuffers[eyeIndex]->m_swapTextureChain, &curIndex);
     ovr_GetTextureSwapChainBufferGL(m_hmdSession, m_eyeBuffers[eyeIndex]->m_swapTextureChain, curIndex, &m_eyeBuffers[eyeIndex]->m_eyeTexId);
 
-    if (m_msaaEnabled)
+    m_eyeBuffers[eyeIndex]->UpdateGpuTimer(eyeIndex);
+    m_eyeBuffers[eyeIndex]->BeginGpuTimer();
+
+    // reprojection reads single sampled depth, so MSAA is not used with it
+    if (m_msaaEnabled && !m_reprojectionEnabled)
         m_eyeBuffers[eyeIndex]->OnRenderMSAA();
     else
         m_eyeBuffers[eyeIndex]->OnRender();
 
-    m_projectionMatrix[eyeIndex] = OVR::Matrix4f(ovrMatrix4f_Projection(m_eyeRenderDesc[eyeIndex].Fov, 0.01f, 10000.0f, ovrProjection_None));
-    m_eyeOrientation[eyeIndex] = OVR::Matrix4f(OVR::Quatf(m_eyeRenderPose[eyeIndex].Orientation).Inverted());
-    m_eyePose[eyeIndex]        = OVR::Matrix4f::Translation(-OVR::Vector3f(m_eyeRenderPose[eyeIndex].Position));
+    if (m_farFieldEnabled && m_farFieldBuffer)
+        m_farFieldBuffer->Composite(m_eyeToFarField[eyeIndex]);
+
+    // when measuring error, the eye is fully rendered and reprojection goes to a separate texture
+    if (ReprojectEye(eyeIndex) && !m_reprojectionMeasure)
+        m_reprojection->Composite();
+
+    if (m_eyeBuffers[eyeIndex]->m_maskEnabled)
+        m_eyeBuffers[eyeIndex]->RenderRadialMask();
+
+    UpdateEyeMatrices(eyeIndex);
+
+    // all programs read view matrices from the shared block - no per program MVP updates
+    UpdateViewConstants(eyeIndex, m_projectionMatrix[eyeIndex], m_eyeOrientation[eyeIndex] * m_eyePose[eyeIndex], m_eyeRenderPose[eyeIndex].Position);
 
     return m_projectionMatrix[eyeIndex] * m_eyeOrientation[eyeIndex] * m_eyePose[eyeIndex];
 }
 
+void OculusVR::UpdateEyeMatrices(int eyeIndex)
+{
+    // in split-depth mode only near-field geometry is rendered per eye
+    float zFar = m_farFieldEnabled ? m_farFieldDistance : 10000.0f;
+
+    m_projectionMatrix[eyeIndex] = OVR::Matrix4f(ovrMatrix4f_Projection(m_eyeRenderDesc[eyeIndex].Fov, 0.01f, zFar, ovrProjection_None));
+    m_eyeOrientation[eyeIndex] = OVR::Matrix4f(OVR::Quatf(m_eyeRenderPose[eyeIndex].Orientation).Inverted());
+    m_eyePose[eyeIndex]        = OVR::Matrix4f::Translation(-OVR::Vector3f(m_eyeRenderPose[eyeIndex].Position));
+}
+
 void OculusVR::OnEyeRenderFinish(int eyeIndex)
 {
-    if (m_msaaEnabled)
+    if (m_msaaEnabled && !m_reprojectionEnabled)
         m_eyeBuffers[eyeIndex]->OnRenderMSAAFinish();
     else
         m_eyeBuffers[eyeIndex]->OnRenderFinish();
 
+    // fill in masked pixels before the texture is handed over to the compositor
+    if (m_eyeBuffers[eyeIndex]->m_maskEnabled)
+        m_eyeBuffers[eyeIndex]->ReconstructRadialMask();
+
+    if (m_reprojectionEnabled && eyeIndex == ovrEye_Left)
+    {
+        // right eye pose is already known - reproject left eye while its texture is still ours
+        UpdateEyeMatrices(ovrEye_Right);
+
+        const OVR::Matrix4f leftMVP  = GetEyeMVPMatrix(ovrEye_Left);
+        const OVR::Matrix4f rightMVP = GetEyeMVPMatrix(ovrEye_Right);
+        m_reprojection->Reproject(m_eyeBuffers[ovrEye_Left]->m_eyeTexId, m_eyeBuffers[ovrEye_Left]->m_depthBuffer, rightMVP * leftMVP.Inverted());
+
+        if (m_reprojectionMeasure)
+            m_reprojection->CompositeReference();
+    }
+
+    if (ReprojectEye(eyeIndex) && m_reprojectionMeasure)
+    {
+        m_reprojection->MeasureError(m_eyeBuffers[eyeIndex]->m_eyeFbo, m_eyeBuffers[eyeIndex]->m_eyeTexId);
+        m_reprojectionMeasure = false;
+    }
+
+    m_eyeBuffers[eyeIndex]->EndGpuTimer();
+
     ovr_CommitTextureSwapChain(m_hmdSession, m_eyeBuffers[eyeIndex]->m_swapTextureChain);
 }
 
@@ -367,6 +922,61 @@ const OVR::Matrix4f OculusVR::GetEyeMVPMatrix(int eyeIndex) const
     return m_projectionMatrix[eyeIndex] * m_eyeOrientation[eyeIndex] * m_eyePose[eyeIndex];
 }
 
+const OVR::Matrix4f OculusVR::OnFarFieldRender()
+{
+    LOG_MESSAGE_ASSERT(m_farFieldEnabled, "Far-field rendering is disabled!");
+
+    // buffer is created on first use, so samples not using split-depth mode don't pay for it
+    if (!m_farFieldBuffer)
+        m_farFieldBuffer = new FarFieldBuffer(m_hmdSession, m_farFieldFov);
+
+    m_farFieldBuffer->OnRender();
+
+    // render from center eye - orientation is the same for both eyes, position is halfway between them
+    OVR::Vector3f centerEyePos = (OVR::Vector3f(m_eyeRenderPose[ovrEye_Left].Position) + OVR::Vector3f(m_eyeRenderPose[ovrEye_Right].Position)) * 0.5f;
+    OVR::Matrix4f projection   = OVR::Matrix4f(ovrMatrix4f_Projection(m_farFieldFov, m_farFieldDistance, 10000.0f, ovrProjection_None));
+    OVR::Matrix4f view         = OVR::Matrix4f(OVR::Quatf(m_eyeRenderPose[ovrEye_Left].Orientation).Inverted()) * OVR::Matrix4f::Translation(-centerEyePos);
+
+    UpdateViewConstants(FAR_FIELD_VIEW, projection, view, centerEyePos);
+
+    return projection * view;
+}
+
+void OculusVR::OnFarFieldRenderFinish()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OculusVR::SetStereoReprojection(bool val)
+{
+    // resources are created on first use, so samples not using reprojection don't pay for it
+    if (val && !m_reprojection)
+        m_reprojection = new StereoReprojection(m_eyeBuffers[ovrEye_Right]->m_eyeTextureSize);
+
+    m_reprojectionEnabled = val;
+    m_reprojectionMeasure = false;
+
+    LOG_MESSAGE("[Reprojection] " << (val ? "enabled" : "disabled"));
+}
+
+void OculusVR::SetRadialDensityMask(int eyeIdx, bool val)
+{
+    m_eyeBuffers[eyeIdx]->m_maskEnabled = val;
+
+    // measure both eyes after a change, so masked and unmasked timings can be compared
+    for (int eye = 0; eye < ovrEye_Count; eye++)
+    {
+        m_eyeBuffers[eye]->m_gpuTimerFrames = GPU_TIMER_FRAMES;
+        m_eyeBuffers[eye]->m_gpuTime = 0.0;
+    }
+}
+
+void OculusVR::SetRadialDensityMaskRadius(float radius)
+{
+    for (int eye = 0; eye < ovrEye_Count; eye++)
+        m_eyeBuffers[eye]->m_maskRadius = radius;
+}
+
 void OculusVR::SubmitFrame()
 {
     // set up positional data
@@ -453,6 +1063,18 @@ void OculusVR::OnKeyPress(KeyCode key)
     case KEY_SPACE:
         ovr_RecenterTrackingOrigin(m_hmdSession);
         break;
+    case KEY_1:
+        SetRadialDensityMask(ovrEye_Left, !RadialDensityMaskEnabled(ovrEye_Left));
+        break;
+    case KEY_2:
+        SetRadialDensityMask(ovrEye_Right, !RadialDensityMaskEnabled(ovrEye_Right));
+        break;
+    case KEY_3:
+        SetStereoReprojection(!StereoReprojectionEnabled());
+        break;
+    case KEY_4:
+        MeasureReprojectionError();
+        break;
     }
 }
 
@@ -21,7 +21,13 @@ public:
                  m_trackerChaperone(nullptr),
                  m_msaaEnabled(false),
                  m_frameIndex(0),
-                 m_sensorSampleTime(0)
+                 m_sensorSampleTime(0),
+                 m_farFieldBuffer(nullptr),
+                 m_farFieldEnabled(false),
+                 m_farFieldDistance(4.0f),
+                 m_reprojection(nullptr),
+                 m_reprojectionEnabled(false),
+                 m_reprojectionMeasure(false)
     {
     }
 
@@ -51,6 +57,21 @@ public:
     void  ShowPerfStats(ovrPerfHudMode statsMode);
     void  SetMSAA(bool val) { m_msaaEnabled = val; }
     bool  MSAAEnabled() const { return m_msaaEnabled; }
+    void  SetRadialDensityMask(int eyeIdx, bool val);   // checkerboard mask eye periphery (requires depth testing)
+    bool  RadialDensityMaskEnabled(int eyeIdx) const { return m_eyeBuffers[eyeIdx]->m_maskEnabled; }
+    void  SetRadialDensityMaskRadius(float radius);     // radius of fully shaded area (1.0 - edge of eye texture)
+
+    // split-depth rendering: geometry beyond far-field distance is rendered once (from center eye) and shared by both eyes
+    const OVR::Matrix4f OnFarFieldRender();   // call after OnRenderStart() and before eye rendering
+    void  OnFarFieldRenderFinish();
+    void  SetFarField(bool val) { m_farFieldEnabled = val; }
+    bool  FarFieldEnabled() const { return m_farFieldEnabled; }
+    void  SetFarFieldDistance(float distance) { m_farFieldDistance = distance; }
+
+    // experimental: right eye is reprojected from left eye color and depth, only disoccluded tiles are re-rendered
+    void  SetStereoReprojection(bool val);
+    bool  StereoReprojectionEnabled() const { return m_reprojectionEnabled; }
+    void  MeasureReprojectionError() { m_reprojectionMeasure = m_reprojectionEnabled; }   // compare next frame against true stereo
 private:
     // A buffer struct used to store eye textures and framebuffers.
     // We create one instance for the left eye, one for the right eye.
@@ -63,6 +84,12 @@ private:
         void SetupMSAA(); 
         void OnRenderMSAA();
         void OnRenderMSAAFinish();
+        void SetupRadialMask(const ovrFovPort &fov);
+        void RenderRadialMask();
+        void ReconstructRadialMask();
+        void BeginGpuTimer();
+        void EndGpuTimer();
+        void UpdateGpuTimer(int eyeIdx);
         void Destroy(const ovrSession &session);
 
         ovrSizei   m_eyeTextureSize;
@@ -74,9 +101,80 @@ private:
         GLuint m_eyeTexMSAA   = 0;   // color texture for MSAA
         GLuint m_depthTexMSAA = 0;   // depth texture for MSAA
 
+        // radial density mask data
+        bool   m_maskEnabled     = false;
+        float  m_maskRadius      = 0.6f;
+        float  m_maskCenter[2];          // projection center in eye texture (pixels)
+        GLuint m_maskVertexArray = 0;    // empty VAO for fullscreen passes
+        GLuint m_maskFbo         = 0;    // framebuffer for reconstruction source copy
+        GLuint m_maskTexture     = 0;    // copy of eye texture read by reconstruction pass
+
+        // GPU timing of eye rendering (logged after GPU_TIMER_FRAMES samples)
+        GLuint m_gpuTimerQuery   = 0;
+        bool   m_gpuTimerActive  = false;
+        bool   m_gpuTimerPending = false;
+        int    m_gpuTimerFrames  = 0;
+        double m_gpuTime         = 0.0;
+
         ovrTextureSwapChain m_swapTextureChain = nullptr;
     };
 
+    // Monoscopic far-field buffer, rendered from center eye with FOV covering both eyes.
+    struct FarFieldBuffer
+    {
+        FarFieldBuffer(const ovrSession &session, const ovrFovPort &fov);
+        void OnRender();
+        void Composite(const OVR::Matrix4f &eyeToFarField);
+        void Destroy();
+
+        ovrSizei   m_textureSize;
+        GLuint     m_fbo         = 0;
+        GLuint     m_colorTex    = 0;
+        GLuint     m_depthBuffer = 0;
+        GLuint     m_vertexArray = 0;   // empty VAO for fullscreen composite pass
+    };
+
+    // Depth based reprojection of one eye into the other.
+    struct StereoReprojection
+    {
+        static const int TILE_SIZE = 8;   // must match TILE_SIZE in reprojection shaders
+
+        StereoReprojection(const ovrSizei &size);
+        void Reproject(GLuint srcColorTex, GLuint srcDepthTex, const OVR::Matrix4f &srcToDst);
+        void Composite();
+        void CompositeReference();
+        void MeasureError(GLuint eyeFbo, GLuint eyeTexId);
+        void Destroy();
+
+        ovrSizei   m_size;
+        ovrSizei   m_tileCount;
+        GLuint     m_vertexArray  = 0;   // empty VAO for attribute-less passes
+        GLuint     m_fbo          = 0;
+        GLuint     m_colorTex     = 0;   // reprojected color, alpha = 0 for holes
+        GLuint     m_depthBuffer  = 0;
+        GLuint     m_tileTex      = 0;   // hole tiles
+        GLuint     m_tileFbo      = 0;
+        GLuint     m_refFbo       = 0;   // used for error metric only
+        GLuint     m_refTex       = 0;   // reprojected eye as it would be composited
+        GLuint     m_eyeCopyTex   = 0;   // fully rendered eye
+        GLuint     m_diffTex      = 0;   // per-pixel error, averaged with mipmaps
+    };
+
+    void UpdateEyeMatrices(int eyeIndex);
+    bool ReprojectEye(int eyeIndex) const { return m_reprojectionEnabled && eyeIndex == ovrEye_Right; }
+
+    // stereo reprojection data
+    StereoReprojection *m_reprojection;
+    bool              m_reprojectionEnabled;
+    bool              m_reprojectionMeasure;   // error is measured this frame
+
+    // split-depth rendering data
+    FarFieldBuffer   *m_farFieldBuffer;
+    bool              m_farFieldEnabled;
+    float             m_farFieldDistance;
+    ovrFovPort        m_farFieldFov;
+    OVR::Matrix4f     m_eyeToFarField[ovrEye_Count];   // eye NDC to far-field texture coordinates
+
     // data and buffers used to render to HMD
     ovrSession        m_hmdSession;
     ovrHmdDesc        m_hmdDesc;
@@ -3,6 +3,7 @@
 #include "renderer/Font.hpp"
 #include "renderer/OculusVR.hpp"
 #include "renderer/RenderContext.hpp"
+#include "renderer/TextureManager.hpp"
 #include <sstream>
 
 extern RenderContext  g_renderContext;
@@ -70,6 +71,15 @@ void OculusVRDebug::OnRender(const ovrSession session, const ovrTrackingState &t
                                                        eyeTextureSize.w, eyeTextureSize.h);
     m_font->drawText(buf, xPos, 0.1f - ySpacing * 4.f, 0.f);
 
+    // texture residency - hit rate drops when the working set doesn't fit in the memory budget
+    const TextureManager::TextureStats &texStats = TextureManager::GetInstance()->GetStats();
+    unsigned int texBinds = texStats.hits + texStats.misses;
+
+    sprintf(buf, "Textures: %d (%.1f/%.0f MB) Evicted: %d/%u Hits: %.1f%%", texStats.residentCount, texStats.residentBytes / (1024.f * 1024.f),
+                                                                          texStats.budgetBytes / (1024.f * 1024.f), texStats.evictedCount, texStats.evictions,
+                                                                          texBinds ? 100.f * texStats.hits / texBinds : 100.f);
+    m_font->drawText(buf, xPos, 0.1f - ySpacing * 5.f, 0.f);
+
     // latency readings
     float latencies[5] = {};
     if (ovr_GetFloatArray(session, "DK2Latency", latencies, 5) == 5)
@@ -82,11 +92,11 @@ void OculusVRDebug::OnRender(const ovrSession session, const ovrTrackingState &t
 
         statsStream.str("");
         statsStream << "M2P Latency  Ren: " << text[0] << " TWrp: " << text[1];
-        m_font->drawText(statsStream.str(), xPos, 0.1f - ySpacing * 5.f, 0.f);
+        m_font->drawText(statsStream.str(), xPos, 0.1f - ySpacing * 6.f, 0.f);
 
         statsStream.str("");
         statsStream << "PostPresent: " << text[2] << " Err: " << text[3] << " " << text[4];
-        m_font->drawText(statsStream.str(), xPos, 0.1f - ySpacing * 6.f, 0.f);
+        m_font->drawText(statsStream.str(), xPos, 0.1f - ySpacing * 7.f, 0.f);
     }
 }
 
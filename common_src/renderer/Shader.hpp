@@ -2,16 +2,76 @@
 #define SHADER_HPP
 
 #include "renderer/OpenGL.hpp"
+#include <type_traits>
+#include <vector>
+
+// FNV-1a hash of shader variable name
+constexpr unsigned int ShaderHash(const char *str, unsigned int hash = 2166136261u)
+{
+    return *str ? ShaderHash(str + 1, (hash ^ (unsigned char)*str) * 16777619u) : hash;
+}
+
+// forces the hash to be evaluated at compile time: shader.GetAttribLocation(SHADER_VAR("inVertex"))
+#define SHADER_VAR(name) std::integral_constant<unsigned int, ShaderHash(name)>::value
+
+// active program variable, reflected at link time
+struct ShaderVariable
+{
+    enum Kind
+    {
+        Attribute,
+        Uniform,
+        UniformBlock
+    };
+
+    unsigned int hash;
+    Kind         kind;
+    GLint        location;   // block index for uniform blocks
+    GLenum       type;       // 0 for uniform blocks
+    GLint        size;       // array size, data size in bytes for uniform blocks
+};
 
 // Group shader programs and their uniform locations together
 enum UniformId
 {
     ModelViewProjectionMatrix,
+    ModelMatrix,
     TextureMatrix,
     VertexColor,
+    RadialMask,
+    SourceRect,
+    DestRect,
     NUM_UNIFORMS
 };
 
+// fixed binding points of uniform blocks, assigned to every program at link time
+enum UniformBinding
+{
+    FrameConstantsBinding,
+    ViewConstantsBinding,
+    ViewMVPsBinding,
+    TextureArraysBinding,
+    NUM_UNIFORM_BINDINGS
+};
+
+// std140 layout of FrameConstants uniform block
+struct FrameConstants
+{
+    GLfloat time;        // seconds since first frame
+    GLfloat deltaTime;
+    GLint   frameCount;
+    GLint   padding;
+};
+
+// std140 layout of ViewConstants uniform block (column major matrices)
+struct ViewConstants
+{
+    GLfloat viewProjectionMatrix[16];
+    GLfloat viewMatrix[16];
+    GLfloat projectionMatrix[16];
+    GLfloat eyePosition[4];
+};
+
 struct ShaderProgram
 {
     GLuint id;
@@ -21,6 +81,9 @@ struct ShaderProgram
 
     GLint uniforms[NUM_UNIFORMS];
 
+    // all active variables, sorted by name hash
+    std::vector<ShaderVariable> variables;
+
     ShaderProgram() : id(0), vertShader(0), fragShader(0), geomShader(0)
     {
         for (int i = 0; i < NUM_UNIFORMS; i++)
@@ -28,6 +91,34 @@ struct ShaderProgram
             uniforms[i] = -1;
         }
     }
+
+    GLint GetAttribLocation(unsigned int nameHash) const     { return FindVariable(ShaderVariable::Attribute, nameHash); }
+    GLint GetUniformLocation(unsigned int nameHash) const    { return FindVariable(ShaderVariable::Uniform, nameHash); }
+    GLint GetUniformBlockIndex(unsigned int nameHash) const  { return FindVariable(ShaderVariable::UniformBlock, nameHash); }
+
+    GLint FindVariable(ShaderVariable::Kind kind, unsigned int nameHash) const
+    {
+        // binary search - tables are small and contiguous
+        size_t lo = 0, hi = variables.size();
+
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+
+            if (variables[mid].hash < nameHash)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        for (; lo < variables.size() && variables[lo].hash == nameHash; lo++)
+        {
+            if (variables[lo].kind == kind)
+                return variables[lo].location;
+        }
+
+        return -1;
+    }
 };
 
 #endif
\ No newline at end of file
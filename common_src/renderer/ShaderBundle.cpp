@@ -0,0 +1,543 @@
+// generated by common_res/pack_shaders.ps1 - do not edit
+#include "renderer/ShaderBundle.hpp"
+
+static const char shader_BasicVariant_fsh[] = R"shader(#version 410
+// FEATURE_* defines are injected after the version line by ShaderManager
+
+#ifdef FEATURE_BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+// centroid sampling keeps interpolated values inside the primitive on partially covered MSAA pixels
+#ifdef FEATURE_MSAA
+#define SAMPLING centroid
+#else
+#define SAMPLING
+#endif
+
+#ifdef FEATURE_VERTEX_COLOR
+layout(location = 3) SAMPLING in vec4 vertexColor;
+#endif
+
+#ifdef FEATURE_TEXTURED
+uniform sampler2D sTexture;
+layout(location = 4) SAMPLING in vec2 texCoord;
+#endif
+
+#ifdef FEATURE_TEXTURE_ARRAY
+#ifndef FEATURE_TEXTURED
+layout(location = 4) SAMPLING in vec2 texCoord;
+#endif
+layout(location = 6) flat in ivec2 textureIndex;
+
+#ifdef FEATURE_BINDLESS
+// must match TextureManager::MAX_TEXTURE_ARRAYS
+#define MAX_TEXTURE_ARRAYS 16
+
+// resident bindless handles of all texture arrays (TextureManager::BindTextureArrays)
+layout(std140) uniform TextureArrays
+{
+    uvec2 TextureArrayHandles[MAX_TEXTURE_ARRAYS];
+};
+#else
+// array bound by TextureManager::BindTextureArray, textureIndex.x is ignored
+uniform sampler2DArray sTextureArray;
+#endif
+#endif
+
+out vec4 fragmentColor;
+
+void main()
+{
+    fragmentColor = vec4(1.0);
+
+#ifdef FEATURE_TEXTURED
+    fragmentColor *= texture(sTexture, texCoord);
+#endif
+#if defined(FEATURE_TEXTURE_ARRAY) && defined(FEATURE_BINDLESS)
+    fragmentColor *= texture(sampler2DArray(TextureArrayHandles[textureIndex.x]), vec3(texCoord, textureIndex.y));
+#elif defined(FEATURE_TEXTURE_ARRAY)
+    fragmentColor *= texture(sTextureArray, vec3(texCoord, textureIndex.y));
+#endif
+#ifdef FEATURE_VERTEX_COLOR
+    fragmentColor *= vertexColor;
+#endif
+}
+)shader";
+
+static const char shader_BasicVariant_gsh[] = R"shader(#version 410
+// only used by FEATURE_INSTANCED_STEREO variants - routes each instance to its viewport
+
+#ifdef FEATURE_MSAA
+#define SAMPLING centroid
+#else
+#define SAMPLING
+#endif
+
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+layout(location = 20) in int instanceID[];
+
+#ifdef FEATURE_VERTEX_COLOR
+layout(location = 3) SAMPLING out vec4 vertexColor;
+#endif
+
+#ifdef FEATURE_TEXTURED
+layout(location = 4) SAMPLING in vec2 tCoord[];
+layout(location = 4) SAMPLING out vec2 texCoord;
+#endif
+
+void main()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        gl_ViewportIndex = instanceID[0];
+        gl_Position = gl_in[i].gl_Position;
+#ifdef FEATURE_VERTEX_COLOR
+        // instanced geometry is drawn green to tell it apart from the regular render path
+        vertexColor = vec4(0.0, 1.0, 0.0, 1.0);
+#endif
+#ifdef FEATURE_TEXTURED
+        texCoord = tCoord[i];
+#endif
+        EmitVertex();
+    }
+
+    EndPrimitive();
+}
+)shader";
+
+static const char shader_BasicVariant_vsh[] = R"shader(#version 410
+// FEATURE_* defines are injected after the version line by ShaderManager
+
+#ifdef FEATURE_MULTIVIEW
+#extension GL_OVR_multiview2 : require
+layout(num_views = 2) in;
+#endif
+
+// interpolation qualifiers must match across stages
+#ifdef FEATURE_MSAA
+#define SAMPLING centroid
+#else
+#define SAMPLING
+#endif
+
+layout(location = 0)  in vec3 inVertex;
+layout(location = 15) in vec3 inOffset;
+
+#ifdef FEATURE_VERTEX_COLOR
+layout(location = 1) in  vec4 inVertexColor;
+layout(location = 3) SAMPLING out vec4 vertexColor;
+#endif
+
+#if defined(FEATURE_TEXTURED) || defined(FEATURE_TEXTURE_ARRAY)
+layout(location = 2) in  vec2 inTexCoord;
+layout(location = 4) SAMPLING out vec2 texCoord;
+#endif
+
+#ifdef FEATURE_TEXTURE_ARRAY
+// per instance (array, layer) - instances of a single draw must share the array
+layout(location = 5) in  ivec2 inTextureIndex;
+layout(location = 6) flat out ivec2 textureIndex;
+#endif
+
+#if defined(FEATURE_INSTANCED_STEREO) || defined(FEATURE_MULTIVIEW)
+// must match OculusVR::MAX_VIEWS
+#define MAX_VIEWS 16
+
+// store MVP for each view in a separate matrix UBO
+// view is selected by gl_InstanceID (0 - left, 1 - right, 2+ - extra views) or gl_ViewID_OVR
+layout(std140) uniform ViewMVPs
+{
+    int  ViewCount;
+    mat4 ModelViewProjectionMatrix[MAX_VIEWS];
+};
+#else
+// shared per-view constants (ShaderManager::UpdateViewConstants)
+layout(std140) uniform ViewConstants
+{
+    mat4 ViewProjectionMatrix;
+    mat4 ViewMatrix;
+    mat4 ProjectionMatrix;
+    vec4 EyePosition;
+};
+#endif
+
+#ifdef FEATURE_INSTANCED_STEREO
+layout(location = 20) out int instanceID;
+#endif
+
+void main()
+{
+    vec4 position = vec4(inVertex + inOffset, 1.0);
+
+#if defined(FEATURE_MULTIVIEW)
+    gl_Position = ModelViewProjectionMatrix[gl_ViewID_OVR] * position;
+#elif defined(FEATURE_INSTANCED_STEREO)
+    // instances past the active view count collapse to a degenerate triangle
+    gl_Position = gl_InstanceID < ViewCount ? ModelViewProjectionMatrix[gl_InstanceID] * position : vec4(0.0);
+    instanceID  = gl_InstanceID;
+#else
+    gl_Position = ViewProjectionMatrix * position;
+#endif
+
+#ifdef FEATURE_VERTEX_COLOR
+    vertexColor = inVertexColor;
+#endif
+#if defined(FEATURE_TEXTURED) || defined(FEATURE_TEXTURE_ARRAY)
+    texCoord = inTexCoord;
+#endif
+#ifdef FEATURE_TEXTURE_ARRAY
+    textureIndex = inTextureIndex;
+#endif
+}
+)shader";
+
+static const char shader_FarField_fsh[] = R"shader(#version 410
+
+uniform sampler2D sTexture;
+
+layout(location = 4) in vec2 TexCoord;
+
+out vec4 fragmentColor;
+
+void main()
+{
+    fragmentColor = texture(sTexture, TexCoord);
+}
+)shader";
+
+static const char shader_FarField_vsh[] = R"shader(#version 410
+
+// maps eye NDC to far-field texture coordinates
+uniform mat4 TextureMatrix;
+
+layout(location = 4) out vec2 TexCoord;
+
+// fullscreen triangle generated from vertex id
+void main()
+{
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    gl_Position = vec4(pos, 0.0, 1.0);
+    TexCoord    = (TextureMatrix * vec4(pos, 0.0, 1.0)).xy;
+}
+)shader";
+
+static const char shader_Font_fsh[] = R"shader(#version 410
+uniform sampler2D  sTexture;
+uniform vec4       vertexColor;
+
+layout(location = 4) in vec2 TexCoord;
+
+out vec4 fragmentColor;
+
+void main()
+{
+    fragmentColor = texture2D(sTexture, TexCoord) * vertexColor; 
+}
+)shader";
+
+static const char shader_Font_vsh[] = R"shader(#version 410
+
+layout(location = 0) in vec3 inVertex;
+
+// shared per-view constants (ShaderManager::OverlayView)
+layout(std140) uniform ViewConstants
+{
+    mat4 ViewProjectionMatrix;
+    mat4 ViewMatrix;
+    mat4 ProjectionMatrix;
+    vec4 EyePosition;
+};
+
+uniform mat4 ModelMatrix;
+uniform mat4 TextureMatrix;
+
+layout(location = 4) out vec2  TexCoord;
+
+void main()
+{
+    gl_Position = ViewProjectionMatrix * ModelMatrix * vec4(inVertex, 1.0);
+    TexCoord  = (TextureMatrix * vec4(inVertex, 1.0)).xy;
+}
+ )shader";
+
+static const char shader_Fullscreen_vsh[] = R"shader(#version 410
+
+// fullscreen triangle generated from vertex id, placed on the near plane
+void main()
+{
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, -1.0, 1.0);
+}
+)shader";
+
+static const char shader_MultiResComposite_fsh[] = R"shader(#version 410
+
+uniform sampler2D sTexture;
+
+// xy: cell origin in eye texture (pixels), zw: inverse cell size (pixels)
+uniform vec4 DestRect;
+
+// xy: cell origin in multi-res buffer (texels), zw: cell size (texels)
+uniform vec4 SourceRect;
+
+out vec4 fragmentColor;
+
+void main()
+{
+    vec2 t = (gl_FragCoord.xy - DestRect.xy) * DestRect.zw;
+
+    // keep bilinear footprint half a texel inside the cell, so neighbouring cells never bleed in
+    vec2 p = clamp(SourceRect.xy + t * SourceRect.zw, SourceRect.xy + 0.5, SourceRect.xy + SourceRect.zw - 0.5);
+
+    fragmentColor = texture(sTexture, p / vec2(textureSize(sTexture, 0)));
+}
+)shader";
+
+static const char shader_OVRFrustum_fsh[] = R"shader(#version 410
+
+uniform vec4 vertexColor;
+out vec4 fragmentColor;
+
+void main()
+{
+    fragmentColor = vec4(vertexColor); 
+}
+)shader";
+
+static const char shader_OVRFrustum_vsh[] = R"shader(#version 410
+
+// shared per-view constants (ShaderManager::UpdateViewConstants)
+layout(std140) uniform ViewConstants
+{
+    mat4 ViewProjectionMatrix;
+    mat4 ViewMatrix;
+    mat4 ProjectionMatrix;
+    vec4 EyePosition;
+};
+
+uniform mat4 ModelMatrix;
+
+layout(location = 0) in vec3 inVertex;
+
+void main()
+{
+    gl_Position = ViewProjectionMatrix * ModelMatrix * vec4(inVertex, 1.0);    
+}
+)shader";
+
+static const char shader_RadialMask_fsh[] = R"shader(#version 410
+
+// xy: mask center (pixels), zw: inverse mask radius (pixels)
+uniform vec4 RadialMask;
+
+out vec4 fragmentColor;
+
+void main()
+{
+    vec2  d    = (gl_FragCoord.xy - RadialMask.xy) * RadialMask.zw;
+    ivec2 quad = ivec2(gl_FragCoord.xy) >> 1;
+
+    // outside the radius every other 2x2 quad is masked out (checkerboard)
+    if (dot(d, d) <= 1.0 || ((quad.x + quad.y) & 1) == 0)
+        discard;
+
+    fragmentColor = vec4(0.0);
+}
+)shader";
+
+static const char shader_RadialReconstruct_fsh[] = R"shader(#version 410
+
+uniform sampler2D sTexture;
+
+// xy: mask center (pixels), zw: inverse mask radius (pixels)
+uniform vec4 RadialMask;
+
+out vec4 fragmentColor;
+
+void main()
+{
+    vec2  d    = (gl_FragCoord.xy - RadialMask.xy) * RadialMask.zw;
+    ivec2 quad = ivec2(gl_FragCoord.xy) >> 1;
+
+    // only masked pixels need to be filled in
+    if (dot(d, d) <= 1.0 || ((quad.x + quad.y) & 1) == 0)
+        discard;
+
+    // horizontal and vertical neighbour quads are always shaded - average matching pixels
+    ivec2 p    = ivec2(gl_FragCoord.xy);
+    ivec2 maxP = textureSize(sTexture, 0) - 1;
+
+    fragmentColor = 0.25 * (texelFetch(sTexture, clamp(p + ivec2(-2,  0), ivec2(0), maxP), 0) +
+                            texelFetch(sTexture, clamp(p + ivec2( 2,  0), ivec2(0), maxP), 0) +
+                            texelFetch(sTexture, clamp(p + ivec2( 0, -2), ivec2(0), maxP), 0) +
+                            texelFetch(sTexture, clamp(p + ivec2( 0,  2), ivec2(0), maxP), 0));
+}
+)shader";
+
+static const char shader_Reproject_fsh[] = R"shader(#version 410
+
+layout(location = 9) in vec4 vertexColor;
+
+out vec4 fragmentColor;
+
+void main()
+{
+    fragmentColor = vertexColor;
+}
+)shader";
+
+static const char shader_Reproject_vsh[] = R"shader(#version 410
+
+// source eye NDC to target eye clip space
+uniform mat4 ModelViewProjectionMatrix;
+
+uniform sampler2D sTexture;      // source eye color
+uniform sampler2D sAuxTexture;   // source eye depth
+
+layout(location = 9) out vec4 vertexColor;
+
+// one point per source eye pixel, moved to its location in the target eye
+void main()
+{
+    ivec2 size  = textureSize(sAuxTexture, 0);
+    ivec2 p     = ivec2(gl_VertexID % size.x, gl_VertexID / size.x);
+    float depth = texelFetch(sAuxTexture, p, 0).r;
+    vec2  ndc   = (vec2(p) + 0.5) / vec2(size) * 2.0 - 1.0;
+
+    gl_Position = ModelViewProjectionMatrix * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+
+    // keep far plane points distinguishable from holes
+    gl_Position.z = min(gl_Position.z, gl_Position.w * 0.99999);
+
+    // near plane depth marks pixels skipped by radial density mask - nothing to reproject
+    if (depth <= 0.0)
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+
+    vertexColor = vec4(texelFetch(sTexture, p, 0).rgb, 1.0);
+}
+)shader";
+
+static const char shader_ReprojectComposite_fsh[] = R"shader(#version 410
+
+#define TILE_SIZE 8
+
+uniform sampler2D sTexture;      // reprojected color, alpha = 0 for holes
+uniform sampler2D sAuxTexture;   // hole tiles
+
+out vec4 fragmentColor;
+
+void main()
+{
+    ivec2 p     = ivec2(gl_FragCoord.xy);
+    ivec2 maxP  = textureSize(sTexture, 0) - 1;
+    vec4  color = texelFetch(sTexture, p, 0);
+
+    if (color.a == 0.0)
+    {
+        vec4 left  = texelFetch(sTexture, max(p - ivec2(1, 0), ivec2(0)), 0);
+        vec4 right = texelFetch(sTexture, min(p + ivec2(1, 0), maxP), 0);
+
+        // disocclusion - leave it to be re-rendered
+        if (left.a == 0.0 || right.a == 0.0)
+            discard;
+
+        color = 0.5 * (left + right);
+    }
+
+    // pixels in hole tiles stay at far plane depth and get re-rendered, the rest is locked with near plane depth
+    bool holeTile = texelFetch(sAuxTexture, p / TILE_SIZE, 0).r > 0.0;
+
+    fragmentColor = vec4(color.rgb, holeTile ? 0.0 : 1.0);
+    gl_FragDepth  = holeTile ? 1.0 : 0.0;
+}
+)shader";
+
+static const char shader_ReprojectDiff_fsh[] = R"shader(#version 410
+
+uniform sampler2D sTexture;      // reprojected eye, alpha = 0 for re-rendered pixels
+uniform sampler2D sAuxTexture;   // fully rendered eye
+
+out vec4 fragmentColor;
+
+// r: absolute error, g: squared error, b: re-rendered pixel
+void main()
+{
+    ivec2 p         = ivec2(gl_FragCoord.xy);
+    vec4  reproject = texelFetch(sTexture, p, 0);
+    vec3  reference = texelFetch(sAuxTexture, p, 0).rgb;
+
+    if (reproject.a == 0.0)
+    {
+        fragmentColor = vec4(0.0, 0.0, 1.0, 1.0);
+        return;
+    }
+
+    vec3 d = abs(reproject.rgb - reference);
+    fragmentColor = vec4(dot(d, vec3(1.0 / 3.0)), dot(d * d, vec3(1.0 / 3.0)), 0.0, 1.0);
+}
+)shader";
+
+static const char shader_ReprojectTiles_fsh[] = R"shader(#version 410
+
+#define TILE_SIZE 8
+
+uniform sampler2D sTexture;   // reprojected color, alpha = 0 for holes
+
+out vec4 fragmentColor;
+
+// single pixel cracks between reprojected points are filled in, so they don't count as holes
+bool IsHole(ivec2 p, ivec2 maxP)
+{
+    if (texelFetch(sTexture, p, 0).a > 0.0)
+        return false;
+
+    return texelFetch(sTexture, max(p - ivec2(1, 0), ivec2(0)), 0).a == 0.0 ||
+           texelFetch(sTexture, min(p + ivec2(1, 0), maxP), 0).a == 0.0;
+}
+
+// one fragment per tile: 1.0 if the tile contains a disocclusion hole
+void main()
+{
+    ivec2 base = ivec2(gl_FragCoord.xy) * TILE_SIZE;
+    ivec2 maxP = textureSize(sTexture, 0) - 1;
+    float hole = 0.0;
+
+    for (int y = 0; y < TILE_SIZE; y++)
+    {
+        for (int x = 0; x < TILE_SIZE; x++)
+        {
+            if (IsHole(min(base + ivec2(x, y), maxP), maxP))
+                hole = 1.0;
+        }
+    }
+
+    fragmentColor = vec4(hole);
+}
+)shader";
+
+// sorted by name
+const BundledShader shaderBundle[] = {
+    { "BasicVariant.fsh", shader_BasicVariant_fsh, sizeof(shader_BasicVariant_fsh) - 1 },
+    { "BasicVariant.gsh", shader_BasicVariant_gsh, sizeof(shader_BasicVariant_gsh) - 1 },
+    { "BasicVariant.vsh", shader_BasicVariant_vsh, sizeof(shader_BasicVariant_vsh) - 1 },
+    { "FarField.fsh", shader_FarField_fsh, sizeof(shader_FarField_fsh) - 1 },
+    { "FarField.vsh", shader_FarField_vsh, sizeof(shader_FarField_vsh) - 1 },
+    { "Font.fsh", shader_Font_fsh, sizeof(shader_Font_fsh) - 1 },
+    { "Font.vsh", shader_Font_vsh, sizeof(shader_Font_vsh) - 1 },
+    { "Fullscreen.vsh", shader_Fullscreen_vsh, sizeof(shader_Fullscreen_vsh) - 1 },
+    { "MultiResComposite.fsh", shader_MultiResComposite_fsh, sizeof(shader_MultiResComposite_fsh) - 1 },
+    { "OVRFrustum.fsh", shader_OVRFrustum_fsh, sizeof(shader_OVRFrustum_fsh) - 1 },
+    { "OVRFrustum.vsh", shader_OVRFrustum_vsh, sizeof(shader_OVRFrustum_vsh) - 1 },
+    { "RadialMask.fsh", shader_RadialMask_fsh, sizeof(shader_RadialMask_fsh) - 1 },
+    { "RadialReconstruct.fsh", shader_RadialReconstruct_fsh, sizeof(shader_RadialReconstruct_fsh) - 1 },
+    { "Reproject.fsh", shader_Reproject_fsh, sizeof(shader_Reproject_fsh) - 1 },
+    { "Reproject.vsh", shader_Reproject_vsh, sizeof(shader_Reproject_vsh) - 1 },
+    { "ReprojectComposite.fsh", shader_ReprojectComposite_fsh, sizeof(shader_ReprojectComposite_fsh) - 1 },
+    { "ReprojectDiff.fsh", shader_ReprojectDiff_fsh, sizeof(shader_ReprojectDiff_fsh) - 1 },
+    { "ReprojectTiles.fsh", shader_ReprojectTiles_fsh, sizeof(shader_ReprojectTiles_fsh) - 1 },
+};
+
+const size_t shaderBundleCount = sizeof(shaderBundle) / sizeof(shaderBundle[0]);
@@ -0,0 +1,24 @@
+#ifndef SHADERBUNDLE_HPP
+#define SHADERBUNDLE_HPP
+
+#include <cstddef>
+
+// view of shader source text, not null terminated
+struct ShaderSourceView
+{
+    const char *data;
+    size_t      length;
+};
+
+// shader sources embedded at build time by common_res/pack_shaders.ps1 (ShaderBundle.cpp)
+struct BundledShader
+{
+    const char *name;     // file name in common_res/
+    const char *source;
+    size_t      length;
+};
+
+extern const BundledShader shaderBundle[];   // sorted by name
+extern const size_t        shaderBundleCount;
+
+#endif
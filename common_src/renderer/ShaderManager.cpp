@@ -1,10 +1,157 @@
 #include "renderer/ShaderManager.hpp"
+#include <SDL.h>
+#include <algorithm>
 #include <fstream>
+#include <vector>
+
+// program binary cache location and file header
+static const char *binaryCacheDir = "../shader_cache/";
+
+struct ProgramBinaryHeader
+{
+    unsigned int       magic;
+    unsigned int       version;
+    unsigned long long glStringsHash;
+    unsigned long long sourceHash;
+    GLenum             binaryFormat;
+    GLint              binaryLength;
+};
+
+// loose shader files location (ShaderManager::SetLooseShaderFiles)
+static const char *looseShaderDir = "../common_res/";
+
+// uber shader specialized through ShaderFeature bits
+static const char *variantVsh = "BasicVariant.vsh";
+static const char *variantFsh = "BasicVariant.fsh";
+static const char *variantGsh = "BasicVariant.gsh";
+
+// define injected for each ShaderFeature bit
+static const char *featureDefines[ShaderManager::NUM_FEATURES] = { "FEATURE_TEXTURED",
+                                                                   "FEATURE_VERTEX_COLOR",
+                                                                   "FEATURE_INSTANCED_STEREO",
+                                                                   "FEATURE_MSAA",
+                                                                   "FEATURE_MULTIVIEW",
+                                                                   "FEATURE_TEXTURE_ARRAY",
+                                                                   "FEATURE_BINDLESS" };
+
+// render targets programs are warmed up with - formats match the buffers they draw into at runtime
+enum WarmUpTarget
+{
+    Target_Eye     = 1 << 0,   // sRGB eye buffer with depth (also reprojection and multi-res buffers)
+    Target_EyeMSAA = 1 << 1,   // multisampled eye buffer
+    Target_Window  = 1 << 2,   // window back buffer (non-VR rendering)
+    Target_R8      = 1 << 3,   // reprojection hole tiles
+    Target_RGBA32F = 1 << 4,   // reprojection error
+    NUM_WARMUP_TARGETS = 5
+};
+
+static const struct
+{
+    GLenum color;
+    GLenum depth;   // 0 if target has no depth buffer
+    bool   msaa;
+} warmUpTargets[NUM_WARMUP_TARGETS] = {
+    { GL_SRGB8_ALPHA8, GL_DEPTH_COMPONENT24, false },
+    { GL_SRGB8_ALPHA8, GL_DEPTH_COMPONENT24, true  },
+    { GL_RGBA8,        GL_DEPTH_COMPONENT24, false },
+    { GL_R8,           0,                    false },
+    { GL_RGBA32F,      0,                    false }
+};
+
+// how a program is drawn at runtime, so warm-up hits the same driver shader variants
+struct WarmUpDesc
+{
+    GLenum       primitive;   // GL_POINTS, GL_LINES or GL_TRIANGLES
+    unsigned int targets;     // WarmUpTarget bits
+    bool         blend;
+};
+
+static const unsigned int eyeTargets = Target_Eye | Target_EyeMSAA;
+
+// shader source files for each program (vertex, fragment, geometry), variant features and warm-up state
+static const struct
+{
+    const char  *vsh;
+    const char  *fsh;
+    const char  *gsh;
+    unsigned int features;
+    WarmUpDesc   warmUp;
+} shaderFiles[ShaderManager::NUM_SHADERS] = {
+    { variantVsh,       variantFsh,               "",         ShaderManager::Feature_Textured | ShaderManager::Feature_VertexColor,                                         { GL_TRIANGLES, eyeTargets | Target_Window, false } },
+    { variantVsh,       variantFsh,               variantGsh, ShaderManager::Feature_Textured | ShaderManager::Feature_VertexColor | ShaderManager::Feature_InstancedStereo, { GL_TRIANGLES, eyeTargets,                 false } },
+    { "OVRFrustum.vsh", "OVRFrustum.fsh",         "",         0,                                                                                                            { GL_LINES,     eyeTargets | Target_Window, true  } },
+    { "Font.vsh",       "Font.fsh",               "",         0,                                                                                                            { GL_TRIANGLES, eyeTargets | Target_Window, true  } },
+    { variantVsh,       variantFsh,               "",         ShaderManager::Feature_VertexColor,                                                                           { GL_TRIANGLES, eyeTargets | Target_Window, false } },
+    { "Fullscreen.vsh", "RadialMask.fsh",         "",         0,                                                                                                            { GL_TRIANGLES, eyeTargets,                 false } },
+    { "Fullscreen.vsh", "RadialReconstruct.fsh",  "",         0,                                                                                                            { GL_TRIANGLES, Target_Eye,                 false } },
+    { "FarField.vsh",   "FarField.fsh",           "",         0,                                                                                                            { GL_TRIANGLES, eyeTargets,                 false } },
+    { "Reproject.vsh",  "Reproject.fsh",          "",         0,                                                                                                            { GL_POINTS,    Target_Eye,                 false } },
+    { "Fullscreen.vsh", "ReprojectTiles.fsh",     "",         0,                                                                                                            { GL_TRIANGLES, Target_R8,                  false } },
+    { "Fullscreen.vsh", "ReprojectComposite.fsh", "",         0,                                                                                                            { GL_TRIANGLES, eyeTargets,                 false } },
+    { "Fullscreen.vsh", "ReprojectDiff.fsh",      "",         0,                                                                                                            { GL_TRIANGLES, Target_RGBA32F,             false } },
+    { "Fullscreen.vsh", "MultiResComposite.fsh",  "",         0,                                                                                                            { GL_TRIANGLES, Target_Eye,                 false } }
+};
+
+// GL_KHR_parallel_shader_compile (not exposed by GLEW 1.11)
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR           0x91B1
+
+typedef void (APIENTRY *PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+static const unsigned int BINARY_CACHE_MAGIC   = 0x43425053;   // "SPBC"
+static const unsigned int BINARY_CACHE_VERSION = 2;
+
+// 64-bit FNV-1a hash
+static unsigned long long HashString(const char *str, unsigned long long hash = 14695981039346656037ULL)
+{
+    while (*str)
+    {
+        hash ^= (unsigned char)*str++;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+// 64-bit FNV-1a hash of one byte
+static unsigned long long HashByte(unsigned char byte, unsigned long long hash)
+{
+    return (hash ^ byte) * 1099511628211ULL;
+}
+
+// 64-bit FNV-1a hash of a split shader source - stage and part lengths are mixed in too, so text moving
+// between parts or stages (e.g. an empty geometry stage) can't produce the same byte stream
+static unsigned long long HashSource(GLenum stage, const ShaderManager::ShaderSourceParts &parts, unsigned long long hash)
+{
+    for (int k = 0; k < 4; k++)
+        hash = HashByte((unsigned char)(stage >> (k * 8)), hash);
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int k = 0; k < 4; k++)
+            hash = HashByte((unsigned char)(parts.lengths[i] >> (k * 8)), hash);
+
+        for (GLint j = 0; j < parts.lengths[i]; j++)
+            hash = HashByte((unsigned char)parts.strings[i][j], hash);
+    }
+
+    return hash;
+}
 
 // shader uniform names
 static const char* uniformNames[] = { "ModelViewProjectionMatrix",
+                                      "ModelMatrix",
                                       "TextureMatrix",
-                                      "vertexColor" };
+                                      "vertexColor",
+                                      "RadialMask",
+                                      "SourceRect",
+                                      "DestRect" };
+
+// shared uniform block names, indexed by UniformBinding
+static const char* uniformBlockNames[] = { "FrameConstants",
+                                           "ViewConstants",
+                                           "ViewMVPs",
+                                           "TextureArrays" };
 
 ShaderManager* ShaderManager::GetInstance()
 {
@@ -18,115 +165,668 @@ ShaderManager::~ShaderManager()
 }
 
 
+static void DeleteProgram(const ShaderProgram &program)
+{
+    if (glIsProgram(program.id))
+    {
+        glDeleteProgram(program.id);
+    }
+
+    if (glIsShader(program.vertShader))
+    {
+        glDeleteShader(program.vertShader);
+    }
+
+    if (glIsShader(program.fragShader))
+    {
+        glDeleteShader(program.fragShader);
+    }
+
+    if (glIsShader(program.geomShader))
+    {
+        glDeleteShader(program.geomShader);
+    }
+}
+
 void ShaderManager::DestroyShaders()
 {
     for (int i = 0; i < NUM_SHADERS; i++)
     {
-        if (glIsProgram(m_shaderProgram[i].id))
+        DeleteProgram(m_shaderProgram[i]);
+    }
+
+    for (auto &variant : m_variants)
+    {
+        DeleteProgram(variant.second);
+    }
+
+    m_variants.clear();
+    m_looseSources.clear();
+    m_activeProgram = nullptr;
+
+    if (glIsBuffer(m_frameConstantsUbo))
+        glDeleteBuffers(1, &m_frameConstantsUbo);
+
+    if (glIsBuffer(m_viewConstantsUbo))
+        glDeleteBuffers(1, &m_viewConstantsUbo);
+
+    m_frameConstantsUbo = 0;
+    m_viewConstantsUbo  = 0;
+    m_boundView = -1;
+}
+
+
+// load all shaders
+void ShaderManager::LoadShaders()
+{
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    InitBinaryCache();
+    InitParallelCompile();
+    InitUniformBuffers();
+    m_cachedProgramCount = 0;
+
+    // issue everything first, so the driver can compile in parallel while we wait on the first program
+    for (int i = 0; i < NUM_SHADERS; i++)
+        BeginLoadShader((ShaderName)i);
+
+    for (int i = 0; i < NUM_SHADERS; i++)
+        FinishLoadShader((ShaderName)i);
+
+    // cold (compiled) vs warm (cached) startup can be compared between first and following launches
+    double loadTime = (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+    LOG_MESSAGE("[ShaderManager] Loaded " << NUM_SHADERS << " programs in " << loadTime << " ms (" << m_cachedProgramCount << " from binary cache)");
+
+    WarmUpShaders();
+}
+
+void ShaderManager::LoadShadersAsync()
+{
+    m_asyncStartTime = SDL_GetPerformanceCounter();
+
+    InitBinaryCache();
+    InitParallelCompile();
+    InitUniformBuffers();
+    m_cachedProgramCount = 0;
+
+    // fallback program is needed right away
+    BeginLoadShader(FallbackShader);
+    FinishLoadShader(FallbackShader);
+
+    for (int i = 0; i < NUM_SHADERS; i++)
+    {
+        if (i != FallbackShader)
+            BeginLoadShader((ShaderName)i);
+    }
+
+    LOG_MESSAGE("[ShaderManager] Async load issued in " << (double)(SDL_GetPerformanceCounter() - m_asyncStartTime) * 1000.0 / SDL_GetPerformanceFrequency()
+                << " ms (parallel compile: " << (m_parallelCompile ? "yes" : "no") << ")");
+}
+
+void ShaderManager::UpdateAsyncLoad()
+{
+    if (m_pendingCount == 0)
+        return;
+
+    for (int i = 0; i < NUM_SHADERS; i++)
+    {
+        if (m_loadState[i] != Load_Pending || !LoadCompleted((ShaderName)i))
+            continue;
+
+        FinishLoadShader((ShaderName)i);
+
+        // without parallel compile every finish may block - spread them over frames
+        if (!m_parallelCompile)
+            break;
+    }
+
+    if (m_pendingCount == 0)
+    {
+        double loadTime = (double)(SDL_GetPerformanceCounter() - m_asyncStartTime) * 1000.0 / SDL_GetPerformanceFrequency();
+        LOG_MESSAGE("[ShaderManager] Async load of " << NUM_SHADERS << " programs completed in " << loadTime << " ms (" << m_cachedProgramCount << " from binary cache)");
+
+        WarmUpShaders();
+    }
+}
+
+void ShaderManager::WarmUpShaders()
+{
+    // tiny targets are enough - drivers key late compilation on state (primitive, blend, target format, sample count, viewports), not on size
+    static const int WARMUP_SIZE = 16;
+
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    // loaded programs with the state they are drawn with
+    struct WarmUpProgram
+    {
+        const ShaderProgram *program;
+        bool                 instancedStereo;   // renders to a viewport array
+        WarmUpDesc           desc;
+    };
+
+    std::vector<WarmUpProgram> programs;
+
+    for (int i = 0; i < NUM_SHADERS; i++)
+    {
+        if (m_loadState[i] == Load_Ready)
+        {
+            WarmUpProgram program = { &m_shaderProgram[i], (shaderFiles[i].features & Feature_InstancedStereo) != 0, shaderFiles[i].warmUp };
+            programs.push_back(program);
+        }
+    }
+
+    // variants draw opaque triangles into eye buffers - centroid sampling (MSAA feature) is only used with multisampled ones
+    for (auto &variant : m_variants)
+    {
+        if (variant.second.id)
         {
-            glDeleteProgram(m_shaderProgram[i].id);
+            WarmUpDesc    desc    = { GL_TRIANGLES, (variant.first & Feature_MSAA) ? (unsigned int)Target_EyeMSAA : eyeTargets, false };
+            WarmUpProgram program = { &variant.second, (variant.first & Feature_InstancedStereo) != 0, desc };
+            programs.push_back(program);
         }
+    }
+
+    // save state touched below
+    GLint     prevFbo, prevVao, prevViewport[4];
+    GLboolean prevBlend = glIsEnabled(GL_BLEND);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prevVao);
+    glGetIntegerv(GL_VIEWPORT, prevViewport);
+
+    GLint samples = 4;
+    glGetIntegerv(GL_MAX_SAMPLES, &samples);
+    samples = samples < 4 ? samples : 4;
 
-        if (glIsShader(m_shaderProgram[i].vertShader))
+    GLuint fbo[NUM_WARMUP_TARGETS], colorBuffer[NUM_WARMUP_TARGETS], depthBuffer[NUM_WARMUP_TARGETS], vertexArray;
+    glGenFramebuffers(NUM_WARMUP_TARGETS, fbo);
+    glGenRenderbuffers(NUM_WARMUP_TARGETS, colorBuffer);
+    glGenRenderbuffers(NUM_WARMUP_TARGETS, depthBuffer);
+
+    for (int i = 0; i < NUM_WARMUP_TARGETS; i++)
+    {
+        GLint targetSamples = warmUpTargets[i].msaa ? samples : 0;
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo[i]);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer[i]);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, targetSamples, warmUpTargets[i].color, WARMUP_SIZE, WARMUP_SIZE);
+        glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer[i]);
+
+        if (warmUpTargets[i].depth)
         {
-            glDeleteShader(m_shaderProgram[i].vertShader);
+            glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer[i]);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, targetSamples, warmUpTargets[i].depth, WARMUP_SIZE, WARMUP_SIZE);
+            glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer[i]);
         }
+    }
 
-        if (glIsShader(m_shaderProgram[i].fragShader))
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    // attributes are left disabled (constant inputs) - the draws only have to reach the driver, not produce anything useful
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+
+    // uniform blocks need some buffer behind them, contents don't matter
+    BindViewConstants(0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ViewMVPsBinding, m_viewConstantsUbo);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    const GLfloat viewports[] = { 0.f, 0.f, WARMUP_SIZE / 2.f, (GLfloat)WARMUP_SIZE,
+                                  WARMUP_SIZE / 2.f, 0.f, WARMUP_SIZE / 2.f, (GLfloat)WARMUP_SIZE };
+    int drawCount = 0;
+
+    for (int target = 0; target < NUM_WARMUP_TARGETS; target++)
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo[target]);
+
+        for (auto &program : programs)
         {
-            glDeleteShader(m_shaderProgram[i].fragShader);
+            if (!(program.desc.targets & (1 << target)))
+                continue;
+
+            if (program.desc.blend)
+                glEnable(GL_BLEND);
+            else
+                glDisable(GL_BLEND);
+
+            glUseProgram(program.program->id);
+
+            if (program.instancedStereo)
+            {
+                glViewportArrayv(0, 2, viewports);
+                glDrawArraysInstanced(program.desc.primitive, 0, 3, 2);
+            }
+            else
+            {
+                glViewport(0, 0, WARMUP_SIZE, WARMUP_SIZE);
+                glDrawArrays(program.desc.primitive, 0, 3);
+            }
+
+            drawCount++;
         }
     }
+
+    // wait for the driver, so the whole cost shows up here and not in the first HMD frames
+    glFinish();
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, ViewMVPsBinding, 0);
+    glBindVertexArray(prevVao);
+    glDeleteVertexArrays(1, &vertexArray);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevFbo);
+    glDeleteFramebuffers(NUM_WARMUP_TARGETS, fbo);
+    glDeleteRenderbuffers(NUM_WARMUP_TARGETS, colorBuffer);
+    glDeleteRenderbuffers(NUM_WARMUP_TARGETS, depthBuffer);
+    glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+
+    if (prevBlend)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+
+    glUseProgram(0);
+    m_activeProgram = nullptr;
+
+    double warmUpTime = (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+    LOG_MESSAGE("[ShaderManager] Warm-up: " << programs.size() << " programs (" << drawCount << " draws) in " << warmUpTime << " ms");
 }
 
+void ShaderManager::InitParallelCompile()
+{
+    m_parallelCompile = SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile") ||
+                        SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile");
 
-// load all shaders
-void ShaderManager::LoadShaders()
+    if (!m_parallelCompile)
+        return;
+
+    // KHR and ARB entry points are identical, 0xFFFFFFFF lets the driver choose thread count
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR");
+
+    if (!maxThreads)
+        maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB");
+
+    if (maxThreads)
+        maxThreads(0xFFFFFFFF);
+}
+
+void ShaderManager::InitUniformBuffers()
+{
+    if (m_frameConstantsUbo)
+        return;
+
+    // each view slot is bound as a separate range, so it has to start at a valid offset
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_viewConstantsStride = (sizeof(ViewConstants) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &m_frameConstantsUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameConstantsUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameConstants), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FrameConstantsBinding, m_frameConstantsUbo);
+
+    glGenBuffers(1, &m_viewConstantsUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_viewConstantsUbo);
+    glBufferData(GL_UNIFORM_BUFFER, m_viewConstantsStride * MAX_VIEW_CONSTANTS, NULL, GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ShaderManager::UpdateFrameConstants(double time)
 {
-    LoadShader(BasicShader, "../common_res/Basic.vsh", "../common_res/Basic.fsh");
-    LoadShader(BasicShaderInstanced, "../common_res/BasicInstanced.vsh", "../common_res/Basic.fsh", "../common_res/BasicInstanced.gsh");
-    LoadShader(OVRFrustumShader, "../common_res/OVRFrustum.vsh", "../common_res/OVRFrustum.fsh");
-    LoadShader(FontShader, "../common_res/Font.vsh", "../common_res/Font.fsh");
-    LoadShader(BasicShaderNoTex, "../common_res/BasicNoTex.vsh", "../common_res/BasicNoTex.fsh");
+    if (m_frameConstants.frameCount == 0)
+        m_startTime = time;
+
+    float frameTime = (float)(time - m_startTime);
+
+    m_frameConstants.deltaTime = frameTime - m_frameConstants.time;
+    m_frameConstants.time      = frameTime;
+    m_frameConstants.frameCount++;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameConstantsUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameConstants), &m_frameConstants);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ShaderManager::UpdateViewConstants(int view, const ViewConstants &constants)
+{
+    LOG_MESSAGE_ASSERT(view >= 0 && view < MAX_VIEW_CONSTANTS, "Invalid view constants slot: " << view);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_viewConstantsUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, view * m_viewConstantsStride, sizeof(ViewConstants), &constants);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    BindViewConstants(view);
+}
+
+void ShaderManager::UpdateOverlayConstants(const GLfloat *projectionMatrix)
+{
+    ViewConstants constants;
+    memset(&constants, 0, sizeof(constants));
+    memcpy(constants.viewProjectionMatrix, projectionMatrix, sizeof(constants.viewProjectionMatrix));
+    memcpy(constants.projectionMatrix, projectionMatrix, sizeof(constants.projectionMatrix));
+
+    for (int i = 0; i < 4; i++)
+        constants.viewMatrix[i * 5] = 1.f;
+
+    constants.eyePosition[3] = 1.f;
+
+    UpdateViewConstants(OverlayView, constants);
+}
+
+void ShaderManager::BindViewConstants(int view)
+{
+    if (m_boundView == view)
+        return;
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, ViewConstantsBinding, m_viewConstantsUbo, view * m_viewConstantsStride, sizeof(ViewConstants));
+    m_boundView = view;
+}
+
+bool ShaderManager::LoadCompleted(ShaderName shaderName) const
+{
+    // no way to poll without the extension - report done and let the caller block
+    if (!m_parallelCompile)
+        return true;
+
+    GLint completed = GL_TRUE;
+    glGetProgramiv(m_shaderProgram[shaderName].id, GL_COMPLETION_STATUS_KHR, &completed);
+
+    return completed == GL_TRUE;
+}
+
+void ShaderManager::InitBinaryCache()
+{
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+
+    // some drivers expose no binary formats at all - always compile from source then
+    m_binaryCacheEnabled = numFormats > 0;
+
+    if (!m_binaryCacheEnabled)
+        return;
+
+    m_glStringsHash = HashString((const char *)glGetString(GL_VENDOR));
+    m_glStringsHash = HashString((const char *)glGetString(GL_RENDERER), m_glStringsHash);
+    m_glStringsHash = HashString((const char *)glGetString(GL_VERSION), m_glStringsHash);
+
+    CreateDirectoryA(binaryCacheDir, NULL);
+}
+
+bool ShaderManager::LoadProgramBinary(ShaderProgram &program, const std::string &cacheName, unsigned long long sourceHash)
+{
+    std::string filename = binaryCacheDir + cacheName + ".bin";
+    std::ifstream file(filename, std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    ProgramBinaryHeader header;
+    file.read((char *)&header, sizeof(header));
+
+    // stale binary (different sources or driver) - will be replaced after compiling
+    if (!file || header.magic != BINARY_CACHE_MAGIC || header.version != BINARY_CACHE_VERSION ||
+        header.glStringsHash != m_glStringsHash || header.sourceHash != sourceHash || header.binaryLength <= 0)
+    {
+        return false;
+    }
+
+    std::vector<char> binary(header.binaryLength);
+    file.read(&binary[0], header.binaryLength);
+
+    if (!file)
+        return false;
+
+    GLuint programId = glCreateProgram();
+    glProgramBinary(programId, header.binaryFormat, &binary[0], header.binaryLength);
+
+    // driver may still reject the binary (eg. after an update that didn't change the version string)
+    GLint linked;
+    glGetProgramiv(programId, GL_LINK_STATUS, &linked);
+
+    if (!linked)
+    {
+        glDeleteProgram(programId);
+        return false;
+    }
+
+    program.id = programId;
+
+    return true;
+}
+
+void ShaderManager::SaveProgramBinary(const ShaderProgram &program, const std::string &cacheName, unsigned long long sourceHash)
+{
+    ProgramBinaryHeader header;
+    header.magic         = BINARY_CACHE_MAGIC;
+    header.version       = BINARY_CACHE_VERSION;
+    header.glStringsHash = m_glStringsHash;
+    header.sourceHash    = sourceHash;
+    header.binaryLength  = 0;
+
+    glGetProgramiv(program.id, GL_PROGRAM_BINARY_LENGTH, &header.binaryLength);
+
+    if (header.binaryLength <= 0)
+        return;
+
+    std::vector<char> binary(header.binaryLength);
+    glGetProgramBinary(program.id, header.binaryLength, NULL, &header.binaryFormat, &binary[0]);
+
+    std::string filename = binaryCacheDir + cacheName + ".bin";
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+    {
+        LOG_MESSAGE("Cannot write shader cache file: " << filename);
+        return;
+    }
+
+    file.write((const char *)&header, sizeof(header));
+    file.write(&binary[0], header.binaryLength);
 }
 
 // use shader program
 const ShaderProgram& ShaderManager::UseShaderProgram(ShaderName type)
 {
-    if (m_activeShader != type)
+    const ShaderProgram &program = m_shaderProgram[ResolveShader(type)];
+    ActivateProgram(program);
+
+    return program;
+}
+
+const ShaderProgram& ShaderManager::UseShaderVariant(unsigned int features)
+{
+    const ShaderProgram &program = GetShaderVariant(features);
+    ActivateProgram(program);
+
+    return program;
+}
+
+void ShaderManager::ActivateProgram(const ShaderProgram &program)
+{
+    if (m_activeProgram != &program)
     {
-        m_activeShader = type;
-        glUseProgram(m_shaderProgram[type].id);
+        m_activeProgram = &program;
+        glUseProgram(program.id);
+    }
+}
+
+const ShaderProgram& ShaderManager::GetShaderVariant(unsigned int features)
+{
+    auto it = m_variants.find(features);
+
+    if (it == m_variants.end())
+    {
+        // named programs built from the variant source can be shared
+        for (int i = 0; i < NUM_SHADERS; i++)
+        {
+            if (shaderFiles[i].vsh == variantVsh && shaderFiles[i].features == features && m_loadState[i] == Load_Ready)
+                return m_shaderProgram[i];
+        }
+
+        LOG_MESSAGE_ASSERT(!(features & Feature_InstancedStereo) || !(features & Feature_Multiview), "Instanced stereo and multiview variants are exclusive");
+
+        char cacheName[32];
+        sprintf(cacheName, "variant%02x", features);
+
+        // first use - compile right away, the binary cache makes this cheap on following launches
+        ShaderProgram &program = m_variants[features];
+        unsigned long long sourceHash = 0;
+        const char *gsh = (features & Feature_InstancedStereo) ? variantGsh : "";
+        const ShaderProgram *prevActive = m_activeProgram;
+        Uint64 startTime = SDL_GetPerformanceCounter();
+
+        if (features & Feature_Multiview && !SDL_GL_ExtensionSupported("GL_OVR_multiview2"))
+        {
+            LOG_MESSAGE("[ShaderManager] GL_OVR_multiview2 not supported, variant " << cacheName << " unavailable");
+        }
+        else if (features & Feature_Bindless && !GLEW_ARB_bindless_texture)
+        {
+            LOG_MESSAGE("[ShaderManager] GL_ARB_bindless_texture not supported, variant " << cacheName << " unavailable");
+        }
+        else
+        {
+            if (BeginLoadProgram(program, variantVsh, variantFsh, gsh, features, cacheName, &sourceHash))
+                m_cachedProgramCount++;
+
+            FinishLoadProgram(program, cacheName, sourceHash);
+
+            LOG_MESSAGE("[ShaderManager] Loaded " << cacheName << " in " << (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency() << " ms");
+        }
+
+        // finishing the load binds the program - restore previous state
+        if (prevActive)
+            glUseProgram(prevActive->id);
+
+        m_activeProgram = prevActive;
+        it = m_variants.find(features);
     }
 
-    return m_shaderProgram[type];
+    // failed variants resolve to fallback program
+    return it->second.id ? it->second : m_shaderProgram[FallbackShader];
 }
 
 void ShaderManager::DisableShader()
 {
     glUseProgram(0);
-    m_activeShader = NUM_SHADERS;
+    m_activeProgram = nullptr;
 }
 
-std::string ShaderManager::ReadShaderFromFile(const char *filename)
+static bool CompareBundledShader(const BundledShader &shader, const char *name)
 {
-    std::ifstream file(filename);
+    return strcmp(shader.name, name) < 0;
+}
 
-    if (!file.is_open())
+ShaderSourceView ShaderManager::GetShaderSource(const char *name)
+{
+    if (m_looseShaderFiles)
+    {
+        ShaderSourceView source = ReadShaderFromFile(name);
+
+        if (source.data)
+            return source;
+    }
+
+    const BundledShader *end    = shaderBundle + shaderBundleCount;
+    const BundledShader *shader = std::lower_bound(shaderBundle, end, name, CompareBundledShader);
+
+    if (shader == end || strcmp(shader->name, name) != 0)
     {
-        LOG_MESSAGE_ASSERT(false, "Cannot open input file: " << filename);
-        return NULL;
+        LOG_MESSAGE_ASSERT(false, "Shader not found in bundle: " << name);
+        ShaderSourceView empty = { "", 0 };
+        return empty;
     }
 
-    std::string shaderSrc;
-    std::string readStr;
+    ShaderSourceView source = { shader->source, shader->length };
+    return source;
+}
+
+// dev override - lets shaders be edited without rebuilding the bundle
+ShaderSourceView ShaderManager::ReadShaderFromFile(const char *name)
+{
+    std::string filename = std::string(looseShaderDir) + name;
+    std::ifstream file(filename, std::ios::binary);
 
-    while (!file.eof())
+    if (!file.is_open())
     {
-        std::getline(file, readStr);
-        shaderSrc.append(readStr);
-        shaderSrc.append("\n");
+        LOG_MESSAGE("Cannot open input file: " << filename << " - using bundled shader");
+        ShaderSourceView missing = { NULL, 0 };
+        return missing;
     }
 
-    file.close();
+    // read whole file at once, storage is kept so the returned view stays valid
+    std::string &shaderSrc = m_looseSources[name];
+
+    file.seekg(0, std::ios::end);
+    shaderSrc.resize((size_t)file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(&shaderSrc[0], shaderSrc.size());
 
-    return shaderSrc;
+    ShaderSourceView source = { shaderSrc.data(), shaderSrc.size() };
+    return source;
 }
 
+void ShaderManager::SplitShaderSource(const ShaderSourceView &source, const std::string &defines, ShaderSourceParts *parts)
+{
+    // defines must follow the #version directive
+    const char *end        = source.data + source.length;
+    const char *versionEnd = std::search(source.data, end, "#version", "#version" + 8);
+
+    if (versionEnd != end)
+        versionEnd = std::find(versionEnd, end, '\n');
+
+    if (versionEnd != end)
+        versionEnd++;
+    else
+        versionEnd = source.data;
 
-void ShaderManager::CompileShader(GLuint *newShader, GLenum shaderType, const char *shaderSrc)
+    parts->strings[0] = source.data;
+    parts->lengths[0] = (GLint)(versionEnd - source.data);
+    parts->strings[1] = defines.c_str();
+    parts->lengths[1] = (GLint)defines.size();
+    parts->strings[2] = versionEnd;
+    parts->lengths[2] = (GLint)(end - versionEnd);
+}
+
+void ShaderManager::CompileShader(GLuint *newShader, GLenum shaderType, const ShaderSourceParts &parts)
 {
     /* Create and compile the shader object */
     *newShader = glCreateShader(shaderType);
 
-    glShaderSource(*newShader, 1, &shaderSrc, NULL);
+    glShaderSource(*newShader, 3, parts.strings, parts.lengths);
     glCompileShader(*newShader);
+}
 
+bool ShaderManager::CheckShaderCompiled(GLuint *shader)
+{
     /* Test if compilation succeeded */
     GLint ShaderCompiled;
-    glGetShaderiv(*newShader, GL_COMPILE_STATUS, &ShaderCompiled);
+    glGetShaderiv(*shader, GL_COMPILE_STATUS, &ShaderCompiled);
 
     if (!ShaderCompiled)
     {
         int i32InfoLogLength, i32CharsWritten;
-        glGetShaderiv(*newShader, GL_INFO_LOG_LENGTH, &i32InfoLogLength);
+        glGetShaderiv(*shader, GL_INFO_LOG_LENGTH, &i32InfoLogLength);
         char* pszInfoLog = new char[i32InfoLogLength];
-        glGetShaderInfoLog(*newShader, i32InfoLogLength, &i32CharsWritten, pszInfoLog);
+        glGetShaderInfoLog(*shader, i32InfoLogLength, &i32CharsWritten, pszInfoLog);
         LOG_MESSAGE_ASSERT(false, pszInfoLog);
 
         delete[] pszInfoLog;
-        glDeleteShader(*newShader);
+        glDeleteShader(*shader);
+        *shader = 0;
     }
+
+    return ShaderCompiled == GL_TRUE;
 }
 
 // create the actual shader program
-bool ShaderManager::LinkShader(GLuint* const pProgramObject,
+void ShaderManager::LinkShader(GLuint* const pProgramObject,
                                const GLuint VertexShader,
                                const GLuint FragmentShader,
                                const GLuint GeometryShader)
 {
     *pProgramObject = glCreateProgram();
 
+    if (m_binaryCacheEnabled)
+        glProgramParameteri(*pProgramObject, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
     glAttachShader(*pProgramObject, VertexShader);
     if (GeometryShader > 0)
         glAttachShader(*pProgramObject, GeometryShader);
@@ -134,53 +834,221 @@ bool ShaderManager::LinkShader(GLuint* const pProgramObject,
     glAttachShader(*pProgramObject, FragmentShader);
 
     // Link the program object
-    GLint Linked;
     glLinkProgram(*pProgramObject);
-    glGetProgramiv(*pProgramObject, GL_LINK_STATUS, &Linked);
+}
+
+bool ShaderManager::CheckProgramLinked(GLuint program)
+{
+    GLint Linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &Linked);
 
     if (!Linked)
     {
         int i32InfoLogLength, i32CharsWritten;
-        glGetProgramiv(*pProgramObject, GL_INFO_LOG_LENGTH, &i32InfoLogLength);
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &i32InfoLogLength);
         char* pszInfoLog = new char[i32InfoLogLength];
-        glGetProgramInfoLog(*pProgramObject, i32InfoLogLength, &i32CharsWritten, pszInfoLog);
+        glGetProgramInfoLog(program, i32InfoLogLength, &i32CharsWritten, pszInfoLog);
         LOG_MESSAGE_ASSERT(false, pszInfoLog);
 
         delete[] pszInfoLog;
         return false;
     }
 
-    glUseProgram(*pProgramObject);
-
     return true;
 }
 
 
-void ShaderManager::LoadShader(ShaderName shaderName, const char* vshFilename, const char *fshFilename, const char *gshFilename)
+void ShaderManager::BeginLoadShader(ShaderName shaderName)
+{
+    char cacheName[32];
+    sprintf(cacheName, "program%02d", (int)shaderName);
+
+    m_loadState[shaderName] = Load_Pending;
+    m_pendingCount++;
+
+    if (BeginLoadProgram(m_shaderProgram[shaderName], shaderFiles[shaderName].vsh, shaderFiles[shaderName].fsh, shaderFiles[shaderName].gsh,
+                         shaderFiles[shaderName].features, cacheName, &m_sourceHash[shaderName]))
+    {
+        m_cachedProgramCount++;
+    }
+}
+
+void ShaderManager::FinishLoadShader(ShaderName shaderName)
+{
+    char cacheName[32];
+    sprintf(cacheName, "program%02d", (int)shaderName);
+
+    m_pendingCount--;
+    m_loadState[shaderName] = FinishLoadProgram(m_shaderProgram[shaderName], cacheName, m_sourceHash[shaderName]) ? Load_Ready : Load_Failed;
+}
+
+bool ShaderManager::BeginLoadProgram(ShaderProgram &program, const char *vsh, const char *fsh, const char *gsh, unsigned int features,
+                                     const std::string &cacheName, unsigned long long *sourceHash)
 {
-    std::string vShaderSrc = ReadShaderFromFile(vshFilename);
-    std::string fShaderSrc = ReadShaderFromFile(fshFilename);
+    std::string defines;
+
+    for (int i = 0; i < NUM_FEATURES; i++)
+    {
+        if (features & (1 << i))
+            defines += std::string("#define ") + featureDefines[i] + "\n";
+    }
 
-    CompileShader(&m_shaderProgram[shaderName].vertShader, GL_VERTEX_SHADER, vShaderSrc.c_str());
+    // sources are referenced in place, defines are passed to the driver as a separate string
+    ShaderSourceParts vShaderSrc, fShaderSrc, gShaderSrc;
+    bool hasGeometryShader = strlen(gsh) > 0;
+
+    SplitShaderSource(GetShaderSource(vsh), defines, &vShaderSrc);
+    SplitShaderSource(GetShaderSource(fsh), defines, &fShaderSrc);
+
+    if (hasGeometryShader)
+        SplitShaderSource(GetShaderSource(gsh), defines, &gShaderSrc);
+
+    // cache key covers all stages (with injected defines), a change in any of them invalidates the binary
+    *sourceHash = HashSource(GL_VERTEX_SHADER, vShaderSrc, 14695981039346656037ULL);
+    *sourceHash = hasGeometryShader ? HashSource(GL_GEOMETRY_SHADER, gShaderSrc, *sourceHash) : *sourceHash;
+    *sourceHash = HashSource(GL_FRAGMENT_SHADER, fShaderSrc, *sourceHash);
+
+    if (m_binaryCacheEnabled && LoadProgramBinary(program, cacheName, *sourceHash))
+        return true;
+
+    // no status queries here - they would wait for the driver to finish compiling
+    CompileShader(&program.vertShader, GL_VERTEX_SHADER, vShaderSrc);
+
+    if (hasGeometryShader)
+        CompileShader(&program.geomShader, GL_GEOMETRY_SHADER, gShaderSrc);
+
+    CompileShader(&program.fragShader, GL_FRAGMENT_SHADER, fShaderSrc);
+
+    LinkShader(&program.id, program.vertShader, program.fragShader, program.geomShader);
+
+    return false;
+}
 
-    if (strlen(gshFilename) > 0)
+bool ShaderManager::FinishLoadProgram(ShaderProgram &program, const std::string &cacheName, unsigned long long sourceHash)
+{
+    // programs loaded from binary cache have no shader objects and are already checked
+    if (program.vertShader)
     {
-        std::string gShaderSrc = ReadShaderFromFile(gshFilename);
-        CompileShader(&m_shaderProgram[shaderName].geomShader, GL_GEOMETRY_SHADER, gShaderSrc.c_str());
+        bool compiled = CheckShaderCompiled(&program.vertShader);
+
+        if (program.geomShader)
+            compiled &= CheckShaderCompiled(&program.geomShader);
+
+        compiled &= CheckShaderCompiled(&program.fragShader);
+
+        // failed program and its stages are never used - the name resolves to the fallback program
+        if (!compiled || !CheckProgramLinked(program.id))
+        {
+            DeleteProgram(program);
+            program = ShaderProgram();
+            return false;
+        }
+
+        if (m_binaryCacheEnabled)
+            SaveProgramBinary(program, cacheName, sourceHash);
     }
 
-    CompileShader(&m_shaderProgram[shaderName].fragShader, GL_FRAGMENT_SHADER, fShaderSrc.c_str());
+    glUseProgram(program.id);
+    m_activeProgram = &program;
 
-    LinkShader(&m_shaderProgram[shaderName].id, 
-                m_shaderProgram[shaderName].vertShader, 
-                m_shaderProgram[shaderName].fragShader,
-                m_shaderProgram[shaderName].geomShader);
+    ReflectProgram(program);
 
-    glUniform1i(glGetUniformLocation(m_shaderProgram[shaderName].id, "sTexture"), 0);  // Texture unit 0 is the primary texture.
+    glUniform1i(program.GetUniformLocation(SHADER_VAR("sTexture")), 0);     // Texture unit 0 is the primary texture.
+    glUniform1i(program.GetUniformLocation(SHADER_VAR("sAuxTexture")), 1);  // Texture unit 1 is the auxiliary texture.
+    glUniform1i(program.GetUniformLocation(SHADER_VAR("sTextureArray")), 0); // Texture arrays are bound to unit 0 as well.
 
-    // Store the location of uniforms for later use
+    // Store the location of common uniforms for direct access
     for (int j = 0; j < NUM_UNIFORMS; ++j)
     {
-        m_shaderProgram[shaderName].uniforms[j] = glGetUniformLocation(m_shaderProgram[shaderName].id, uniformNames[j]);
+        program.uniforms[j] = program.GetUniformLocation(ShaderHash(uniformNames[j]));
+    }
+
+    // shared blocks are always at the same binding point, so buffers never need rebinding per program
+    for (int j = 0; j < NUM_UNIFORM_BINDINGS; ++j)
+    {
+        GLint blockIdx = program.GetUniformBlockIndex(ShaderHash(uniformBlockNames[j]));
+
+        if (blockIdx >= 0)
+            glUniformBlockBinding(program.id, blockIdx, j);
+    }
+
+    // uniforms default to zero - model matrix has to start as identity
+    if (program.uniforms[ModelMatrix] >= 0)
+    {
+        const GLfloat identity[16] = { 1.f, 0.f, 0.f, 0.f,
+                                       0.f, 1.f, 0.f, 0.f,
+                                       0.f, 0.f, 1.f, 0.f,
+                                       0.f, 0.f, 0.f, 1.f };
+        glUniformMatrix4fv(program.uniforms[ModelMatrix], 1, GL_FALSE, identity);
+    }
+
+    return true;
+}
+
+static bool CompareVariables(const ShaderVariable &a, const ShaderVariable &b)
+{
+    return a.hash < b.hash;
+}
+
+void ShaderManager::ReflectProgram(ShaderProgram &program)
+{
+    GLint count;
+    char  name[256];
+
+    program.variables.clear();
+
+    // attributes
+    glGetProgramiv(program.id, GL_ACTIVE_ATTRIBUTES, &count);
+
+    for (GLint i = 0; i < count; i++)
+    {
+        ShaderVariable var;
+        glGetActiveAttrib(program.id, i, sizeof(name), NULL, &var.size, &var.type, name);
+
+        var.hash     = ShaderHash(name);
+        var.kind     = ShaderVariable::Attribute;
+        var.location = glGetAttribLocation(program.id, name);
+        program.variables.push_back(var);
     }
+
+    // default block uniforms (uniform block members have no location)
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &count);
+
+    for (GLint i = 0; i < count; i++)
+    {
+        ShaderVariable var;
+        glGetActiveUniform(program.id, i, sizeof(name), NULL, &var.size, &var.type, name);
+
+        var.location = glGetUniformLocation(program.id, name);
+
+        if (var.location < 0)
+            continue;
+
+        // arrays are reported as "name[0]" - store them under plain name
+        char *bracket = strchr(name, '[');
+        if (bracket)
+            *bracket = '\0';
+
+        var.hash = ShaderHash(name);
+        var.kind = ShaderVariable::Uniform;
+        program.variables.push_back(var);
+    }
+
+    // uniform blocks
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+
+    for (GLint i = 0; i < count; i++)
+    {
+        ShaderVariable var;
+        glGetActiveUniformBlockName(program.id, i, sizeof(name), NULL, name);
+        glGetActiveUniformBlockiv(program.id, i, GL_UNIFORM_BLOCK_DATA_SIZE, &var.size);
+
+        var.hash     = ShaderHash(name);
+        var.kind     = ShaderVariable::UniformBlock;
+        var.location = i;
+        var.type     = 0;
+        program.variables.push_back(var);
+    }
+
+    std::sort(program.variables.begin(), program.variables.end(), CompareVariables);
 }
\ No newline at end of file
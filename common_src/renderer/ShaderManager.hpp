@@ -3,6 +3,9 @@
 
 #include "renderer/OpenGL.hpp"
 #include "renderer/Shader.hpp"
+#include "renderer/ShaderBundle.hpp"
+#include <cstring>
+#include <map>
 #include <string>
 
 class ShaderManager
@@ -16,32 +19,155 @@ public:
         OVRFrustumShader,
         FontShader,
         BasicShaderNoTex,
+        RadialMaskShader,
+        RadialReconstructShader,
+        FarFieldShader,
+        ReprojectShader,
+        ReprojectTilesShader,
+        ReprojectCompositeShader,
+        ReprojectDiffShader,
+        MultiResCompositeShader,
         NUM_SHADERS
     };
 
+    // BasicVariant features - each set bit is injected into the sources as a FEATURE_* define
+    enum ShaderFeature
+    {
+        Feature_Textured        = 1 << 0,   // sample sTexture at texCoord
+        Feature_VertexColor     = 1 << 1,   // per vertex color attribute
+        Feature_InstancedStereo = 1 << 2,   // view picked by gl_InstanceID, geometry shader routes it to viewport array
+        Feature_MSAA            = 1 << 3,   // centroid sampled varyings
+        Feature_Multiview       = 1 << 4,   // view picked by gl_ViewID_OVR (GL_OVR_multiview2)
+        Feature_TextureArray    = 1 << 5,   // sample a texture array layer picked by per instance inTextureIndex
+        Feature_Bindless        = 1 << 6,   // texture array picked from TextureArrays block (GL_ARB_bindless_texture)
+        NUM_FEATURES            = 7
+    };
+
+    // ViewConstants slots: one per rendered view (eyes first), the last one is reserved for 2D overlays
+    static const int MAX_VIEW_CONSTANTS = 17;
+    static const int OverlayView        = MAX_VIEW_CONSTANTS - 1;
+
     static ShaderManager* GetInstance();
 
     void LoadShaders();
+    void LoadShadersAsync();   // issue all compiles and return - programs become available in UpdateAsyncLoad()
+    void UpdateAsyncLoad();    // call once per frame, never blocks when GL_KHR_parallel_shader_compile is supported
+    bool AsyncLoadPending() const { return m_pendingCount > 0; }
+    bool IsShaderReady(ShaderName type) const { return m_loadState[type] == Load_Ready; }
     void DestroyShaders();
 
-    const ShaderProgram& GetShaderProgram(ShaderName type) const { return m_shaderProgram[type]; }
-    const ShaderProgram& GetActiveShader() const { return m_shaderProgram[m_activeShader]; }
+    // programs still being compiled resolve to fallback program
+    const ShaderProgram& GetShaderProgram(ShaderName type) const { return m_shaderProgram[ResolveShader(type)]; }
+    const ShaderProgram& GetActiveShader() const { return *m_activeProgram; }
     const ShaderProgram& UseShaderProgram(ShaderName type);
+
+    // specialized BasicVariant programs (ShaderFeature bitmask), compiled on first request and cached
+    const ShaderProgram& GetShaderVariant(unsigned int features);
+    const ShaderProgram& UseShaderVariant(unsigned int features);
     void  DisableShader();
+
+    // shared uniform blocks - updated once per frame/view instead of per program
+    void  UpdateFrameConstants(double time);
+    void  UpdateViewConstants(int view, const ViewConstants &constants);   // upload and bind view slot
+    void  UpdateOverlayConstants(const GLfloat *projectionMatrix);        // 2D rendering, view is identity
+    void  BindViewConstants(int view);
+    int   GetBoundView() const { return m_boundView; }
+
+    // read shaders from ../common_res/ instead of the embedded bundle (default in debug builds)
+    void  SetLooseShaderFiles(bool val) { m_looseShaderFiles = val; }
+
+    // shader source split around injected defines: [#version line, defines, rest of source]
+    struct ShaderSourceParts
+    {
+        const GLchar *strings[3];
+        GLint         lengths[3];
+    };
 private:
-    ShaderManager() : m_activeShader(NUM_SHADERS)
+    enum LoadState
     {
+        Load_None,
+        Load_Pending,
+        Load_Ready,
+        Load_Failed
+    };
+
+    ShaderManager() : m_activeProgram(nullptr), m_binaryCacheEnabled(false), m_glStringsHash(0), m_cachedProgramCount(0),
+                      m_parallelCompile(false), m_pendingCount(0), m_asyncStartTime(0),
+                      m_frameConstantsUbo(0), m_viewConstantsUbo(0), m_viewConstantsStride(0), m_boundView(-1), m_startTime(0)
+    {
+#ifdef _DEBUG
+        m_looseShaderFiles = true;
+#else
+        m_looseShaderFiles = false;
+#endif
+        memset(&m_frameConstants, 0, sizeof(m_frameConstants));
+
+        for (int i = 0; i < NUM_SHADERS; i++)
+        {
+            m_loadState[i]  = Load_None;
+            m_sourceHash[i] = 0;
+        }
     }
 
     ~ShaderManager();
 
-    std::string ReadShaderFromFile(const char *filename);
-    void CompileShader(GLuint *newShader, GLenum shaderType, const char *shaderSrc);
-    void LoadShader(ShaderName shaderName, const char* vshFilename, const char *fshFilename, const char *gshFilename="");
-    bool LinkShader(GLuint* const pProgramObject, const GLuint VertexShader, const GLuint FragmentShader, const GLuint GeometryShader);
+    ShaderSourceView GetShaderSource(const char *name);      // bundled or loose file source
+    ShaderSourceView ReadShaderFromFile(const char *name);   // NULL data if file is missing
+    void SplitShaderSource(const ShaderSourceView &source, const std::string &defines, ShaderSourceParts *parts);
+    void CompileShader(GLuint *newShader, GLenum shaderType, const ShaderSourceParts &parts);
+    bool CheckShaderCompiled(GLuint *shader);
+    void LinkShader(GLuint* const pProgramObject, const GLuint VertexShader, const GLuint FragmentShader, const GLuint GeometryShader);
+    bool CheckProgramLinked(GLuint program);
+
+    // program loading is split, so that all compiles can be issued before any status is queried
+    void BeginLoadShader(ShaderName shaderName);
+    bool LoadCompleted(ShaderName shaderName) const;
+    void FinishLoadShader(ShaderName shaderName);
+    bool BeginLoadProgram(ShaderProgram &program, const char *vsh, const char *fsh, const char *gsh, unsigned int features,
+                          const std::string &cacheName, unsigned long long *sourceHash);   // true if loaded from binary cache
+    bool FinishLoadProgram(ShaderProgram &program, const std::string &cacheName, unsigned long long sourceHash);
+    void ActivateProgram(const ShaderProgram &program);
+    void ReflectProgram(ShaderProgram &program);   // fill program variable table
+    void InitParallelCompile();
+    void InitUniformBuffers();
+    void WarmUpShaders();   // off-screen draw per program and render state, so first use doesn't hitch
+    ShaderName ResolveShader(ShaderName type) const { return m_loadState[type] == Load_Ready ? type : FallbackShader; }
+
+    static const ShaderName FallbackShader = BasicShaderNoTex;
+
+    // program binary cache
+    void InitBinaryCache();
+    bool LoadProgramBinary(ShaderProgram &program, const std::string &cacheName, unsigned long long sourceHash);
+    void SaveProgramBinary(const ShaderProgram &program, const std::string &cacheName, unsigned long long sourceHash);
+
+    const ShaderProgram *m_activeProgram;
+    ShaderProgram        m_shaderProgram[NUM_SHADERS];
+
+    // loose shader files (dev override), storage for returned source views
+    bool                               m_looseShaderFiles;
+    std::map<std::string, std::string> m_looseSources;
+
+    // compiled variants keyed by feature mask, failed ones are kept with id 0 so they're not retried
+    std::map<unsigned int, ShaderProgram> m_variants;
+
+    bool               m_binaryCacheEnabled;
+    unsigned long long m_glStringsHash;        // GL vendor, renderer and version - binaries are only valid for the same driver
+    int                m_cachedProgramCount;   // programs loaded from cache during last LoadShaders()
+
+    // asynchronous loading
+    LoadState          m_loadState[NUM_SHADERS];
+    unsigned long long m_sourceHash[NUM_SHADERS];
+    bool               m_parallelCompile;      // GL_KHR/ARB_parallel_shader_compile available
+    int                m_pendingCount;
+    unsigned long long m_asyncStartTime;
 
-    ShaderName    m_activeShader;
-    ShaderProgram m_shaderProgram[NUM_SHADERS];
+    // shared uniform buffers
+    GLuint             m_frameConstantsUbo;
+    GLuint             m_viewConstantsUbo;
+    GLint              m_viewConstantsStride;   // sizeof(ViewConstants) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    int                m_boundView;
+    FrameConstants     m_frameConstants;
+    double             m_startTime;
 };
 
 #endif
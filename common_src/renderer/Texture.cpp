@@ -1,8 +1,9 @@
 #include "renderer/Texture.hpp"
 #include "stb_image/stb_image.h"
+#include <algorithm>
 
 
-Texture::Texture(const char *filename) : m_texId(0), m_releaseData(true)
+Texture::Texture(const char *filename) : m_numLevels(0), m_byteSize(0), m_texId(0), m_releaseData(true), m_resident(false)
 {
     m_textureData = stbi_load(filename, &m_width, &m_height, &m_components, 0);
     m_format = m_components == 3 ? GL_RGB : GL_RGBA;
@@ -15,11 +16,28 @@ Texture::Texture(unsigned char *data, int width, int height, int components, int
                                                                                                                m_textureData(data), 
                                                                                                                m_format(format),
                                                                                                                m_internalFormat(internalFormat),
+                                                                                                               m_numLevels(0),
+                                                                                                               m_byteSize(0),
                                                                                                                m_releaseData(false),
+                                                                                                               m_resident(false),
                                                                                                                m_texId(0)
 {
 }
 
+Texture::Texture() : m_width(0),
+                     m_height(0),
+                     m_components(0),
+                     m_textureData(NULL),
+                     m_format(GL_RGBA),
+                     m_internalFormat(GL_RGBA),
+                     m_numLevels(0),
+                     m_byteSize(0),
+                     m_releaseData(true),
+                     m_resident(false),
+                     m_texId(0)
+{
+}
+
 
 Texture::~Texture()
 {
@@ -32,21 +50,28 @@ Texture::~Texture()
     }
 }
 
-GLuint Texture::Load()
+GLuint Texture::Load(bool mipmaps)
 {
     // texture was already bound or could not be loaded - return texId/0
     if (m_textureData == nullptr)
         return m_texId;
 
-    glGenTextures(1, &m_texId);
-    glBindTexture(GL_TEXTURE_2D, m_texId);
+    // reloading data that is kept around (e.g. camera images) replaces the previous texture object
+    if (glIsTexture(m_texId))
+        glDeleteTextures(1, &m_texId);
+
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, m_internalFormat, m_width, m_height, 0, m_format, GL_UNSIGNED_BYTE, m_textureData);
+    if (CreateTexture(mipmaps ? MipLevelCount(m_width, m_height) : 1))
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, m_format, GL_UNSIGNED_BYTE, m_textureData);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, m_internalFormat, m_width, m_height, 0, m_format, GL_UNSIGNED_BYTE, m_textureData);
+
+    if (m_numLevels > 1)
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+    m_byteSize = StorageSize(m_width, m_height, m_components, m_numLevels);
+    m_resident = true;
 
     if (m_releaseData)
     {
@@ -55,4 +80,128 @@ GLuint Texture::Load()
     }
 
     return m_texId;
-}
\ No newline at end of file
+}
+
+void Texture::SetFiltering(bool mipmaps, float anisotropy)
+{
+    if (!m_texId)
+        return;
+
+    // single level textures (no mip chain or mipmaps turned off) are plain bilinear
+    bool useMipmaps = mipmaps && m_numLevels > 1;
+
+    glBindTexture(GL_TEXTURE_2D, m_texId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, useMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+    if (GLEW_EXT_texture_filter_anisotropic)
+    {
+        GLfloat maxAnisotropy = 1.f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, useMipmaps ? (anisotropy < maxAnisotropy ? anisotropy : maxAnisotropy) : 1.f);
+    }
+}
+
+void Texture::Unload()
+{
+    if (glIsTexture(m_texId))
+        glDeleteTextures(1, &m_texId);
+
+    m_texId    = 0;
+    m_resident = false;
+}
+
+void Texture::Swap(Texture &other)
+{
+    std::swap(m_width, other.m_width);
+    std::swap(m_height, other.m_height);
+    std::swap(m_components, other.m_components);
+    std::swap(m_format, other.m_format);
+    std::swap(m_internalFormat, other.m_internalFormat);
+    std::swap(m_numLevels, other.m_numLevels);
+    std::swap(m_byteSize, other.m_byteSize);
+    std::swap(m_releaseData, other.m_releaseData);
+    std::swap(m_resident, other.m_resident);
+    std::swap(m_texId, other.m_texId);
+    std::swap(m_textureData, other.m_textureData);
+}
+
+int Texture::MipLevelCount(int width, int height)
+{
+    int numLevels = 1;
+
+    while (width > 1 || height > 1)
+    {
+        width  >>= 1;
+        height >>= 1;
+        numLevels++;
+    }
+
+    return numLevels;
+}
+
+size_t Texture::StorageSize(int width, int height, int components, int numLevels)
+{
+    size_t size = 0;
+
+    for (int i = 0; i < numLevels; i++)
+        size += (size_t)((std::max)(width >> i, 1)) * (std::max)(height >> i, 1) * components;
+
+    return size;
+}
+
+void Texture::DownsampleLevel(const unsigned char *src, int srcWidth, int srcHeight, unsigned char *dst, int dstWidth, int dstHeight, int components)
+{
+    for (int y = 0; y < dstHeight; y++)
+    {
+        const unsigned char *row0 = src + (std::min)(y * 2,     srcHeight - 1) * srcWidth * components;
+        const unsigned char *row1 = src + (std::min)(y * 2 + 1, srcHeight - 1) * srcWidth * components;
+
+        for (int x = 0; x < dstWidth; x++)
+        {
+            int x0 = (std::min)(x * 2,     srcWidth - 1) * components;
+            int x1 = (std::min)(x * 2 + 1, srcWidth - 1) * components;
+
+            for (int c = 0; c < components; c++)
+                *dst++ = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+        }
+    }
+}
+
+GLenum Texture::SizedFormat(GLenum internalFormat)
+{
+    // unsized formats are mapped, legacy formats have no sized equivalent usable with immutable storage
+    switch (internalFormat)
+    {
+    case GL_RGBA:      return GL_RGBA8;
+    case GL_RGB:       return GL_RGB8;
+    case GL_RG:        return GL_RG8;
+    case GL_RED:       return GL_R8;
+    case GL_LUMINANCE:
+    case GL_LUMINANCE_ALPHA:
+    case GL_ALPHA:     return 0;
+    default:           return internalFormat;
+    }
+}
+
+bool Texture::CreateTexture(int numLevels)
+{
+    m_numLevels = numLevels;
+
+    glGenTextures(1, &m_texId);
+    glBindTexture(GL_TEXTURE_2D, m_texId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+
+    // immutable storage needs a sized format
+    GLenum sizedFormat = SizedFormat(m_internalFormat);
+
+    if (!sizedFormat || !GLEW_ARB_texture_storage)
+        return false;
+
+    glTexStorage2D(GL_TEXTURE_2D, numLevels, sizedFormat, m_width, m_height);
+
+    return true;
+}
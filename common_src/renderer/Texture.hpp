@@ -3,6 +3,9 @@
 
 #include "renderer/OpenGL.hpp"
 
+// generational handle to a texture owned by TextureManager (0 is never valid)
+typedef unsigned int TextureHandle;
+
 /*
  *  Basic texture
  */
@@ -11,22 +14,44 @@ class Texture
 public:
     Texture(const char *filename);
     Texture(unsigned char *data, int width, int height, int components, int format, int internalFormat);
+    Texture();   // empty texture, filled in by TextureManager::LoadTextureAsync()
     ~Texture();
 
-    GLuint Load();
+    GLuint Load(bool mipmaps = false);   // upload decoded data, mip chain only on request - skip it for textures reloaded every frame
+    void   SetFiltering(bool mipmaps, float anisotropy);   // texture is left bound, anisotropy (clamped to hardware limit) only applies with mipmaps
+    void   Unload();   // free GPU storage, size and format are kept so texture can be reloaded
+    void   Swap(Texture &other);   // exchange GL texture object and all its data - textures own GL objects, so they can't be copied
+
+    static int    MipLevelCount(int width, int height);
+    static size_t StorageSize(int width, int height, int components, int numLevels);   // all levels of an uncompressed 8-bit texture
+    static GLenum SizedFormat(GLenum internalFormat);   // for immutable storage - 0 if legacy format keeps mutable storage
+    static void   DownsampleLevel(const unsigned char *src, int srcWidth, int srcHeight, unsigned char *dst, int dstWidth, int dstHeight, int components);   // 2x2 box filter, last row/column is repeated for odd sizes
 
     const int Width()      const { return m_width; }
     const int Height()     const { return m_height; }
     const int Components() const { return m_components; }
     const GLuint Id()      const { return m_texId; }
+    const bool Resident()  const { return m_resident; }   // pixel data is fully uploaded
+    const int NumLevels()  const { return m_numLevels; }
+    const size_t ByteSize() const { return m_byteSize; }  // GPU storage of all levels (compressed size for block formats)
     
 private:
+    friend class TextureManager;
+
+    Texture(const Texture &) = delete;
+    Texture& operator=(const Texture &) = delete;
+
+    bool CreateTexture(int numLevels);   // generate and bind texture object - true if immutable storage was allocated
+
     int    m_width;
     int    m_height;
     int    m_components;
     int    m_format;
     int    m_internalFormat;
+    int    m_numLevels;
+    size_t m_byteSize;
     bool   m_releaseData;     // should data release be handled automatically?
+    bool   m_resident;
     GLuint m_texId;
     unsigned char *m_textureData;    
 };
@@ -0,0 +1,235 @@
+#include "renderer/TextureAtlas.hpp"
+#include "renderer/TextureManager.hpp"
+#include "stb_image/stb_image.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+
+
+TextureAtlas::TextureAtlas(int pageSize, int padding) : m_pageSize(pageSize), m_padding(padding), m_numLevels(1)
+{
+    LOG_MESSAGE_ASSERT((padding & (padding - 1)) == 0, "Atlas padding must be a power of two: " << padding);
+
+    // level n of an image block still has a gutter of padding >> n texels
+    while ((1 << m_numLevels) <= padding)
+        m_numLevels++;
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    for (size_t i = 0; i < m_pages.size(); i++)
+        TextureManager::GetInstance()->ReleaseTexture(m_pages[i].handle);
+}
+
+bool TextureAtlas::Insert(const char *textureName, AtlasRegion *region)
+{
+    std::map<std::string, AtlasRegion>::const_iterator it = m_regions.find(textureName);
+
+    if (it != m_regions.end())
+    {
+        *region = it->second;
+        return true;
+    }
+
+    int width, height, components;
+    unsigned char *rgba = stbi_load(textureName, &width, &height, &components, 4);
+
+    if (!rgba)
+    {
+        LOG_MESSAGE("[TextureAtlas] Failed to load texture: " << textureName);
+        return false;
+    }
+
+    bool inserted = Insert(rgba, width, height, region);
+    stbi_image_free(rgba);
+
+    if (inserted)
+        m_regions[textureName] = *region;
+
+    return inserted;
+}
+
+bool TextureAtlas::Insert(const unsigned char *rgba, int width, int height, AtlasRegion *region)
+{
+    // block = image + gutter, rounded up so that every block starts at a multiple of the gutter size
+    int alignment   = (std::max)(m_padding, 1);
+    int blockWidth  = (width  + 2 * m_padding + alignment - 1) / alignment * alignment;
+    int blockHeight = (height + 2 * m_padding + alignment - 1) / alignment * alignment;
+
+    if (blockWidth > m_pageSize || blockHeight > m_pageSize)
+    {
+        LOG_MESSAGE("[TextureAtlas] Texture too large for atlas page: " << width << "x" << height);
+        return false;
+    }
+
+    int pageIndex = 0, x = 0, y = 0, nodeIndex = -1;
+
+    while (pageIndex < (int)m_pages.size() && !FindPosition(m_pages[pageIndex], blockWidth, blockHeight, &x, &y, &nodeIndex))
+        pageIndex++;
+
+    // no room left in existing pages
+    if (pageIndex == (int)m_pages.size())
+    {
+        if (!AddPage() || !FindPosition(m_pages.back(), blockWidth, blockHeight, &x, &y, &nodeIndex))
+            return false;
+    }
+
+    Page &page = m_pages[pageIndex];
+    AddSkylineLevel(page, nodeIndex, x, y, blockWidth, blockHeight);
+    UploadBlock(page, rgba, width, height, x, y, blockWidth, blockHeight);
+
+    region->page   = page.handle;
+    region->x      = x + m_padding;
+    region->y      = y + m_padding;
+    region->width  = width;
+    region->height = height;
+    region->u0     = (float)region->x / m_pageSize;
+    region->v0     = (float)region->y / m_pageSize;
+    region->u1     = (float)(region->x + width)  / m_pageSize;
+    region->v1     = (float)(region->y + height) / m_pageSize;
+
+    return true;
+}
+
+void TextureAtlas::Clear()
+{
+    m_pages.clear();
+    m_regions.clear();
+}
+
+bool TextureAtlas::AddPage()
+{
+    char pageName[64];
+    sprintf(pageName, "<atlas %p page %d>", (void *)this, (int)m_pages.size());
+
+    Page page;
+    page.handle = TextureManager::GetInstance()->CreateAtlasPage(pageName, m_pageSize, m_numLevels);
+
+    if (!page.handle)
+        return false;
+
+    SkylineNode node = { 0, 0, m_pageSize };
+    page.skyline.push_back(node);
+    m_pages.push_back(page);
+
+    LOG_MESSAGE("[TextureAtlas] Added " << m_pageSize << "x" << m_pageSize << " page " << m_pages.size());
+
+    return true;
+}
+
+bool TextureAtlas::FindPosition(const Page &page, int width, int height, int *x, int *y, int *nodeIndex) const
+{
+    int bestBottom = INT_MAX;
+    int bestWidth  = INT_MAX;
+
+    *nodeIndex = -1;
+
+    for (size_t i = 0; i < page.skyline.size(); i++)
+    {
+        int nodeX = page.skyline[i].x;
+
+        if (nodeX + width > m_pageSize)
+            break;
+
+        // block rests on the highest node it spans
+        int nodeY     = 0;
+        int widthLeft = width;
+
+        for (size_t j = i; widthLeft > 0; j++)
+        {
+            nodeY      = (std::max)(nodeY, page.skyline[j].y);
+            widthLeft -= page.skyline[j].width;
+        }
+
+        if (nodeY + height > m_pageSize)
+            continue;
+
+        // lowest top edge wins, narrower node breaks ties (keeps wide gaps for wide blocks)
+        if (nodeY + height < bestBottom || (nodeY + height == bestBottom && page.skyline[i].width < bestWidth))
+        {
+            bestBottom = nodeY + height;
+            bestWidth  = page.skyline[i].width;
+            *x         = nodeX;
+            *y         = nodeY;
+            *nodeIndex = (int)i;
+        }
+    }
+
+    return *nodeIndex >= 0;
+}
+
+void TextureAtlas::AddSkylineLevel(Page &page, int nodeIndex, int x, int y, int width, int height)
+{
+    std::vector<SkylineNode> &skyline = page.skyline;
+
+    SkylineNode node = { x, y + height, width };
+    skyline.insert(skyline.begin() + nodeIndex, node);
+
+    // shrink or remove following nodes now covered by the block
+    for (size_t i = nodeIndex + 1; i < skyline.size();)
+    {
+        int overlap = skyline[i - 1].x + skyline[i - 1].width - skyline[i].x;
+
+        if (overlap <= 0)
+            break;
+
+        skyline[i].x     += overlap;
+        skyline[i].width -= overlap;
+
+        if (skyline[i].width > 0)
+            break;
+
+        skyline.erase(skyline.begin() + i);
+    }
+
+    // merge neighbours of equal height
+    for (size_t i = 0; i + 1 < skyline.size();)
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void TextureAtlas::UploadBlock(const Page &page, const unsigned char *rgba, int width, int height, int x, int y, int blockWidth, int blockHeight)
+{
+    // gutter and alignment area repeat the closest edge texel
+    std::vector<unsigned char> block(blockWidth * blockHeight * 4);
+    unsigned char *dst = &block[0];
+
+    for (int by = 0; by < blockHeight; by++)
+    {
+        const unsigned char *srcRow = rgba + (std::min)((std::max)(by - m_padding, 0), height - 1) * width * 4;
+
+        for (int bx = 0; bx < blockWidth; bx++, dst += 4)
+            memcpy(dst, srcRow + (std::min)((std::max)(bx - m_padding, 0), width - 1) * 4, 4);
+    }
+
+    TextureManager::GetInstance()->BindTexture(page.handle);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // blocks are aligned to the gutter size, so each mip level of the block maps exactly onto the page -
+    // only this block is downsampled instead of regenerating mips of the whole page
+    std::vector<unsigned char> nextLevel;
+
+    for (int level = 0; level < m_numLevels; level++)
+    {
+        int levelWidth  = blockWidth  >> level;
+        int levelHeight = blockHeight >> level;
+
+        glTexSubImage2D(GL_TEXTURE_2D, level, x >> level, y >> level, levelWidth, levelHeight, GL_RGBA, GL_UNSIGNED_BYTE, &block[0]);
+
+        if (level + 1 < m_numLevels)
+        {
+            nextLevel.resize((levelWidth / 2) * (levelHeight / 2) * 4);
+            Texture::DownsampleLevel(&block[0], levelWidth, levelHeight, &nextLevel[0], levelWidth / 2, levelHeight / 2, 4);
+            block.swap(nextLevel);
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef TEXTUREATLAS_INCLUDED
+#define TEXTUREATLAS_INCLUDED
+
+#include "renderer/Texture.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+// placement of a packed image - page is a regular TextureManager handle
+struct AtlasRegion
+{
+    TextureHandle page;
+    int   x, y;            // top left texel in page (gutter excluded)
+    int   width, height;
+    float u0, v0, u1, v1;  // texture coordinates of the image area
+};
+
+/*
+ *  Runtime atlas for small textures (font, icons, sprites) - skyline packer, images are added incrementally.
+ *  Each image is surrounded by a gutter of repeated edge texels and aligned to the gutter size,
+ *  so bilinear filtering and all mip levels of a page never mix neighbouring images.
+ */
+class TextureAtlas
+{
+public:
+    TextureAtlas(int pageSize = 1024, int padding = 4);   // padding must be a power of two - page has log2(padding) + 1 mip levels
+    ~TextureAtlas();
+
+    bool Insert(const char *textureName, AtlasRegion *region);   // decoded as RGBA, repeated inserts return the same region
+    bool Insert(const unsigned char *rgba, int width, int height, AtlasRegion *region);
+    void Clear();   // forget all pages - used when TextureManager releases its textures
+
+    int  PageCount() const { return (int)m_pages.size(); }
+private:
+    // top edge of the packed area, nodes are sorted by x and cover the full page width
+    struct SkylineNode
+    {
+        int x;
+        int y;
+        int width;
+    };
+
+    struct Page
+    {
+        TextureHandle            handle;
+        std::vector<SkylineNode> skyline;
+    };
+
+    bool AddPage();
+    bool FindPosition(const Page &page, int width, int height, int *x, int *y, int *nodeIndex) const;   // bottom-left rule
+    void AddSkylineLevel(Page &page, int nodeIndex, int x, int y, int width, int height);
+    void UploadBlock(const Page &page, const unsigned char *rgba, int width, int height, int x, int y, int blockWidth, int blockHeight);
+
+    int m_pageSize;
+    int m_padding;
+    int m_numLevels;
+    std::vector<Page> m_pages;
+    std::map<std::string, AtlasRegion> m_regions;
+};
+
+#endif
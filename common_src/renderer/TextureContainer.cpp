@@ -0,0 +1,464 @@
+#include "renderer/TextureContainer.hpp"
+#include "renderer/Texture.hpp"
+#include <cstring>
+
+// KTX 1.1 file header
+struct KTXHeader
+{
+    unsigned char identifier[12];
+    unsigned int  endianness;
+    unsigned int  glType;
+    unsigned int  glTypeSize;
+    unsigned int  glFormat;
+    unsigned int  glInternalFormat;
+    unsigned int  glBaseInternalFormat;
+    unsigned int  pixelWidth;
+    unsigned int  pixelHeight;
+    unsigned int  pixelDepth;
+    unsigned int  numberOfArrayElements;
+    unsigned int  numberOfFaces;
+    unsigned int  numberOfMipmapLevels;
+    unsigned int  bytesOfKeyValueData;
+};
+
+// KTX 2.0 file header, followed by level index
+struct KTX2Header
+{
+    unsigned char      identifier[12];
+    unsigned int       vkFormat;
+    unsigned int       typeSize;
+    unsigned int       pixelWidth;
+    unsigned int       pixelHeight;
+    unsigned int       pixelDepth;
+    unsigned int       layerCount;
+    unsigned int       faceCount;
+    unsigned int       levelCount;
+    unsigned int       supercompressionScheme;
+    unsigned int       dfdByteOffset;
+    unsigned int       dfdByteLength;
+    unsigned int       kvdByteOffset;
+    unsigned int       kvdByteLength;
+    unsigned long long sgdByteOffset;
+    unsigned long long sgdByteLength;
+};
+
+struct KTX2LevelIndex
+{
+    unsigned long long byteOffset;
+    unsigned long long byteLength;
+    unsigned long long uncompressedByteLength;
+};
+
+// DDS file header (after "DDS " magic), optionally followed by DX10 extension
+struct DDSPixelFormat
+{
+    unsigned int size;
+    unsigned int flags;
+    unsigned int fourCC;
+    unsigned int rgbBitCount;
+    unsigned int bitMask[4];
+};
+
+struct DDSHeader
+{
+    unsigned int   size;
+    unsigned int   flags;
+    unsigned int   height;
+    unsigned int   width;
+    unsigned int   pitchOrLinearSize;
+    unsigned int   depth;
+    unsigned int   mipMapCount;
+    unsigned int   reserved1[11];
+    DDSPixelFormat pixelFormat;
+    unsigned int   caps[4];
+    unsigned int   reserved2;
+};
+
+struct DDSHeaderDX10
+{
+    unsigned int dxgiFormat;
+    unsigned int resourceDimension;
+    unsigned int miscFlag;
+    unsigned int arraySize;
+    unsigned int miscFlags2;
+};
+
+static const unsigned char ktxIdentifier[12]  = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const unsigned char ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+#define FOURCC(a, b, c, d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+
+static const unsigned int DDS_MAGIC              = FOURCC('D', 'D', 'S', ' ');
+static const unsigned int DDS_PIXELFORMAT_FOURCC = 0x4;
+static const unsigned int DDS_CAPS2_CUBEMAP      = 0x200;
+
+// Vulkan (KTX2) and DXGI (DDS) format ids mapped to GL internal formats
+struct FormatMapping
+{
+    unsigned int id;
+    GLenum       internalFormat;
+};
+
+static const FormatMapping vkFormats[] = {
+    { 131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT },
+    { 132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT },
+    { 133, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT },
+    { 134, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT },
+    { 137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT },
+    { 138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT },
+    { 139, GL_COMPRESSED_RED_RGTC1 },
+    { 141, GL_COMPRESSED_RG_RGTC2 },
+    { 145, GL_COMPRESSED_RGBA_BPTC_UNORM },
+    { 146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM },
+    { 147, GL_COMPRESSED_RGB8_ETC2 },
+    { 148, GL_COMPRESSED_SRGB8_ETC2 },
+    { 151, GL_COMPRESSED_RGBA8_ETC2_EAC },
+    { 152, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC }
+};
+
+static const FormatMapping dxgiFormats[] = {
+    { 71, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT },
+    { 72, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT },
+    { 77, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT },
+    { 78, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT },
+    { 80, GL_COMPRESSED_RED_RGTC1 },
+    { 83, GL_COMPRESSED_RG_RGTC2 },
+    { 98, GL_COMPRESSED_RGBA_BPTC_UNORM },
+    { 99, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM }
+};
+
+static GLenum FindFormat(const FormatMapping *formats, size_t numFormats, unsigned int id)
+{
+    for (size_t i = 0; i < numFormats; i++)
+    {
+        if (formats[i].id == id)
+            return formats[i].internalFormat;
+    }
+
+    return 0;
+}
+
+// bytes per 4x4 block and number of channels
+static bool BlockFormatInfo(GLenum internalFormat, int *blockBytes, int *components)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+        *blockBytes = 8;  *components = 3; return true;
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+        *blockBytes = 8;  *components = 4; return true;
+    case GL_COMPRESSED_RED_RGTC1:
+        *blockBytes = 8;  *components = 1; return true;
+    case GL_COMPRESSED_RG_RGTC2:
+        *blockBytes = 16; *components = 2; return true;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+        *blockBytes = 16; *components = 4; return true;
+    default:
+        return false;
+    }
+}
+
+// larger than any GL_MAX_TEXTURE_SIZE - level sizes computed from it can't overflow
+static const int MAX_DIMENSION = 65536;
+
+static bool ValidDimensions(int width, int height)
+{
+    return width >= 1 && height >= 1 && width <= MAX_DIMENSION && height <= MAX_DIMENSION;
+}
+
+// level count read from a header can't go past the 1x1 level (negative once a huge unsigned count is stored)
+static bool ValidLevels(int numLevels, int width, int height)
+{
+    return numLevels >= 1 && numLevels <= TextureContainer::MAX_LEVELS && numLevels <= Texture::MipLevelCount(width, height);
+}
+
+// bytes the driver reads for a level - 4x4 blocks for compressed formats, packed rows of bytes otherwise
+static unsigned long long LevelSize(const TextureContainer &container, int width, int height)
+{
+    int blockBytes, components;
+
+    if (container.compressed && BlockFormatInfo(container.internalFormat, &blockBytes, &components))
+        return (unsigned long long)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+
+    return (unsigned long long)width * height * container.components;
+}
+
+// offset and length checked separately, so neither can wrap around
+static bool InRange(size_t size, unsigned long long offset, unsigned long long length)
+{
+    return offset <= size && length <= size - offset;
+}
+
+bool TextureContainer::Validate(const unsigned char *data, size_t size) const
+{
+    if (!ValidDimensions(width, height) || !ValidLevels(numLevels, width, height) || components < 1 || components > 4)
+        return false;
+
+    for (int i = 0; i < numLevels; i++)
+    {
+        const Level &level = levels[i];
+
+        if (level.width != (width >> i ? width >> i : 1) || level.height != (height >> i ? height >> i : 1))
+            return false;
+
+        if (level.data < data || !InRange(size, level.data - data, level.size) || level.size < LevelSize(*this, level.width, level.height))
+            return false;
+    }
+
+    return true;
+}
+
+bool TextureContainer::IsContainerFile(const char *filename)
+{
+    const char *ext = strrchr(filename, '.');
+
+    return ext && (!_stricmp(ext, ".ktx") || !_stricmp(ext, ".ktx2") || !_stricmp(ext, ".dds"));
+}
+
+bool TextureContainer::FormatSupported(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return GLEW_EXT_texture_compression_s3tc != 0;
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_RG_RGTC2:
+        return true;   // core since OpenGL 3.0
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+        return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility;
+    default:
+        return false;
+    }
+}
+
+bool TextureContainer::Parse(const unsigned char *data, size_t size)
+{
+    if (size >= sizeof(KTXHeader) && !memcmp(data, ktxIdentifier, sizeof(ktxIdentifier)))
+        return ParseKTX(data, size);
+
+    if (size >= sizeof(KTX2Header) && !memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)))
+        return ParseKTX2(data, size);
+
+    if (size >= sizeof(unsigned int) + sizeof(DDSHeader) && *(const unsigned int *)data == DDS_MAGIC)
+        return ParseDDS(data, size);
+
+    LOG_MESSAGE("[TextureContainer] Unknown container format");
+    return false;
+}
+
+bool TextureContainer::ParseKTX(const unsigned char *data, size_t size)
+{
+    const KTXHeader *header = (const KTXHeader *)data;
+
+    // big endian files would need byte swapping
+    if (header->endianness != 0x04030201 || header->pixelDepth > 1 || header->numberOfArrayElements > 0 || header->numberOfFaces != 1)
+    {
+        LOG_MESSAGE("[TextureContainer] Unsupported KTX layout (only little endian 2D textures are loaded)");
+        return false;
+    }
+
+    width          = header->pixelWidth;
+    height         = header->pixelHeight;
+    internalFormat = header->glInternalFormat;
+    format         = header->glFormat;
+    type           = header->glType;
+    compressed     = header->glType == 0;
+    numLevels      = header->numberOfMipmapLevels > 0 ? header->numberOfMipmapLevels : 1;
+
+    if (!ValidDimensions(width, height) || !ValidLevels(numLevels, width, height))
+        return false;
+
+    if (compressed)
+    {
+        int blockBytes;
+
+        if (!BlockFormatInfo(internalFormat, &blockBytes, &components))
+        {
+            LOG_MESSAGE("[TextureContainer] Unsupported KTX compressed format: " << internalFormat);
+            return false;
+        }
+    }
+    else
+    {
+        // byte data only, so level sizes can be checked against the dimensions
+        if (header->glType != GL_UNSIGNED_BYTE || header->glTypeSize != 1 || (format != GL_RED && format != GL_RG && format != GL_RGB && format != GL_RGBA))
+        {
+            LOG_MESSAGE("[TextureContainer] Unsupported KTX pixel format: " << format << " type " << type);
+            return false;
+        }
+
+        components = format == GL_RED ? 1 : format == GL_RG ? 2 : format == GL_RGB ? 3 : 4;
+    }
+
+    if (!InRange(size, sizeof(KTXHeader), header->bytesOfKeyValueData))
+        return false;
+
+    // each level is prefixed with its size and padded to 4 bytes
+    size_t offset = sizeof(KTXHeader) + header->bytesOfKeyValueData;
+
+    for (int i = 0; i < numLevels; i++)
+    {
+        if (!InRange(size, offset, sizeof(unsigned int)))
+            return false;
+
+        levels[i].width  = width  >> i ? width  >> i : 1;
+        levels[i].height = height >> i ? height >> i : 1;
+        levels[i].size   = *(const unsigned int *)(data + offset);
+        offset += sizeof(unsigned int);
+
+        // the driver reads a full level from the file
+        if (!InRange(size, offset, levels[i].size) || levels[i].size < LevelSize(*this, levels[i].width, levels[i].height))
+            return false;
+
+        levels[i].data = data + offset;
+        offset += (levels[i].size + 3) & ~3;
+    }
+
+    return true;
+}
+
+bool TextureContainer::ParseKTX2(const unsigned char *data, size_t size)
+{
+    const KTX2Header *header = (const KTX2Header *)data;
+
+    // Basis/zstd supercompressed data would need transcoding first
+    if (header->supercompressionScheme != 0 || header->pixelDepth > 1 || header->layerCount > 1 || header->faceCount != 1)
+    {
+        LOG_MESSAGE("[TextureContainer] Unsupported KTX2 layout (only 2D textures without supercompression are loaded)");
+        return false;
+    }
+
+    if (!SetBlockFormat(FindFormat(vkFormats, sizeof(vkFormats) / sizeof(vkFormats[0]), header->vkFormat)))
+    {
+        LOG_MESSAGE("[TextureContainer] Unsupported KTX2 format: " << header->vkFormat);
+        return false;
+    }
+
+    width     = header->pixelWidth;
+    height    = header->pixelHeight;
+    numLevels = header->levelCount > 0 ? header->levelCount : 1;
+
+    if (!ValidDimensions(width, height) || !ValidLevels(numLevels, width, height) || !InRange(size, sizeof(KTX2Header), numLevels * sizeof(KTX2LevelIndex)))
+        return false;
+
+    const KTX2LevelIndex *levelIndex = (const KTX2LevelIndex *)(data + sizeof(KTX2Header));
+
+    for (int i = 0; i < numLevels; i++)
+    {
+        levels[i].width  = width  >> i ? width  >> i : 1;
+        levels[i].height = height >> i ? height >> i : 1;
+
+        if (!InRange(size, levelIndex[i].byteOffset, levelIndex[i].byteLength) || levelIndex[i].byteLength < LevelSize(*this, levels[i].width, levels[i].height))
+            return false;
+
+        levels[i].size   = (size_t)levelIndex[i].byteLength;
+        levels[i].data   = data + levelIndex[i].byteOffset;
+    }
+
+    return true;
+}
+
+bool TextureContainer::ParseDDS(const unsigned char *data, size_t size)
+{
+    const DDSHeader *header = (const DDSHeader *)(data + sizeof(unsigned int));
+    size_t offset = sizeof(unsigned int) + sizeof(DDSHeader);
+    GLenum blockFormat = 0;
+
+    if (header->caps[1] & DDS_CAPS2_CUBEMAP || !(header->pixelFormat.flags & DDS_PIXELFORMAT_FOURCC))
+    {
+        LOG_MESSAGE("[TextureContainer] Unsupported DDS layout (only block compressed 2D textures are loaded)");
+        return false;
+    }
+
+    switch (header->pixelFormat.fourCC)
+    {
+    case FOURCC('D', 'X', 'T', '1'): blockFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+    case FOURCC('D', 'X', 'T', '5'): blockFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+    case FOURCC('A', 'T', 'I', '1'):
+    case FOURCC('B', 'C', '4', 'U'): blockFormat = GL_COMPRESSED_RED_RGTC1;          break;
+    case FOURCC('A', 'T', 'I', '2'):
+    case FOURCC('B', 'C', '5', 'U'): blockFormat = GL_COMPRESSED_RG_RGTC2;           break;
+    case FOURCC('D', 'X', '1', '0'):
+    {
+        if (offset + sizeof(DDSHeaderDX10) > size)
+            return false;
+
+        const DDSHeaderDX10 *dx10 = (const DDSHeaderDX10 *)(data + offset);
+        offset += sizeof(DDSHeaderDX10);
+
+        if (dx10->arraySize > 1)
+            return false;
+
+        blockFormat = FindFormat(dxgiFormats, sizeof(dxgiFormats) / sizeof(dxgiFormats[0]), dx10->dxgiFormat);
+        break;
+    }
+    }
+
+    if (!SetBlockFormat(blockFormat))
+    {
+        LOG_MESSAGE("[TextureContainer] Unsupported DDS format");
+        return false;
+    }
+
+    width     = header->width;
+    height    = header->height;
+    numLevels = header->mipMapCount > 0 ? header->mipMapCount : 1;
+
+    return ValidDimensions(width, height) && ValidLevels(numLevels, width, height) && SetBlockLevels(data, size, offset);
+}
+
+bool TextureContainer::SetBlockFormat(GLenum blockFormat)
+{
+    int blockBytes;
+
+    if (!BlockFormatInfo(blockFormat, &blockBytes, &components))
+        return false;
+
+    internalFormat = blockFormat;
+    format         = 0;
+    type           = 0;
+    compressed     = true;
+
+    return true;
+}
+
+bool TextureContainer::SetBlockLevels(const unsigned char *data, size_t size, size_t offset)
+{
+    for (int i = 0; i < numLevels; i++)
+    {
+        levels[i].width  = width  >> i ? width  >> i : 1;
+        levels[i].height = height >> i ? height >> i : 1;
+
+        unsigned long long levelSize = LevelSize(*this, levels[i].width, levels[i].height);
+
+        if (!InRange(size, offset, levelSize))
+            return false;
+
+        levels[i].size = (size_t)levelSize;
+        levels[i].data = data + offset;
+        offset += levels[i].size;
+    }
+
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef TEXTURECONTAINER_INCLUDED
+#define TEXTURECONTAINER_INCLUDED
+
+#include "renderer/OpenGL.hpp"
+
+/*
+ *  GPU-ready texture container (KTX, KTX2, DDS) - parsed in place, level data points into the source buffer
+ */
+struct TextureContainer
+{
+    static const int MAX_LEVELS = 16;
+
+    struct Level
+    {
+        int    width;
+        int    height;
+        size_t size;
+        const unsigned char *data;
+    };
+
+    int    width;
+    int    height;
+    int    components;
+    GLenum internalFormat;
+    GLenum format;        // uncompressed data only
+    GLenum type;          // uncompressed data only
+    bool   compressed;    // levels are passed to glCompressed* functions
+    int    numLevels;
+    Level  levels[MAX_LEVELS];
+
+    bool Parse(const unsigned char *data, size_t size);   // 2D textures only - arrays, cubemaps and supercompressed KTX2 are rejected
+    bool Validate(const unsigned char *data, size_t size) const;   // same checks as Parse for fields filled elsewhere (texture cache) - levels must lie in data
+
+    static bool IsContainerFile(const char *filename);        // .ktx, .ktx2 or .dds extension
+    static bool FormatSupported(GLenum internalFormat);       // compressed format is exposed by the driver
+private:
+    bool ParseKTX(const unsigned char *data, size_t size);
+    bool ParseKTX2(const unsigned char *data, size_t size);
+    bool ParseDDS(const unsigned char *data, size_t size);
+    bool SetBlockFormat(GLenum blockFormat);                  // fills compressed format info
+    bool SetBlockLevels(const unsigned char *data, size_t size, size_t offset); // consecutive levels of a block compressed format
+};
+
+#endif
@@ -1,4 +1,284 @@
 #include "renderer/TextureManager.hpp"
+#include "renderer/Shader.hpp"
+#include "stb_image/stb_image.h"
+#include <SDL.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// decoded texture cache location and file layout
+static const char *textureCacheDir = "../texture_cache/";
+
+static const unsigned int TEXTURE_CACHE_MAGIC      = 0x43585454;   // "TTXC"
+static const unsigned int TEXTURE_CACHE_VERSION    = 3;
+static const int          TEXTURE_CACHE_MAX_LEVELS = 16;
+static const unsigned int TEXTURE_CACHE_ALIGNMENT  = 16;           // level data offsets in file
+
+struct TextureCacheLevel
+{
+    GLint  width;
+    GLint  height;
+    GLuint offset;   // from start of file
+    GLuint size;
+};
+
+struct TextureCacheHeader
+{
+    unsigned int       magic;
+    unsigned int       version;
+    unsigned long long pathHash;
+    unsigned long long sourceTime;   // source image last write time
+    unsigned long long sourceSize;
+    GLint              width;
+    GLint              height;
+    GLint              components;
+    GLenum             format;
+    GLenum             internalFormat;
+    GLint              compressed;   // levels are passed to glCompressedTexImage2D
+    GLint              numLevels;
+    TextureCacheLevel  levels[TEXTURE_CACHE_MAX_LEVELS];
+};
+
+// read-only view of a whole file
+struct MappedFile
+{
+    MappedFile(const char *filename) : mapping(NULL), data(nullptr), size(0)
+    {
+        file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        LARGE_INTEGER fileSize;
+
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            return;
+
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if (mapping)
+        {
+            data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            size = data ? (size_t)fileSize.QuadPart : 0;
+        }
+    }
+
+    ~MappedFile()
+    {
+        if (data)
+            UnmapViewOfFile(data);
+
+        if (mapping)
+            CloseHandle(mapping);
+
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+    }
+
+    HANDLE file;
+    HANDLE mapping;
+    const unsigned char *data;
+    size_t size;
+};
+
+// 64-bit FNV-1a hash
+static unsigned long long HashString(const char *str)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+
+    while (*str)
+    {
+        hash ^= (unsigned char)*str++;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+// texture handle layout: slot index in low bits, generation in high bits
+static const unsigned int HANDLE_INDEX_BITS      = 20;
+static const unsigned int HANDLE_INDEX_MASK      = (1 << HANDLE_INDEX_BITS) - 1;
+static const unsigned int HANDLE_GENERATION_MASK = (1 << (32 - HANDLE_INDEX_BITS)) - 1;
+
+// hashed texture path used as lookup key (0 marks empty lookup entries)
+static unsigned long long LookupKey(const char *textureName)
+{
+    unsigned long long nameHash = HashString(textureName);
+
+    return nameHash ? nameHash : 1;
+}
+
+// container levels point into the cache file image at 'data'
+static void CacheContainer(const TextureCacheHeader *header, const unsigned char *data, TextureContainer *container)
+{
+    container->width          = header->width;
+    container->height         = header->height;
+    container->components     = header->components;
+    container->internalFormat = header->internalFormat;
+    container->format         = header->format;
+    container->type           = GL_UNSIGNED_BYTE;
+    container->compressed     = header->compressed != 0;
+    container->numLevels      = header->numLevels;
+
+    for (int i = 0; i < header->numLevels; i++)
+    {
+        container->levels[i].width  = header->levels[i].width;
+        container->levels[i].height = header->levels[i].height;
+        container->levels[i].size   = header->levels[i].size;
+        container->levels[i].data   = data + header->levels[i].offset;
+    }
+}
+
+// decoded images are uploaded as RGB or RGBA - grey and grey alpha pixels are expanded to RGBA
+static int TextureComponents(int components)
+{
+    return components == 3 ? 3 : 4;
+}
+
+static void ExpandPixels(const unsigned char *src, size_t pixels, int components, unsigned char *dst)
+{
+    if (components >= 3)
+    {
+        memcpy(dst, src, pixels * components);
+        return;
+    }
+
+    for (size_t i = 0; i < pixels; i++, src += components, dst += 4)
+    {
+        dst[0] = dst[1] = dst[2] = src[0];
+        dst[3] = components == 2 ? src[1] : 255;
+    }
+}
+
+// level 0 of a cache file image, filled from decoded row strips
+struct CacheDecode
+{
+    TextureCacheHeader          header;
+    std::vector<unsigned char> *fileData;
+};
+
+static int DecodeCacheRows(void *user, const unsigned char *rows, int firstRow, int numRows, int width, int height, int components)
+{
+    CacheDecode        *decode = (CacheDecode *)user;
+    TextureCacheHeader &header = decode->header;
+
+    // laid out on the first strip - the decoded components are only known now (a PNG tRNS colour key adds alpha)
+    if (header.numLevels == 0)
+    {
+        header.width          = width;
+        header.height         = height;
+        header.components     = TextureComponents(components);
+        header.format         = header.components == 3 ? GL_RGB : GL_RGBA;
+        header.internalFormat = header.format;
+
+        // full mip chain down to 1x1, each level starting at an aligned offset
+        GLuint offset = (sizeof(TextureCacheHeader) + TEXTURE_CACHE_ALIGNMENT - 1) & ~(TEXTURE_CACHE_ALIGNMENT - 1);
+
+        while (header.numLevels < TEXTURE_CACHE_MAX_LEVELS)
+        {
+            TextureCacheLevel &level = header.levels[header.numLevels++];
+            level.width  = width;
+            level.height = height;
+            level.offset = offset;
+            level.size   = width * height * header.components;
+
+            offset = (offset + level.size + TEXTURE_CACHE_ALIGNMENT - 1) & ~(TEXTURE_CACHE_ALIGNMENT - 1);
+
+            if (width == 1 && height == 1)
+                break;
+
+            width  = (std::max)(1, width / 2);
+            height = (std::max)(1, height / 2);
+        }
+
+        decode->fileData->assign(offset, 0);
+    }
+
+    size_t rowSize = (size_t)header.width * header.components;
+    ExpandPixels(rows, (size_t)numRows * header.width, components, &(*decode->fileData)[header.levels[0].offset + firstRow * rowSize]);
+
+    return 1;
+}
+
+// level 0 of a decoded texture array layer, filled from row strips
+struct ArrayDecode
+{
+    TextureContainer           *container;
+    std::vector<unsigned char> *pixels;
+};
+
+static int DecodeArrayRows(void *user, const unsigned char *rows, int firstRow, int numRows, int width, int height, int components)
+{
+    ArrayDecode      *decode    = (ArrayDecode *)user;
+    TextureContainer *container = decode->container;
+
+    // RGB or RGBA like 2D textures - the decoded components are only known now (a PNG tRNS colour key adds alpha)
+    if (firstRow == 0)
+    {
+        container->width          = width;
+        container->height         = height;
+        container->components     = TextureComponents(components);
+        container->internalFormat = container->components == 3 ? GL_RGB : GL_RGBA;
+        container->format         = container->internalFormat;
+        container->type           = GL_UNSIGNED_BYTE;
+        container->compressed     = false;
+        container->numLevels      = (std::min)(Texture::MipLevelCount(width, height), (int)TextureContainer::MAX_LEVELS);
+
+        decode->pixels->resize(Texture::StorageSize(width, height, container->components, container->numLevels));
+    }
+
+    ExpandPixels(rows, (size_t)numRows * width, components, &(*decode->pixels)[(size_t)firstRow * width * container->components]);
+
+    return 1;
+}
+
+// texture array layer - container levels point into the mapped file, images are decoded and get a box filtered mip chain
+static bool LoadArraySource(const char *textureName, TextureContainer *container, MappedFile **file, std::vector<unsigned char> *pixels)
+{
+    if (TextureContainer::IsContainerFile(textureName))
+    {
+        *file = new MappedFile(textureName);
+
+        return (*file)->data && container->Parse((*file)->data, (*file)->size) &&
+               (!container->compressed || TextureContainer::FormatSupported(container->internalFormat));
+    }
+
+    ArrayDecode decode = { container, pixels };
+    stbi_context context;
+    stbi_context_init(&context);
+    int width, height, components;
+
+    if (!stbi_load_rows_ctx(&context, textureName, 0, DecodeArrayRows, &decode, &width, &height, &components))
+        return false;
+
+    size_t offset = 0;
+
+    for (int i = 0; i < container->numLevels; i++)
+    {
+        TextureContainer::Level &level = container->levels[i];
+        level.width  = (std::max)(width  >> i, 1);
+        level.height = (std::max)(height >> i, 1);
+        level.size   = (size_t)level.width * level.height * container->components;
+        level.data   = &(*pixels)[offset];
+
+        if (i > 0)
+        {
+            const TextureContainer::Level &prevLevel = container->levels[i - 1];
+            Texture::DownsampleLevel(prevLevel.data, prevLevel.width, prevLevel.height, &(*pixels)[offset], level.width, level.height, container->components);
+        }
+
+        offset += level.size;
+    }
+
+    return true;
+}
+
+static std::string TextureCacheFilename(unsigned long long pathHash)
+{
+    char filename[32];
+    sprintf(filename, "%016llx.tex", pathHash);
+
+    return textureCacheDir + std::string(filename);
+}
 
 
 TextureManager* TextureManager::GetInstance()
@@ -13,51 +293,1166 @@ TextureManager::~TextureManager()
     ReleaseTextures();
 }
 
+TextureHandle TextureManager::AddTexture(Texture *texture, unsigned long long nameHash, const char *textureName)
+{
+    unsigned int slotIndex;
+
+    if (!m_freeSlots.empty())
+    {
+        slotIndex = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else
+    {
+        LOG_MESSAGE_ASSERT(m_slots.size() <= HANDLE_INDEX_MASK, "Too many textures: " << m_slots.size());
+
+        TextureSlot newSlot = { nullptr, 0, 1, 0, 0, false };
+        slotIndex = (unsigned int)m_slots.size();
+        m_slots.push_back(newSlot);
+        m_slotNames.push_back(std::string());
+    }
+
+    TextureSlot &slot = m_slots[slotIndex];
+    slot.texture       = texture;
+    slot.texId         = 0;
+    slot.nameHash      = nameHash;
+    slot.lastUsedFrame = m_frameIndex;
+    slot.evicted       = false;
+    m_slotNames[slotIndex] = textureName ? textureName : "";
+
+    if (texture->Resident())
+        SetResident(slot, true);
+
+    InsertLookup(nameHash, slotIndex);
+
+    return slot.generation << HANDLE_INDEX_BITS | slotIndex;
+}
+
+int TextureManager::SlotIndex(TextureHandle handle) const
+{
+    unsigned int slotIndex = handle & HANDLE_INDEX_MASK;
+
+    if (slotIndex >= m_slots.size() || m_slots[slotIndex].generation != handle >> HANDLE_INDEX_BITS || !m_slots[slotIndex].texture)
+        return -1;
+
+    return (int)slotIndex;
+}
+
+int TextureManager::FindSlot(unsigned long long nameHash, const char *textureName) const
+{
+    if (m_lookup.empty())
+        return -1;
+
+    size_t mask = m_lookup.size() - 1;
+
+    for (size_t i = (size_t)nameHash & mask; m_lookup[i].nameHash; i = (i + 1) & mask)
+    {
+        if (m_lookup[i].nameHash == nameHash && m_slotNames[m_lookup[i].slot] == textureName)
+            return m_lookup[i].slot;
+    }
+
+    return -1;
+}
+
+void TextureManager::InsertLookup(unsigned long long nameHash, unsigned int slot)
+{
+    // grow at half load - keeps probe sequences short
+    if ((m_lookupCount + 1) * 2 > m_lookup.size())
+    {
+        std::vector<LookupEntry> oldLookup(m_lookup.empty() ? 64 : m_lookup.size() * 2);
+        oldLookup.swap(m_lookup);
+        m_lookupCount = 0;
+
+        for (size_t i = 0; i < oldLookup.size(); i++)
+        {
+            if (oldLookup[i].nameHash)
+                InsertLookup(oldLookup[i].nameHash, oldLookup[i].slot);
+        }
+    }
+
+    size_t mask = m_lookup.size() - 1;
+    size_t i    = (size_t)nameHash & mask;
+
+    while (m_lookup[i].nameHash)
+        i = (i + 1) & mask;
+
+    m_lookup[i].nameHash = nameHash;
+    m_lookup[i].slot     = slot;
+    m_lookupCount++;
+}
+
+void TextureManager::RemoveLookup(unsigned long long nameHash, unsigned int slot)
+{
+    if (m_lookup.empty())
+        return;
+
+    size_t mask = m_lookup.size() - 1;
+    size_t i    = (size_t)nameHash & mask;
+
+    // entries of colliding names share the hash - remove the one of this slot
+    while (m_lookup[i].nameHash != nameHash || m_lookup[i].slot != slot)
+    {
+        if (!m_lookup[i].nameHash)
+            return;
+
+        i = (i + 1) & mask;
+    }
+
+    // backward shift deletion - moves following entries of the probe sequence into the gap, no tombstones needed
+    for (size_t j = (i + 1) & mask; m_lookup[j].nameHash; j = (j + 1) & mask)
+    {
+        size_t home = (size_t)m_lookup[j].nameHash & mask;
+
+        // entry can fill the gap unless its home slot lies cyclically in (i, j]
+        bool canMove = i < j ? (home <= i || home > j) : (home <= i && home > j);
+
+        if (canMove)
+        {
+            m_lookup[i] = m_lookup[j];
+            i = j;
+        }
+    }
+
+    m_lookup[i].nameHash = 0;
+    m_lookupCount--;
+}
+
 void TextureManager::ReleaseTextures()
 {
-    for (std::map<std::string, Texture*>::iterator it = m_textures.begin(); it != m_textures.end(); ++it)
+    StopWorkers();
+
+    for (size_t i = 0; i < m_slots.size(); i++)
     {
-        delete it->second;
+        delete m_slots[i].texture;
     }
 
+    ReleaseTextureArrays();
+
+    m_atlas.Clear();
+    m_slots.clear();
+    m_slotNames.clear();
+    m_freeSlots.clear();
+    m_lookup.clear();
+    m_lookupCount    = 0;
     m_currentTexture = 0;
+
+    size_t budgetBytes = m_stats.budgetBytes;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.budgetBytes = budgetBytes;
+
+    if (glIsTexture(m_placeholderTexture))
+        glDeleteTextures(1, &m_placeholderTexture);
+
+    m_placeholderTexture = 0;
+
+    for (int i = 0; i < UPLOAD_RING_SIZE; i++)
+    {
+        if (glIsBuffer(m_uploadBuffers[i]))
+            glDeleteBuffers(1, &m_uploadBuffers[i]);
+
+        if (m_uploadFences[i])
+            glDeleteSync(m_uploadFences[i]);
+
+        m_uploadBuffers[i]     = 0;
+        m_uploadBufferSizes[i] = 0;
+        m_uploadFences[i]      = 0;
+    }
+}
+
+TextureHandle TextureManager::LoadTexture(const char *textureName)
+{
+    unsigned long long nameHash = LookupKey(textureName);
+    int slotIndex = FindSlot(nameHash, textureName);
+
+    if (slotIndex >= 0)
+        return m_slots[slotIndex].generation << HANDLE_INDEX_BITS | slotIndex;
+
+    Texture *newTex = LoadTextureData(textureName);
+
+    // failed to load texture
+    if (!newTex)
+        return 0;
+
+    return AddTexture(newTex, nameHash, textureName);
 }
 
-Texture *TextureManager::LoadTexture(const char *textureName)
+Texture *TextureManager::LoadTextureData(const char *textureName)
 {
-    if (m_textures.count(textureName) == 0)
+    LOG_MESSAGE("[TextureManager] Loading texture: " << textureName);
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    WIN32_FILE_ATTRIBUTE_DATA sourceInfo;
+
+    // file doesn't exist
+    if (!GetFileAttributesExA(textureName, GetFileExInfoStandard, &sourceInfo))
+        return nullptr;
+
+    Texture *newTex = nullptr;
+    const char *loadedFrom = "texture cache";
+
+    if (TextureContainer::IsContainerFile(textureName))
+    {
+        // already GPU-ready - no need for the decoded texture cache
+        newTex = LoadContainerTexture(textureName);
+        loadedFrom = "container";
+    }
+    else
+    {
+        newTex = LoadCachedTexture(textureName, sourceInfo);
+    }
+
+    if (!newTex && !TextureContainer::IsContainerFile(textureName))
     {
-        LOG_MESSAGE("[TextureManager] Loading texture: " << textureName);
-        Texture *newTex = new Texture(textureName);   
+        // decode once, then load through the cache exactly like following launches do
+        std::vector<unsigned char> cacheData;
 
-        // failed to load texture/file doesn't exist
-        if (newTex->Load() == 0)
+        if (DecodeCachedTexture(textureName, sourceInfo, &cacheData))
         {
-            delete newTex;
-            return nullptr;
+            if (SaveCachedTexture(textureName, cacheData))
+                newTex = LoadCachedTexture(textureName, sourceInfo);
+
+            // cache not writable - upload the decoded levels as is
+            if (!newTex)
+            {
+                TextureContainer container;
+                CacheContainer((const TextureCacheHeader *)&cacheData[0], &cacheData[0], &container);
+                newTex = CreateTexture(container);
+            }
         }
 
-        m_textures[textureName] = newTex;       
+        loadedFrom = "decoded";
     }
 
-    return m_textures[textureName];
+    if (!newTex)
+        return nullptr;
+
+    // cold (decoded) vs cached startup can be compared between first and following launches
+    LOG_MESSAGE("[TextureManager] Loaded " << textureName << " (" << loadedFrom << ") in "
+                << (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency() << " ms");
+
+    return newTex;
 }
 
-void TextureManager::BindTexture(Texture *t)
+Texture *TextureManager::LoadCachedTexture(const char *textureName, const WIN32_FILE_ATTRIBUTE_DATA &sourceInfo)
 {
-    if (m_currentTexture != t->Id())
+    unsigned long long pathHash = HashString(textureName);
+    MappedFile cacheFile(TextureCacheFilename(pathHash).c_str());
+
+    if (cacheFile.size < sizeof(TextureCacheHeader))
+        return nullptr;
+
+    const TextureCacheHeader *header = (const TextureCacheHeader *)cacheFile.data;
+    unsigned long long sourceTime = ((unsigned long long)sourceInfo.ftLastWriteTime.dwHighDateTime << 32) | sourceInfo.ftLastWriteTime.dwLowDateTime;
+    unsigned long long sourceSize = ((unsigned long long)sourceInfo.nFileSizeHigh << 32) | sourceInfo.nFileSizeLow;
+
+    // stale entry (source changed) - will be replaced after decoding
+    if (header->magic != TEXTURE_CACHE_MAGIC || header->version != TEXTURE_CACHE_VERSION || header->pathHash != pathHash ||
+        header->sourceTime != sourceTime || header->sourceSize != sourceSize ||
+        header->numLevels < 1 || header->numLevels > TEXTURE_CACHE_MAX_LEVELS)
     {
-        m_currentTexture = t->Id();
-        glBindTexture(GL_TEXTURE_2D, t->Id());
+        return nullptr;
     }
+
+    // corrupt entry - dimensions, components and level sizes have to agree, like in a parsed container file
+    TextureContainer container;
+    CacheContainer(header, cacheFile.data, &container);
+
+    if (!container.Validate(cacheFile.data, cacheFile.size))
+        return nullptr;
+
+    return CreateTexture(container);
 }
 
-void TextureManager::UnBindTexture()
+Texture *TextureManager::LoadContainerTexture(const char *textureName)
 {
-    if (m_currentTexture != 0)
+    MappedFile file(textureName);
+    TextureContainer container;
+
+    if (!file.data || !container.Parse(file.data, file.size))
+        return nullptr;
+
+    if (container.compressed && !TextureContainer::FormatSupported(container.internalFormat))
     {
-        glBindTexture(GL_TEXTURE_2D, 0);
-        m_currentTexture = 0;
+        LOG_MESSAGE("[TextureManager] Compressed format not supported by driver: " << textureName);
+        return nullptr;
+    }
+
+    return CreateTexture(container);
+}
+
+Texture *TextureManager::CreateTexture(const TextureContainer &container)
+{
+    Texture *texture = new Texture();
+    texture->m_width          = container.width;
+    texture->m_height         = container.height;
+    texture->m_components     = container.components;
+    texture->m_format         = container.format;
+    texture->m_internalFormat = container.internalFormat;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    bool immutable = texture->CreateTexture(container.numLevels);
+
+    // level data is read by the driver straight from the mapped file
+    for (int i = 0; i < container.numLevels; i++)
+    {
+        const TextureContainer::Level &level = container.levels[i];
+
+        if (container.compressed && immutable)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, container.internalFormat, (GLsizei)level.size, level.data);
+        else if (container.compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, container.internalFormat, level.width, level.height, 0, (GLsizei)level.size, level.data);
+        else if (immutable)
+            glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, container.format, container.type, level.data);
+        else
+            glTexImage2D(GL_TEXTURE_2D, i, container.internalFormat, level.width, level.height, 0, container.format, container.type, level.data);
+
+        texture->m_byteSize += level.size;
+    }
+
+    texture->SetFiltering(m_mipmaps, m_anisotropy);
+    texture->m_resident = true;
+    glBindTexture(GL_TEXTURE_2D, m_currentTexture);
+
+    return texture;
+}
+
+bool TextureManager::DecodeCachedTexture(const char *textureName, const WIN32_FILE_ATTRIBUTE_DATA &sourceInfo, std::vector<unsigned char> *fileData)
+{
+    CacheDecode decode;
+    TextureCacheHeader &header = decode.header;
+    memset(&header, 0, sizeof(header));
+    header.magic      = TEXTURE_CACHE_MAGIC;
+    header.version    = TEXTURE_CACHE_VERSION;
+    header.pathHash   = HashString(textureName);
+    header.sourceTime = ((unsigned long long)sourceInfo.ftLastWriteTime.dwHighDateTime << 32) | sourceInfo.ftLastWriteTime.dwLowDateTime;
+    header.sourceSize = ((unsigned long long)sourceInfo.nFileSizeHigh << 32) | sourceInfo.nFileSizeLow;
+    header.compressed = 0;
+    decode.fileData   = fileData;
+
+    // level 0 is decoded straight into the file image - no full intermediate image and copy
+    stbi_context context;
+    stbi_context_init(&context);
+    int width, height, components;
+
+    if (!stbi_load_rows_ctx(&context, textureName, 0, DecodeCacheRows, &decode, &width, &height, &components))
+    {
+        LOG_MESSAGE("[TextureManager] Failed to decode texture: " << textureName << " (" << (context.failure_reason ? context.failure_reason : "unknown") << ")");
+        return false;
+    }
+
+    memcpy(&(*fileData)[0], &header, sizeof(header));
+
+    for (int i = 1; i < header.numLevels; i++)
+    {
+        const TextureCacheLevel &src = header.levels[i - 1];
+        const TextureCacheLevel &dst = header.levels[i];
+
+        Texture::DownsampleLevel(&(*fileData)[src.offset], src.width, src.height, &(*fileData)[dst.offset], dst.width, dst.height, header.components);
+    }
+
+    return true;
+}
+
+bool TextureManager::SaveCachedTexture(const char *textureName, const std::vector<unsigned char> &fileData)
+{
+    CreateDirectoryA(textureCacheDir, NULL);
+
+    std::string filename = TextureCacheFilename(HashString(textureName));
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+    {
+        LOG_MESSAGE("Cannot write texture cache file: " << filename);
+        return false;
+    }
+
+    file.write((const char *)&fileData[0], fileData.size());
+    file.close();
+
+    return !file.fail();
+}
+
+TextureHandle TextureManager::LoadTextureAsync(const char *textureName)
+{
+    unsigned long long nameHash = LookupKey(textureName);
+    int slotIndex = FindSlot(nameHash, textureName);
+
+    if (slotIndex >= 0)
+        return m_slots[slotIndex].generation << HANDLE_INDEX_BITS | slotIndex;
+
+    LOG_MESSAGE("[TextureManager] Queueing texture: " << textureName);
+
+    // shown until the real texture is resident
+    if (!m_placeholderTexture)
+    {
+        const unsigned char grey[] = { 128, 128, 128, 255 };
+
+        glGenTextures(1, &m_placeholderTexture);
+        glBindTexture(GL_TEXTURE_2D, m_placeholderTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, m_currentTexture);
+    }
+
+    if (m_workers.empty())
+        StartWorkers();
+
+    AsyncLoad *load = new AsyncLoad;
+    load->handle        = AddTexture(new Texture(), nameHash, textureName);
+    load->filename        = textureName;
+    load->pendingBytes    = 0;
+    load->maxPendingBytes = 2 * m_uploadBudget;
+    load->failureReason   = NULL;
+    load->width           = 0;
+    load->height          = 0;
+    load->components      = 0;
+    load->uploadedRows    = 0;
+    load->decoding        = false;
+    load->failed          = false;
+    load->queued          = false;
+    load->cancelled       = false;
+
+    m_asyncPending++;
+
+    {
+        std::lock_guard<std::mutex> lock(m_asyncMutex);
+        m_decodeQueue.push_back(load);
     }
+
+    m_asyncCondition.notify_one();
+
+    return load->handle;
+}
+
+void TextureManager::StartWorkers()
+{
+    // leave one core for the render thread
+    unsigned int numWorkers = std::thread::hardware_concurrency();
+    numWorkers = (std::max)(1u, (std::min)(4u, numWorkers > 1 ? numWorkers - 1 : 1));
+
+    m_workersQuit = false;
+
+    for (unsigned int i = 0; i < numWorkers; i++)
+        m_workers.push_back(std::thread(&TextureManager::DecodeWorker, this));
 }
 
+void TextureManager::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_asyncMutex);
+        m_workersQuit = true;
+    }
+
+    m_asyncCondition.notify_all();
+    m_streamCondition.notify_all();
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+        m_workers[i].join();
+
+    m_workers.clear();
+
+    // drop loads that never finished - their textures are released with the rest
+    for (size_t i = 0; i < m_decodeQueue.size(); i++)
+        delete m_decodeQueue[i];
+
+    for (size_t i = 0; i < m_uploadQueue.size(); i++)
+        delete m_uploadQueue[i];
+
+    delete m_currentUpload;
+
+    m_decodeQueue.clear();
+    m_uploadQueue.clear();
+    m_currentUpload = nullptr;
+    m_asyncPending  = 0;
+}
+
+void TextureManager::DecodeWorker()
+{
+    std::unique_lock<std::mutex> lock(m_asyncMutex);
+
+    while (true)
+    {
+        m_asyncCondition.wait(lock, [this] { return m_workersQuit || !m_decodeQueue.empty(); });
+
+        if (m_workersQuit)
+            return;
+
+        AsyncLoad *load = m_decodeQueue.front();
+        m_decodeQueue.pop_front();
+        load->decoding = true;
+
+        // decode without holding the lock - this is the expensive part, strips are handed over as they come out
+        lock.unlock();
+        stbi_context context;
+        stbi_context_init(&context);
+        int width, height, components;
+        bool decoded = stbi_load_rows_ctx(&context, load->filename.c_str(), 0, DecodeRows, load, &width, &height, &components) != 0;
+        lock.lock();
+
+        load->decoding = false;
+
+        if (!decoded)
+        {
+            load->failed        = true;
+            load->failureReason = context.failure_reason;
+        }
+
+        if (load->cancelled)
+            delete load;
+        else if (!load->queued)
+            m_uploadQueue.push_back(load);
+    }
+}
+
+int TextureManager::DecodeRows(void *user, const unsigned char *rows, int firstRow, int numRows, int width, int height, int components)
+{
+    TextureManager *manager = GetInstance();
+    AsyncLoad      *load    = (AsyncLoad *)user;
+
+    // grey images are expanded like in the synchronous path
+    size_t pixels = (size_t)numRows * width;
+    std::vector<unsigned char> strip(pixels * TextureComponents(components));
+    ExpandPixels(rows, pixels, components, &strip[0]);
+
+    std::unique_lock<std::mutex> lock(manager->m_asyncMutex);
+
+    // bounded memory - wait for the GL thread to catch up instead of decoding ahead
+    manager->m_streamCondition.wait(lock, [&] { return manager->m_workersQuit || load->cancelled || load->pendingBytes == 0 ||
+                                                       load->pendingBytes + strip.size() <= load->maxPendingBytes; });
+
+    if (manager->m_workersQuit || load->cancelled)
+        return 0;
+
+    if (!load->queued)
+    {
+        load->width      = width;
+        load->height     = height;
+        load->components = TextureComponents(components);
+        load->queued     = true;
+        manager->m_uploadQueue.push_back(load);
+    }
+
+    load->pendingBytes += strip.size();
+    load->strips.push_back(std::move(strip));
+
+    return 1;
+}
+
+void TextureManager::Update()
+{
+    m_frameIndex++;
+
+    EvictTextures();
+    UpdateAsyncLoads();
+}
+
+void TextureManager::EvictTextures()
+{
+    if (m_stats.budgetBytes == 0 || m_stats.residentBytes <= m_stats.budgetBytes)
+        return;
+
+    // (last used frame, slot index) - textures bound last frame are likely needed again and are never evicted
+    std::vector<std::pair<unsigned int, unsigned int>> candidates;
+
+    for (size_t i = 0; i < m_slots.size(); i++)
+    {
+        if (m_slots[i].texId && m_slots[i].lastUsedFrame + 1 < m_frameIndex && !m_slotNames[i].empty())
+            candidates.push_back(std::make_pair(m_slots[i].lastUsedFrame, (unsigned int)i));
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    size_t evictedBytes = 0;
+    size_t numEvicted   = 0;
+
+    for (; numEvicted < candidates.size() && m_stats.residentBytes > m_stats.budgetBytes; numEvicted++)
+    {
+        TextureSlot &slot = m_slots[candidates[numEvicted].second];
+
+        // deleting a bound texture resets the binding to 0
+        if (slot.texId == m_currentTexture)
+            m_currentTexture = 0;
+
+        evictedBytes += slot.texture->ByteSize();
+        SetResident(slot, false);
+        slot.texture->Unload();
+        slot.evicted = true;
+
+        m_stats.evictedCount++;
+        m_stats.evictions++;
+    }
+
+    if (numEvicted > 0)
+    {
+        LOG_MESSAGE("[TextureManager] Evicted " << numEvicted << " textures (" << evictedBytes / 1024 << " KB), resident: "
+                    << m_stats.residentBytes / 1024 << " KB, budget: " << m_stats.budgetBytes / 1024 << " KB");
+    }
+}
+
+void TextureManager::ReloadTexture(TextureSlot &slot, const std::string &textureName)
+{
+    Texture *texture = LoadTextureData(textureName.c_str());
+
+    slot.evicted = false;
+    m_stats.evictedCount--;
+
+    // source is gone - texture stays a placeholder
+    if (!texture)
+        return;
+
+    // keep the Texture object - pointers returned by GetTexture() stay valid, the placeholder's GL state is freed with 'texture'
+    slot.texture->Swap(*texture);
+    delete texture;
+
+    SetResident(slot, true);
+}
+
+void TextureManager::SetResident(TextureSlot &slot, bool resident)
+{
+    if (resident)
+    {
+        slot.texId = slot.texture->Id();
+        m_stats.residentBytes += slot.texture->ByteSize();
+        m_stats.residentCount++;
+    }
+    else
+    {
+        slot.texId = 0;
+        m_stats.residentBytes -= slot.texture->ByteSize();
+        m_stats.residentCount--;
+    }
+}
+
+void TextureManager::UpdateAsyncLoads()
+{
+    if (m_asyncPending == 0)
+        return;
+
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    size_t budget    = m_uploadBudget;
+    size_t uploaded  = 0;
+
+    while (budget > 0)
+    {
+        if (!m_currentUpload)
+        {
+            std::lock_guard<std::mutex> lock(m_asyncMutex);
+
+            if (m_uploadQueue.empty())
+                break;
+
+            m_currentUpload = m_uploadQueue.front();
+            m_uploadQueue.pop_front();
+        }
+
+        // texture released while loading
+        if (SlotIndex(m_currentUpload->handle) < 0)
+        {
+            FinishAsyncLoad(m_currentUpload);
+            continue;
+        }
+
+        bool decoding, failed;
+        {
+            std::lock_guard<std::mutex> lock(m_asyncMutex);
+            decoding = m_currentUpload->decoding;
+            failed   = m_currentUpload->failed;
+        }
+
+        if (failed)
+        {
+            // texture stays a placeholder, rows uploaded so far are dropped with it
+            LOG_MESSAGE("[TextureManager] Failed to load texture: " << m_currentUpload->filename << " (" << (m_currentUpload->failureReason ? m_currentUpload->failureReason : "unknown") << ")");
+            FinishAsyncLoad(m_currentUpload);
+            continue;
+        }
+
+        if (m_currentUpload->uploadedRows == m_currentUpload->height)
+        {
+            // decoder may still be checking the end of the file
+            if (decoding)
+                break;
+
+            FinishAsyncLoad(m_currentUpload);
+            continue;
+        }
+
+        size_t prevBudget = budget;
+
+        if (!UploadChunk(m_currentUpload, &budget))
+            break;
+
+        uploaded += prevBudget - budget;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, m_currentTexture);
+
+    if (uploaded > 0)
+    {
+        LOG_MESSAGE("[TextureManager] Uploaded " << uploaded / 1024 << " KB in " << (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency()
+                    << " ms (" << m_asyncPending << " textures pending)");
+    }
+}
+
+bool TextureManager::UploadChunk(AsyncLoad *load, size_t *budget)
+{
+    Texture *texture = m_slots[SlotIndex(load->handle)].texture;
+    int slot = m_uploadIndex;
+
+    // never wait for the GPU - if the buffer is still in use, continue next frame
+    if (m_uploadFences[slot])
+    {
+        if (glClientWaitSync(m_uploadFences[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+            return false;
+
+        glDeleteSync(m_uploadFences[slot]);
+        m_uploadFences[slot] = 0;
+    }
+
+    // allocate storage on first chunk
+    if (!texture->m_texId)
+    {
+        texture->m_width          = load->width;
+        texture->m_height         = load->height;
+        texture->m_components     = load->components;
+        texture->m_format         = load->components == 3 ? GL_RGB : GL_RGBA;
+        texture->m_internalFormat = texture->m_format;
+
+        // mips are generated once all rows are uploaded
+        if (!texture->CreateTexture(Texture::MipLevelCount(load->width, load->height)))
+            glTexImage2D(GL_TEXTURE_2D, 0, texture->m_internalFormat, load->width, load->height, 0, texture->m_format, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    // whole decoded strips within budget - at least one per frame, so huge strips still make progress
+    std::vector<std::vector<unsigned char>> strips;
+    size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_asyncMutex);
+
+        while (!load->strips.empty() && (strips.empty() || bytes + load->strips.front().size() <= *budget))
+        {
+            bytes += load->strips.front().size();
+            strips.push_back(std::move(load->strips.front()));
+            load->strips.pop_front();
+        }
+
+        load->pendingBytes -= bytes;
+    }
+
+    if (strips.empty())
+        return false;
+
+    m_streamCondition.notify_all();
+
+    size_t rowSize = (size_t)load->width * load->components;
+    int    rows    = (int)(bytes / rowSize);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffers[slot]);
+
+    if (!m_uploadBuffers[slot] || bytes > m_uploadBufferSizes[slot])
+    {
+        if (!m_uploadBuffers[slot])
+        {
+            glGenBuffers(1, &m_uploadBuffers[slot]);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffers[slot]);
+        }
+
+        m_uploadBufferSizes[slot] = (std::max)(bytes, m_uploadBudget);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, m_uploadBufferSizes[slot], NULL, GL_STREAM_DRAW);
+    }
+
+    unsigned char *dst = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    if (!dst)
+    {
+        // put the rows back for the next frame
+        std::lock_guard<std::mutex> lock(m_asyncMutex);
+        load->strips.insert(load->strips.begin(), std::make_move_iterator(strips.begin()), std::make_move_iterator(strips.end()));
+        load->pendingBytes += bytes;
+        return false;
+    }
+
+    for (size_t i = 0; i < strips.size(); i++)
+    {
+        memcpy(dst, &strips[i][0], strips[i].size());
+        dst += strips[i].size();
+    }
+
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glBindTexture(GL_TEXTURE_2D, texture->m_texId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, load->uploadedRows, load->width, rows, texture->m_format, GL_UNSIGNED_BYTE, (void*)0);
+
+    m_uploadFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_uploadIndex = (slot + 1) % UPLOAD_RING_SIZE;
+
+    load->uploadedRows += rows;
+    *budget -= (std::min)(*budget, bytes);
+
+    return true;
+}
+
+void TextureManager::FinishAsyncLoad(AsyncLoad *load)
+{
+    int  slotIndex = SlotIndex(load->handle);
+    bool decoding, failed;
+    {
+        std::lock_guard<std::mutex> lock(m_asyncMutex);
+        decoding = load->decoding;
+        failed   = load->failed;
+
+        // released while decoding - the worker stops at its next strip and deletes the load
+        load->cancelled = decoding;
+    }
+
+    if (decoding)
+        m_streamCondition.notify_all();
+
+    if (!decoding && !failed && slotIndex >= 0 && load->uploadedRows == load->height)
+    {
+        TextureSlot &slot = m_slots[slotIndex];
+
+        glBindTexture(GL_TEXTURE_2D, slot.texture->m_texId);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        slot.texture->SetFiltering(m_mipmaps, m_anisotropy);
+        slot.texture->m_byteSize = Texture::StorageSize(load->width, load->height, load->components, slot.texture->m_numLevels);
+        slot.texture->m_resident = true;
+        SetResident(slot, true);
+    }
+
+    if (!decoding)
+        delete load;
+
+    m_currentUpload = nullptr;
+    m_asyncPending--;
+}
+
+void TextureManager::SetFiltering(bool mipmaps, float anisotropy)
+{
+    m_mipmaps    = mipmaps;
+    m_anisotropy = anisotropy;
+
+    for (size_t i = 0; i < m_slots.size(); i++)
+    {
+        if (m_slots[i].texture)
+            m_slots[i].texture->SetFiltering(mipmaps, anisotropy);
+    }
+
+    for (size_t i = 0; i < m_textureArrays.size(); i++)
+    {
+        // texture state is frozen once a bindless handle exists
+        if (!m_textureArrays[i].bindlessHandle)
+            SetArrayFiltering(m_textureArrays[i]);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, m_currentTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_currentTextureArray);
+}
+
+bool TextureManager::LoadTextureArrays(const char * const *textureNames, int count, ArrayLayer *layers)
+{
+    if (!GLEW_ARB_texture_storage)
+    {
+        LOG_MESSAGE("[TextureManager] GL_ARB_texture_storage not supported, texture arrays unavailable");
+        return false;
+    }
+
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    std::vector<TextureContainer>           sources(count);
+    std::vector<MappedFile *>               files(count, nullptr);
+    std::vector<std::vector<unsigned char>> pixels(count);
+    std::vector<TextureArray>               newArrays;
+    bool allLoaded = true;
+
+    // group layers by size and format - arrays are immutable, so layer counts must be known before creating them
+    for (int i = 0; i < count; i++)
+    {
+        layers[i].array = -1;
+        layers[i].layer = -1;
+
+        if (!LoadArraySource(textureNames[i], &sources[i], &files[i], &pixels[i]) || !Texture::SizedFormat(sources[i].internalFormat))
+        {
+            LOG_MESSAGE("[TextureManager] Failed to load array texture: " << textureNames[i]);
+            allLoaded = false;
+            continue;
+        }
+
+        layers[i].array = FindTextureArray(newArrays, sources[i]);
+        layers[i].layer = newArrays[layers[i].array].layers++;
+    }
+
+    if (m_textureArrays.size() + newArrays.size() > MAX_TEXTURE_ARRAYS)
+    {
+        LOG_MESSAGE("[TextureManager] Too many texture arrays: " << m_textureArrays.size() + newArrays.size());
+        newArrays.clear();
+        allLoaded = false;
+    }
+
+    for (size_t i = 0; i < newArrays.size(); i++)
+        CreateTextureArray(newArrays[i]);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (layers[i].array < 0 || newArrays.empty())
+        {
+            layers[i].array = -1;
+            layers[i].layer = -1;
+            continue;
+        }
+
+        const TextureArray &array = newArrays[layers[i].array];
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texId);
+
+        for (int j = 0; j < array.numLevels; j++)
+        {
+            const TextureContainer::Level &level = sources[i].levels[j];
+
+            if (array.compressed)
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, j, 0, 0, layers[i].layer, level.width, level.height, 1, array.internalFormat, (GLsizei)level.size, level.data);
+            else
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, j, 0, 0, layers[i].layer, level.width, level.height, 1, array.format, array.type, level.data);
+        }
+
+        layers[i].array += (int)m_textureArrays.size();
+    }
+
+    for (int i = 0; i < count; i++)
+        delete files[i];
+
+    // handles are created after upload - texture state can't change afterwards
+    for (size_t i = 0; i < newArrays.size(); i++)
+    {
+        if (GLEW_ARB_bindless_texture)
+        {
+            newArrays[i].bindlessHandle = glGetTextureHandleARB(newArrays[i].texId);
+            glMakeTextureHandleResidentARB(newArrays[i].bindlessHandle);
+        }
+
+        m_textureArrays.push_back(newArrays[i]);
+    }
+
+    if (GLEW_ARB_bindless_texture && !newArrays.empty())
+    {
+        // std140 - uvec2 array elements are padded to 16 bytes
+        std::vector<GLuint64> handles(MAX_TEXTURE_ARRAYS * 2, 0);
+
+        for (size_t i = 0; i < m_textureArrays.size(); i++)
+            handles[i * 2] = m_textureArrays[i].bindlessHandle;
+
+        if (!m_textureArraysUbo)
+            glGenBuffers(1, &m_textureArraysUbo);
+
+        glBindBuffer(GL_UNIFORM_BUFFER, m_textureArraysUbo);
+        glBufferData(GL_UNIFORM_BUFFER, handles.size() * sizeof(GLuint64), &handles[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_currentTextureArray);
+
+    LOG_MESSAGE("[TextureManager] Loaded " << count << " textures into " << newArrays.size() << " texture arrays" << (m_textureArraysUbo ? " (bindless)" : "") << " in "
+                << (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency() << " ms");
+
+    return allLoaded;
+}
+
+int TextureManager::FindTextureArray(std::vector<TextureArray> &arrays, const TextureContainer &container)
+{
+    for (size_t i = 0; i < arrays.size(); i++)
+    {
+        const TextureArray &array = arrays[i];
+
+        if (array.width == container.width && array.height == container.height && array.numLevels == container.numLevels &&
+            array.internalFormat == container.internalFormat && array.compressed == container.compressed &&
+            (array.compressed || (array.format == container.format && array.type == container.type)))
+        {
+            return (int)i;
+        }
+    }
+
+    TextureArray newArray = { 0, 0, container.internalFormat, container.format, container.type, container.compressed,
+                              container.width, container.height, container.numLevels, 0 };
+    arrays.push_back(newArray);
+
+    return (int)arrays.size() - 1;
+}
+
+void TextureManager::CreateTextureArray(TextureArray &array)
+{
+    glGenTextures(1, &array.texId);
+    SetArrayFiltering(array);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.numLevels - 1);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, array.numLevels, Texture::SizedFormat(array.internalFormat), array.width, array.height, array.layers);
+}
+
+void TextureManager::SetArrayFiltering(const TextureArray &array)
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texId);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, m_mipmaps && array.numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+    if (GLEW_EXT_texture_filter_anisotropic)
+    {
+        GLfloat maxAnisotropy = 1.f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+        glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, m_anisotropy < maxAnisotropy ? m_anisotropy : maxAnisotropy);
+    }
+}
+
+void TextureManager::ReleaseTextureArrays()
+{
+    for (size_t i = 0; i < m_textureArrays.size(); i++)
+    {
+        if (m_textureArrays[i].bindlessHandle)
+            glMakeTextureHandleNonResidentARB(m_textureArrays[i].bindlessHandle);
+
+        if (glIsTexture(m_textureArrays[i].texId))
+            glDeleteTextures(1, &m_textureArrays[i].texId);
+    }
+
+    m_textureArrays.clear();
+    m_currentTextureArray = 0;
+
+    if (glIsBuffer(m_textureArraysUbo))
+        glDeleteBuffers(1, &m_textureArraysUbo);
+
+    m_textureArraysUbo = 0;
+}
+
+void TextureManager::BindTextureArray(int array)
+{
+    LOG_MESSAGE_ASSERT(array >= 0 && array < (int)m_textureArrays.size(), "Binding invalid texture array: " << array);
+
+    GLuint texId = m_textureArrays[array].texId;
+
+    if (m_currentTextureArray != texId)
+    {
+        m_currentTextureArray = texId;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texId);
+    }
+}
+
+void TextureManager::BindTextureArrays()
+{
+    glBindBufferBase(GL_UNIFORM_BUFFER, TextureArraysBinding, m_textureArraysUbo);
+}
+
+TextureHandle TextureManager::CreateAtlasPage(const char *pageName, int size, int numLevels)
+{
+    Texture *page = new Texture();
+    page->m_width          = size;
+    page->m_height         = size;
+    page->m_components     = 4;
+    page->m_format         = GL_RGBA;
+    page->m_internalFormat = GL_RGBA;
+
+    if (!page->CreateTexture(numLevels))
+    {
+        for (int i = 0; i < numLevels; i++)
+            glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, (std::max)(size >> i, 1), (std::max)(size >> i, 1), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    page->SetFiltering(m_mipmaps, m_anisotropy);
+    page->m_byteSize = Texture::StorageSize(size, size, 4, numLevels);
+    page->m_resident = true;
+    glBindTexture(GL_TEXTURE_2D, m_currentTexture);
+
+    return AddTexture(page, LookupKey(pageName), NULL);
+}
+
+const Texture *TextureManager::GetTexture(TextureHandle handle) const
+{
+    int slotIndex = SlotIndex(handle);
+
+    return slotIndex >= 0 ? m_slots[slotIndex].texture : nullptr;
+}
+
+void TextureManager::ReleaseTexture(TextureHandle handle)
+{
+    int slotIndex = SlotIndex(handle);
+
+    if (slotIndex < 0)
+        return;
+
+    TextureSlot &slot = m_slots[slotIndex];
+
+    // deleting a bound texture resets the binding to 0
+    if (slot.texId && slot.texId == m_currentTexture)
+        m_currentTexture = 0;
+
+    if (slot.texId)
+        SetResident(slot, false);
+
+    if (slot.evicted)
+        m_stats.evictedCount--;
+
+    // a pending async load notices the stale handle and drops its data
+    delete slot.texture;
+    RemoveLookup(slot.nameHash, (unsigned int)slotIndex);
+
+    slot.texture    = nullptr;
+    slot.texId      = 0;
+    slot.evicted    = false;
+    slot.generation = slot.generation < HANDLE_GENERATION_MASK ? slot.generation + 1 : 1;
+    m_slotNames[slotIndex].clear();
+    m_freeSlots.push_back(slotIndex);
+}
+
+void TextureManager::BindTexture(TextureHandle handle)
+{
+    int slotIndex = SlotIndex(handle);
+    LOG_MESSAGE_ASSERT(slotIndex >= 0, "Binding invalid texture handle: " << handle);
+
+    if (slotIndex < 0)
+        return;
+
+    TextureSlot &slot = m_slots[slotIndex];
+    slot.lastUsedFrame = m_frameIndex;
+
+    if (slot.evicted)
+    {
+        m_stats.misses++;
+        ReloadTexture(slot, m_slotNames[slotIndex]);
+    }
+    else if (slot.texId)
+    {
+        m_stats.hits++;
+    }
+
+    // no pointer chasing - bound id lives in the slot array
+    GLuint texId = slot.texId ? slot.texId : m_placeholderTexture;
+
+    if (m_currentTexture != texId)
+    {
+        m_currentTexture = texId;
+        glBindTexture(GL_TEXTURE_2D, texId);
+    }
+}
+
+void TextureManager::BindTexture(const Texture *t)
+{
+    GLuint texId = t->Resident() ? t->Id() : m_placeholderTexture;
+
+    if (m_currentTexture != texId)
+    {
+        m_currentTexture = texId;
+        glBindTexture(GL_TEXTURE_2D, texId);
+    }
+}
+
+void TextureManager::UnBindTexture()
+{
+    if (m_currentTexture != 0)
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_currentTexture = 0;
+    }
+}
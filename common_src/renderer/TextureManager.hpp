@@ -3,26 +3,202 @@
 
 #include "renderer/OpenGL.hpp"
 #include "renderer/Texture.hpp"
-#include <map>
+#include "renderer/TextureAtlas.hpp"
+#include "renderer/TextureContainer.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 class TextureManager
 {
 public:
+    // residency counters, shown in the debug HUD
+    struct TextureStats
+    {
+        size_t       residentBytes;    // GPU storage of all resident textures
+        size_t       budgetBytes;
+        int          residentCount;
+        int          evictedCount;     // reloaded transparently on next bind
+        unsigned int hits;             // binds of resident textures
+        unsigned int misses;           // binds that had to reload an evicted texture
+        unsigned int evictions;
+    };
+
+    // layer of a texture array - arrays group textures of equal size and format
+    struct ArrayLayer
+    {
+        int array;   // bound with BindTextureArray() or picked from bindless handles in shader
+        int layer;
+    };
+
+    // must match MAX_TEXTURE_ARRAYS in BasicVariant.fsh
+    static const int MAX_TEXTURE_ARRAYS = 16;
+
     static TextureManager* GetInstance();
 
-    Texture *LoadTexture(const char *textureName);
-    void BindTexture(Texture *t);
+    TextureHandle LoadTexture(const char *textureName);        // KTX/KTX2/DDS are uploaded as is, other images go through decoded texture cache
+    TextureHandle LoadTextureAsync(const char *textureName);   // returns immediately - placeholder is bound until texture is resident
+    TextureHandle CreateAtlasPage(const char *pageName, int size, int numLevels);   // empty RGBA page filled by TextureAtlas, never evicted
+    TextureAtlas &GetAtlas() { return m_atlas; }               // shared atlas for small UI textures (font, icons, sprites)
+    const Texture *GetTexture(TextureHandle handle) const;     // nullptr for released/invalid handles
+    void ReleaseTexture(TextureHandle handle);
+    void Update();                                        // call once per frame - evicts textures over memory budget, uploads decoded textures within byte budget
+    bool AsyncLoadPending() const { return m_asyncPending > 0; }
+    void SetUploadBudget(size_t bytesPerFrame) { m_uploadBudget = bytesPerFrame; }
+    void SetMemoryBudget(size_t bytes) { m_stats.budgetBytes = bytes; }   // least recently used textures above it are evicted (0 - no limit)
+    const TextureStats &GetStats() const { return m_stats; }
+    void SetFiltering(bool mipmaps, float anisotropy);    // applies to all loaded textures - default is trilinear with 4x anisotropy
+    bool LoadTextureArrays(const char * const *textureNames, int count, ArrayLayer *layers);   // false if any texture could not be placed in an array
+    int  TextureArrayCount() const { return (int)m_textureArrays.size(); }
+    bool BindlessArrays() const { return m_textureArraysUbo != 0; }   // GL_ARB_bindless_texture handles are used instead of binding arrays
+    void BindTextureArray(int array);
+    void BindTextureArrays();   // all array handles to TextureArrays uniform block (bindless only)
+    void BindTexture(TextureHandle handle);
+    void BindTexture(const Texture *t);   // textures not owned by the manager
     void UnBindTexture(); // set current texture to 0;
     void ReleaseTextures();
 private:
-    TextureManager() : m_currentTexture(0)
+    // number of pixel unpack buffers cycled through by uploads
+    static const int UPLOAD_RING_SIZE = 4;
+
+    // texture slot - dense per-texture data, slot index is stored in the handle
+    struct TextureSlot
+    {
+        Texture           *texture;      // nullptr for free slots
+        GLuint             texId;        // 0 until texture is resident
+        unsigned int       generation;   // bumped on release, stale handles stop matching
+        unsigned long long nameHash;
+        unsigned int       lastUsedFrame;
+        bool               evicted;      // GPU storage freed, reloaded from m_slotNames on next bind (textures without a name are never evicted)
+    };
+
+    // open addressing (linear probing) entry, nameHash 0 marks an empty entry
+    struct LookupEntry
+    {
+        unsigned long long nameHash;
+        unsigned int       slot;
+    };
+
+    // GL_TEXTURE_2D_ARRAY with immutable storage, all layers are uploaded at creation
+    struct TextureArray
+    {
+        GLuint   texId;
+        GLuint64 bindlessHandle;   // resident handle, texture state can't change once it exists
+        GLenum   internalFormat;
+        GLenum   format;           // uncompressed data only
+        GLenum   type;             // uncompressed data only
+        bool     compressed;
+        int      width;
+        int      height;
+        int      numLevels;
+        int      layers;
+    };
+
+    // texture decoded on a worker thread in row strips, which are uploaded on the GL thread while decoding continues -
+    // strips, pendingBytes and the flags are shared with the worker
+    struct AsyncLoad
     {
+        TextureHandle  handle;
+        std::string    filename;
+        std::deque<std::vector<unsigned char>> strips;   // decoded rows waiting for upload
+        size_t         pendingBytes;
+        size_t         maxPendingBytes;  // decoder waits above this
+        const char    *failureReason;    // stb_image reason when failed
+        int            width;
+        int            height;
+        int            components;
+        int            uploadedRows;
+        bool           decoding;
+        bool           failed;
+        bool           queued;           // in upload queue since the first strip
+        bool           cancelled;        // released while decoding - worker deletes it
+    };
+
+    TextureManager() : m_lookupCount(0), m_currentTexture(0), m_placeholderTexture(0), m_mipmaps(true), m_anisotropy(4.f), m_frameIndex(0), m_currentTextureArray(0), m_textureArraysUbo(0), m_workersQuit(false), m_asyncPending(0),
+                       m_currentUpload(nullptr), m_uploadBudget(4 * 1024 * 1024), m_uploadIndex(0)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+        m_stats.budgetBytes = 256 * 1024 * 1024;
+
+        for (int i = 0; i < UPLOAD_RING_SIZE; i++)
+        {
+            m_uploadBuffers[i]     = 0;
+            m_uploadBufferSizes[i] = 0;
+            m_uploadFences[i]      = 0;
+        }
     }
 
     ~TextureManager();
 
-    std::map<std::string, Texture *> m_textures;
+    TextureHandle AddTexture(Texture *texture, unsigned long long nameHash, const char *textureName);   // textureName is NULL for generated textures
+    int  SlotIndex(TextureHandle handle) const;   // -1 for released/invalid handles
+    int  FindSlot(unsigned long long nameHash, const char *textureName) const;   // hash hits are confirmed by name, colliding paths get their own slots
+    void InsertLookup(unsigned long long nameHash, unsigned int slot);
+    void RemoveLookup(unsigned long long nameHash, unsigned int slot);
+
+    Texture *LoadTextureData(const char *textureName);   // synchronous load of a single texture, nullptr on failure
+    Texture *LoadContainerTexture(const char *textureName);
+    Texture *CreateTexture(const TextureContainer &container);   // upload all levels, data may point into a mapped file
+    Texture *LoadCachedTexture(const char *textureName, const WIN32_FILE_ATTRIBUTE_DATA &sourceInfo);
+    bool DecodeCachedTexture(const char *textureName, const WIN32_FILE_ATTRIBUTE_DATA &sourceInfo, std::vector<unsigned char> *fileData);   // cache file image with all levels
+    bool SaveCachedTexture(const char *textureName, const std::vector<unsigned char> &fileData);
+
+    static int FindTextureArray(std::vector<TextureArray> &arrays, const TextureContainer &container);   // adds a new array if no existing one matches
+    void CreateTextureArray(TextureArray &array);
+    void SetArrayFiltering(const TextureArray &array);   // leaves the array bound
+    void ReleaseTextureArrays();
+
+    void EvictTextures();                 // least recently used first, textures used last frame are kept
+    void ReloadTexture(TextureSlot &slot, const std::string &textureName);
+    void SetResident(TextureSlot &slot, bool resident);   // updates residency stats
+
+    void UpdateAsyncLoads();
+    void StartWorkers();
+    void StopWorkers();
+    void DecodeWorker();
+    static int DecodeRows(void *user, const unsigned char *rows, int firstRow, int numRows, int width, int height, int components);   // stb_image row callback
+    bool UploadChunk(AsyncLoad *load, size_t *budget);   // false if no upload buffer is free this frame or no rows are decoded yet
+    void FinishAsyncLoad(AsyncLoad *load);
+
+    std::vector<TextureSlot>  m_slots;
+    std::vector<std::string>  m_slotNames;     // source paths for reloading evicted textures, kept out of the slot array
+    TextureAtlas              m_atlas;
+    std::vector<unsigned int> m_freeSlots;
+    std::vector<LookupEntry>  m_lookup;        // power of two size, at most half full
+    size_t                    m_lookupCount;
     GLuint m_currentTexture;
+    GLuint m_placeholderTexture;
+    bool   m_mipmaps;
+    float  m_anisotropy;
+    unsigned int m_frameIndex;
+    TextureStats m_stats;
+
+    // texture arrays for batched draws
+    std::vector<TextureArray> m_textureArrays;
+    GLuint m_currentTextureArray;
+    GLuint m_textureArraysUbo;   // bindless handles (std140 uvec2 array)
+
+    // decode workers - everything below the mutex is shared with worker threads
+    std::vector<std::thread> m_workers;
+    std::mutex               m_asyncMutex;
+    std::condition_variable  m_asyncCondition;
+    std::condition_variable  m_streamCondition;   // decoded rows were uploaded or a load was cancelled
+    std::deque<AsyncLoad *>  m_decodeQueue;   // waiting for a worker
+    std::deque<AsyncLoad *>  m_uploadQueue;   // first rows decoded, waiting for GL thread
+    bool                     m_workersQuit;
+
+    // GL thread only
+    int        m_asyncPending;
+    AsyncLoad *m_currentUpload;
+    size_t     m_uploadBudget;
+    GLuint     m_uploadBuffers[UPLOAD_RING_SIZE];
+    size_t     m_uploadBufferSizes[UPLOAD_RING_SIZE];
+    GLsync     m_uploadFences[UPLOAD_RING_SIZE];   // set while GPU may still read the buffer
+    int        m_uploadIndex;
 };
 
 #endif